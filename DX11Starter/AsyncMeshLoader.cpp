@@ -0,0 +1,119 @@
+#include "AsyncMeshLoader.h"
+
+AsyncMeshLoader::AsyncMeshLoader(RenderDevice* device, JobSystem* jobs)
+{
+	this->device = device;
+	this->jobs = jobs;
+}
+
+// --------------------------------------------------------
+// Destructor - Jobs still in flight write into their requests,
+// so those have to finish before the requests can go away
+// --------------------------------------------------------
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+	jobs->Wait(&loads);
+
+	for (size_t i = 0; i < requests.size(); i++)
+		delete requests[i];
+}
+
+Mesh* AsyncMeshLoader::Load(const char* objFile, bool optimize, VertexFormat format)
+{
+	Request* request = new Request();
+	request->target = new Mesh(format);
+	request->path = objFile;
+	request->optimize = optimize;
+	request->loaded = false;
+	request->done = false;
+	request->contentHash = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(request);
+	}
+
+	// The job only touches its own request, never the Mesh.  Big
+	// files split their parsing into more jobs on the same system.
+	jobs->Run([this, request]()
+	{
+		unsigned long long contentHash = 0;
+		bool loaded =
+			MeshFile::HashSource(request->path.c_str(), &contentHash) &&
+			Mesh::LoadObjData(request->path.c_str(), request->optimize, &request->data, jobs);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		request->contentHash = contentHash;
+		request->loaded = loaded;
+		request->done = true;
+	}, &loads);
+
+	return request->target;
+}
+
+void AsyncMeshLoader::Cancel(Mesh* mesh)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if (requests[i]->target == mesh)
+			requests[i]->target = 0;
+	}
+}
+
+int AsyncMeshLoader::FinalizeReady()
+{
+	// Pull out finished requests, so buffer creation
+	// happens without holding up the workers
+	std::vector<Request*> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < requests.size();)
+		{
+			if (requests[i]->done)
+			{
+				finished.push_back(requests[i]);
+				requests[i] = requests.back();
+				requests.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	int readyCount = 0;
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		Request* request = finished[i];
+		if (request->target && request->loaded)
+		{
+			request->target->Finalize(&request->data, device);
+			readyCount++;
+		}
+		delete request;
+	}
+
+	return readyCount;
+}
+
+int AsyncMeshLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (int)requests.size();
+}
+
+bool AsyncMeshLoader::GetContentHash(Mesh* mesh, unsigned long long* hash)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if (requests[i]->target == mesh && requests[i]->done && requests[i]->loaded)
+		{
+			*hash = requests[i]->contentHash;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Loads meshes in the background
+//
+// Load() hands back an empty Mesh right away and runs the
+// CPU half of the load (Mesh::LoadObjData) as a job.
+// FinalizeReady(), called from the thread that updates the
+// scene, creates the GPU buffers for every load that has
+// finished.  Until then
+// Mesh::IsReady() is false and callers should draw something
+// else in its place.
+//
+// Each job also hashes the file it loaded, so callers can
+// spot the same contents under different names without
+// reading files themselves.
+// --------------------------------------------------------
+class AsyncMeshLoader
+{
+
+public:
+	AsyncMeshLoader(RenderDevice* device, JobSystem* jobs);
+	~AsyncMeshLoader();
+
+	Mesh* Load(const char* objFile, bool optimize = true, VertexFormat format = VertexFormatFull);
+
+	// Forget about a mesh that is being deleted before it finished
+	void Cancel(Mesh* mesh);
+
+	// Scene update thread only - returns how many meshes became ready
+	int FinalizeReady();
+
+	int GetPendingCount();
+
+	// Hash of the file behind a mesh, once its load job is done
+	// (false while it is still loading, or if the load failed)
+	bool GetContentHash(Mesh* mesh, unsigned long long* hash);
+
+private:
+	struct Request
+	{
+		Mesh* target;
+		std::string path;
+		bool optimize;
+		bool loaded;
+		bool done;
+		unsigned long long contentHash;
+		MeshData data;
+	};
+
+	RenderDevice* device;
+	JobSystem* jobs;
+	JobCounter loads;	// Jobs still writing into their requests
+
+	std::mutex mutex;
+	std::vector<Request*> requests;
+};
@@ -0,0 +1,1951 @@
+#include "Benchmarks.h"
+#include "ObjParser.h"
+#include "Mesh.h"
+#include "AsyncMeshLoader.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "VertexPacking.h"
+#include "TransformSystem.h"
+#include "EntityRegistry.h"
+#include "TransformHierarchy.h"
+#include "FrustumCuller.h"
+#include "BoundingVolumeHierarchy.h"
+#include "RenderQueue.h"
+#include "InstancedRenderer.h"
+#include "SimpleShader.h"
+#include "SoftwareRasterizer.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+#include "Material.h"
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// The models the game loads
+static const char* modelFiles[] =
+{
+	"../../Assets/Models/cube.obj",
+	"../../Assets/Models/torus.obj",
+	"../../Assets/Models/helix.obj",
+	"../../Assets/Models/cone.obj",
+	"../../Assets/Models/cylinder.obj",
+};
+static const int modelFileCount = sizeof(modelFiles) / sizeof(modelFiles[0]);
+
+// Results get written here so the optimizer can't skip the work
+static volatile unsigned int benchmarkSink;
+
+static double Now()
+{
+	return std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// What the legacy loop below read, to check ObjParser against
+struct LegacyObjCounts
+{
+	size_t Positions;
+	size_t Normals;
+	size_t UVs;
+	size_t Corners;
+};
+
+// --------------------------------------------------------
+// The original Mesh OBJ loop: one 100 byte line at a time,
+// everything parsed with sscanf_s.  Kept here purely as a
+// baseline.  Returns how many of each element it read
+// (triangle corners, for faces).
+// --------------------------------------------------------
+static LegacyObjCounts LegacyParseObj(const char* objFile)
+{
+	LegacyObjCounts counts = {};
+	std::ifstream obj(objFile);
+	if (!obj.is_open())
+		return counts;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	size_t corners = 0;
+	char chars[100];
+
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int facesRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+			corners += (facesRead == 12) ? 6 : 3;
+		}
+	}
+
+	counts.Positions = positions.size();
+	counts.Normals = normals.size();
+	counts.UVs = uvs.size();
+	counts.Corners = corners;
+	return counts;
+}
+
+// --------------------------------------------------------
+// Writes a grid of rows x columns vertices as an OBJ big
+// enough for ObjParser to split into several chunks
+//
+// Each row's vertices are followed by the faces joining it
+// to the row before: quads with relative (negative) indices,
+// which only resolve once the chunks are stitched together,
+// and triangles with absolute ones.  Lines stay under the
+// legacy loop's 100 characters.
+// --------------------------------------------------------
+static bool WriteGeneratedObj(const char* objFile, int rows, int columns)
+{
+	std::ofstream obj(objFile);
+	if (!obj.is_open())
+		return false;
+
+	char line[100];
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < columns; c++)
+		{
+			snprintf(line, sizeof(line), "v %.4f %.4f %.4f\nvt %.4f %.4f\nvn 0 1 0\n",
+				(float)c, sinf(r * 0.1f + c * 0.2f), (float)r,
+				(float)c / columns, (float)r / rows);
+			obj << line;
+		}
+		if (r == 0)
+			continue;
+
+		// Column c of this row is -(columns - c), of the row before -(2 * columns - c)
+		for (int c = 0; c + 1 < columns; c++)
+		{
+			if (c % 2 == 0)
+			{
+				int a = -(2 * columns - c);
+				int b = -(columns - c);
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+					a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+				obj << line;
+			}
+			else
+			{
+				int a = (r - 1) * columns + c + 1;
+				int b = r * columns + c + 1;
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, b + 1, b + 1, b + 1);
+				obj << line;
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+				obj << line;
+			}
+		}
+	}
+
+	return obj.good();
+}
+
+void Benchmarks::RunAll()
+{
+	printf("---- Benchmarks ------------------------------------------\n");
+	ObjParsing();
+	VertexWelding();
+	VertexCacheOptimization();
+	MeshStartup();
+	AsyncLoading();
+	PackedVertices();
+	TransformUpdate();
+	EntityIteration();
+	HierarchyUpdate();
+	FrustumCulling();
+	BvhBuildAndRefit();
+	BvhQueries();
+	RenderQueueSorting();
+	StateCacheFiltering();
+	ShaderVariableSets();
+	VertexTransformCost();
+	ObjectConstantSetup();
+	SoftwareRasterization();
+	CommandRecording();
+	FramePipelining();
+	JobSystemScaling();
+	printf("----------------------------------------------------------\n");
+}
+
+void Benchmarks::ObjParsing()
+{
+	const int repeats = 10;
+
+	// None of the game's models are big enough to be split, so
+	// a generated one covers chunking and the relative index
+	// fixups between chunks
+	const char* generatedFile = "ObjParsingBenchmark.obj";
+	bool generated = WriteGeneratedObj(generatedFile, 240, 256);
+
+	// "N thr" splits each file across a JobSystem's threads
+	JobSystem jobs;
+
+	printf("OBJ parsing (%d runs each, N = %u threads)\n", repeats, jobs.GetThreadCount());
+	printf("  %-32s %10s %7s %12s %12s %12s %6s\n", "file", "KB", "chunks", "legacy MB/s", "1 thr MB/s", "N thr MB/s", "same");
+
+	for (int f = 0; f <= modelFileCount; f++)
+	{
+		const char* path = f < modelFileCount ? modelFiles[f] : generatedFile;
+		if (f == modelFileCount && !generated)
+		{
+			printf("  %-32s (couldn't be written)\n", path);
+			continue;
+		}
+
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			printf("  %-32s (missing)\n", path);
+			continue;
+		}
+		double megabytes = file.GetSize() / (1024.0 * 1024.0);
+
+		// The same split ParseMemory() makes
+		size_t maxChunks = file.GetSize() / ObjParser::MinChunkSize + 1;
+		size_t chunks = jobs.GetThreadCount() < maxChunks ? jobs.GetThreadCount() : maxChunks;
+
+		LegacyObjCounts legacy = {};
+		double start = Now();
+		for (int r = 0; r < repeats; r++)
+			legacy = LegacyParseObj(path);
+		double legacyTime = Now() - start;
+
+		ObjData single;
+		start = Now();
+		for (int r = 0; r < repeats; r++)
+			ObjParser::ParseFile(path, &single);
+		double singleTime = Now() - start;
+
+		ObjData multi;
+		start = Now();
+		for (int r = 0; r < repeats; r++)
+			ObjParser::ParseFile(path, &multi, &jobs);
+		double multiTime = Now() - start;
+
+		// Both parses have to read what the legacy loop did, and
+		// the split one has to come out exactly like the whole one
+		bool same =
+			single.Positions.size() == legacy.Positions &&
+			single.Normals.size() == legacy.Normals &&
+			single.UVs.size() == legacy.UVs &&
+			single.Corners.size() == legacy.Corners &&
+			multi.Positions.size() == single.Positions.size() &&
+			multi.Normals.size() == single.Normals.size() &&
+			multi.UVs.size() == single.UVs.size() &&
+			multi.Corners.size() == single.Corners.size() &&
+			(single.Corners.empty() || memcmp(&multi.Corners[0], &single.Corners[0], sizeof(ObjCorner) * single.Corners.size()) == 0) &&
+			(single.Positions.empty() || memcmp(&multi.Positions[0], &single.Positions[0], sizeof(XMFLOAT3) * single.Positions.size()) == 0);
+
+		printf("  %-32s %10.1f %7u %12.1f %12.1f %12.1f %6s\n",
+			path,
+			file.GetSize() / 1024.0,
+			(unsigned int)chunks,
+			megabytes * repeats / legacyTime,
+			megabytes * repeats / singleTime,
+			megabytes * repeats / multiTime,
+			same ? "yes" : "NO");
+	}
+
+	if (generated)
+		remove(generatedFile);
+}
+
+void Benchmarks::VertexWelding()
+{
+	printf("Vertex welding\n");
+	printf("  %-32s %10s %10s %10s %10s %10s\n", "file", "verts in", "verts out", "KB in", "KB out", "weld ms");
+
+	for (int f = 0; f < modelFileCount; f++)
+	{
+		ObjData data;
+		if (!ObjParser::ParseFile(modelFiles[f], &data))
+		{
+			printf("  %-32s (missing)\n", modelFiles[f]);
+			continue;
+		}
+
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		double start = Now();
+		Mesh::AssembleObj(data, &verts, &indices);
+		double weldTime = Now() - start;
+
+		// Without welding every corner was its own vertex
+		printf("  %-32s %10zu %10zu %10.1f %10.1f %10.3f\n",
+			modelFiles[f],
+			data.Corners.size(),
+			verts.size(),
+			data.Corners.size() * sizeof(Vertex) / 1024.0,
+			verts.size() * sizeof(Vertex) / 1024.0,
+			weldTime * 1000.0);
+	}
+}
+
+void Benchmarks::VertexCacheOptimization()
+{
+	printf("Vertex cache optimization (FIFO cache of 16)\n");
+	printf("  %-32s %10s %10s %10s %10s %10s\n", "file", "ACMR in", "ACMR out", "ATVR in", "ATVR out", "opt ms");
+
+	for (int f = 0; f < modelFileCount; f++)
+	{
+		ObjData data;
+		if (!ObjParser::ParseFile(modelFiles[f], &data))
+		{
+			printf("  %-32s (missing)\n", modelFiles[f]);
+			continue;
+		}
+
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		Mesh::AssembleObj(data, &verts, &indices);
+		int vertexCount = (int)verts.size();
+		int indexCount = (int)indices.size();
+		if (indexCount == 0)
+			continue;
+
+		float acmrBefore = MeshOptimizer::CalculateACMR(&indices[0], indexCount, vertexCount);
+		float atvrBefore = MeshOptimizer::CalculateATVR(&indices[0], indexCount, vertexCount);
+
+		double start = Now();
+		MeshOptimizer::OptimizeVertexCache(&indices[0], indexCount, vertexCount);
+		vertexCount = MeshOptimizer::OptimizeVertexFetch(&verts[0], vertexCount, &indices[0], indexCount);
+		double optimizeTime = Now() - start;
+
+		printf("  %-32s %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+			modelFiles[f],
+			acmrBefore,
+			MeshOptimizer::CalculateACMR(&indices[0], indexCount, vertexCount),
+			atvrBefore,
+			MeshOptimizer::CalculateATVR(&indices[0], indexCount, vertexCount),
+			optimizeTime * 1000.0);
+	}
+}
+
+void Benchmarks::MeshStartup()
+{
+	printf("Mesh startup: cold (OBJ import + write binary) vs. warm (map binary)\n");
+	printf("  %-32s %10s %10s %10s\n", "file", "cold ms", "warm ms", "speedup");
+
+	for (int f = 0; f < modelFileCount; f++)
+	{
+		// Use a separate file so the game's own cache isn't disturbed
+		std::string cachePath = std::string(modelFiles[f]) + ".bench.mesh";
+
+		double start = Now();
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		if (!Mesh::ImportObj(modelFiles[f], true, &verts, &indices))
+		{
+			printf("  %-32s (missing)\n", modelFiles[f]);
+			continue;
+		}
+		MeshFileHeader header = {};
+		header.Magic = MeshFile::Magic;
+		header.Version = MeshFile::Version;
+		header.Flags = MeshFile::FlagOptimized;
+		header.VertexStride = sizeof(Vertex);
+		header.VertexCount = (unsigned int)verts.size();
+		header.IndexCount = (unsigned int)indices.size();
+		Mesh::CalculateBounds(&verts[0], (int)verts.size(), &header.BoundsMin, &header.BoundsMax);
+		header.BoundsRadius = Mesh::CalculateBoundingRadius(&verts[0], (int)verts.size(), XMFLOAT3(
+			(header.BoundsMin.x + header.BoundsMax.x) * 0.5f,
+			(header.BoundsMin.y + header.BoundsMax.y) * 0.5f,
+			(header.BoundsMin.z + header.BoundsMax.z) * 0.5f));
+		MeshFile::Write(cachePath.c_str(), header, &verts[0], &indices[0]);
+		double coldTime = Now() - start;
+
+		// Touch every index so the pages are really read
+		// (the GPU upload would do the same)
+		start = Now();
+		MeshFile cache;
+		unsigned int checksum = 0;
+		if (cache.Open(cachePath.c_str()))
+		{
+			const unsigned int* mappedIndices = cache.GetIndices();
+			for (unsigned int i = 0; i < cache.GetHeader()->IndexCount; i++)
+				checksum += mappedIndices[i];
+			cache.Close();
+		}
+		double warmTime = Now() - start;
+		DeleteFileA(cachePath.c_str());
+
+		benchmarkSink = checksum;
+
+		printf("  %-32s %10.3f %10.3f %9.1fx\n",
+			modelFiles[f],
+			coldTime * 1000.0,
+			warmTime * 1000.0,
+			coldTime / warmTime);
+	}
+}
+
+void Benchmarks::AsyncLoading()
+{
+	// Several copies of every model, like a scene with many assets
+	const int copies = 8;
+	int loadCount = modelFileCount * copies;
+
+	// Everything on the calling thread, like Game::Init used to do
+	double start = Now();
+	for (int i = 0; i < loadCount; i++)
+	{
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		Mesh::ImportObj(modelFiles[i % modelFileCount], true, &verts, &indices);
+	}
+	double serialTime = Now() - start;
+
+	// Same loads as jobs, as AsyncMeshLoader runs them.  The main
+	// thread only pays for submission; everything else overlaps
+	// with whatever it does next.
+	JobSystem jobs;
+	JobCounter loads;
+	start = Now();
+	for (int i = 0; i < loadCount; i++)
+	{
+		const char* file = modelFiles[i % modelFileCount];
+		jobs.Run([file, &jobs]()
+		{
+			std::vector<Vertex> verts;
+			std::vector<UINT> indices;
+			Mesh::ImportObj(file, true, &verts, &indices, &jobs);
+		}, &loads);
+	}
+	double submitTime = Now() - start;
+	jobs.Wait(&loads);
+	double asyncTime = Now() - start;
+
+	printf("Async loading (%d OBJ imports, CPU half only, %u workers)\n", loadCount, jobs.GetWorkerCount());
+	printf("  serial %.2f ms, jobs %.2f ms (%.1fx), main thread blocked %.3f ms\n",
+		serialTime * 1000.0,
+		asyncTime * 1000.0,
+		serialTime / asyncTime,
+		submitTime * 1000.0);
+
+	// The whole AsyncMeshLoader path against the headless device:
+	// the same loads, polled once a "frame" like Game::Update()
+	// does until every buffer has been created
+	NullRenderDevice device;
+	AsyncMeshLoader loader(&device, &jobs);
+	std::vector<Mesh*> meshes(loadCount);
+	start = Now();
+	for (int i = 0; i < loadCount; i++)
+		meshes[i] = loader.Load(modelFiles[i % modelFileCount]);
+
+	int polls = 0;
+	int readyCount = 0;
+	while (loader.GetPendingCount() > 0)
+	{
+		readyCount += loader.FinalizeReady();
+		polls++;
+		std::this_thread::yield();
+	}
+	double loaderTime = Now() - start;
+
+	int notReady = 0;
+	for (int i = 0; i < loadCount; i++)
+	{
+		if (!meshes[i]->IsReady())
+			notReady++;
+	}
+	printf("  AsyncMeshLoader on a NullRenderDevice: %.2f ms, %d ready over %d polls, %u buffers created%s\n",
+		loaderTime * 1000.0,
+		readyCount,
+		polls,
+		device.GetCommandCount(RenderCommandCreateBuffer),
+		notReady ? " (some failed to load)" : "");
+
+	for (int i = 0; i < loadCount; i++)
+		delete meshes[i];
+}
+
+void Benchmarks::PackedVertices()
+{
+	printf("Vertex packing (%u -> %u bytes per vertex)\n", (unsigned)sizeof(Vertex), (unsigned)sizeof(PackedVertex));
+	printf("  %-32s %10s %10s %10s %10s %10s\n", "file", "full KB", "packed KB", "pos err", "nrm deg", "uv err");
+
+	for (int f = 0; f < modelFileCount; f++)
+	{
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		if (!Mesh::ImportObj(modelFiles[f], true, &verts, &indices))
+		{
+			printf("  %-32s (missing)\n", modelFiles[f]);
+			continue;
+		}
+
+		XMFLOAT3 boundsMin, boundsMax;
+		Mesh::CalculateBounds(&verts[0], (int)verts.size(), &boundsMin, &boundsMax);
+
+		std::vector<PackedVertex> packed(verts.size());
+		VertexPacking::Pack(&verts[0], (int)verts.size(), boundsMin, boundsMax, &packed[0]);
+
+		// Worst case over every vertex, after a full round trip
+		float positionError = 0.0f;
+		float normalError = 0.0f;
+		float uvError = 0.0f;
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			Vertex v = VertexPacking::Unpack(packed[i], boundsMin, boundsMax);
+
+			XMVECTOR position = XMLoadFloat3(&verts[i].Position);
+			XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&verts[i].Normal));
+			float dp = XMVectorGetX(XMVector3Length(XMVectorSubtract(position, XMLoadFloat3(&v.Position))));
+			float cosAngle = XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&v.Normal)));
+			float angle = XMConvertToDegrees(acosf(cosAngle > 1.0f ? 1.0f : cosAngle));
+			float duv = fmaxf(fabsf(verts[i].UV.x - v.UV.x), fabsf(verts[i].UV.y - v.UV.y));
+
+			if (dp > positionError) positionError = dp;
+			if (angle > normalError) normalError = angle;
+			if (duv > uvError) uvError = duv;
+		}
+
+		printf("  %-32s %10.1f %10.1f %10.6f %10.4f %10.6f\n",
+			modelFiles[f],
+			verts.size() * sizeof(Vertex) / 1024.0,
+			packed.size() * sizeof(PackedVertex) / 1024.0,
+			positionError,
+			normalError,
+			uvError);
+	}
+}
+
+void Benchmarks::TransformUpdate()
+{
+	const unsigned int counts[] = { 1000, 100000, 1000000 };
+	const int frames = 10;
+
+	printf("Transform update (all objects moving, %d frames each)\n", frames);
+	printf("  %-10s %14s %14s %10s\n", "objects", "scalar Mmat/s", "SIMD Mmat/s", "speedup");
+
+	for (int c = 0; c < 3; c++)
+	{
+		unsigned int count = counts[c];
+
+		TransformSystem transforms;
+		transforms.Reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int id = transforms.Add();
+			transforms.SetTranslation(id, (float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+			transforms.SetScale(id, 1.0f, 2.0f, 0.5f);
+		}
+
+		// Only the rebuilds are timed, not marking things dirty
+		double scalarTime = 0.0;
+		double simdTime = 0.0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				transforms.SetRotation(i, frame * 0.1f, i * 0.001f, 0.2f);
+			double start = Now();
+			benchmarkSink += transforms.UpdateWorldMatricesScalar();
+			scalarTime += Now() - start;
+
+			for (unsigned int i = 0; i < count; i++)
+				transforms.SetRotation(i, frame * 0.1f, i * 0.001f, 0.2f);
+			start = Now();
+			benchmarkSink += transforms.UpdateWorldMatrices();
+			simdTime += Now() - start;
+		}
+
+		double matrices = (double)count * frames;
+		printf("  %-10u %14.2f %14.2f %9.2fx\n",
+			count,
+			matrices / scalarTime / 1e6,
+			matrices / simdTime / 1e6,
+			scalarTime / simdTime);
+	}
+}
+
+// The old layout: every entity its own heap object
+struct HeapEntity
+{
+	Mesh* mesh;
+	Material* material;
+	XMFLOAT4X4 world;
+	EntityBounds bounds;
+};
+
+void Benchmarks::EntityIteration()
+{
+	const unsigned int counts[] = { 100000, 1000000 };
+	const int passes = 10;
+	Mesh mesh;
+
+	printf("Entity iteration (bounds + mesh + world per entity, %d passes)\n", passes);
+	printf("  %-10s %14s %14s %14s\n", "entities", "heap M/s", "registry M/s", "after churn");
+
+	for (int c = 0; c < 2; c++)
+	{
+		unsigned int count = counts[c];
+		std::mt19937 random(1234);
+
+		// Allocated one by one with other allocations in between,
+		// then visited in a shuffled order, like a long-running scene
+		std::vector<HeapEntity*> heapEntities(count);
+		std::vector<char*> clutter(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			heapEntities[i] = new HeapEntity();
+			heapEntities[i]->mesh = &mesh;
+			heapEntities[i]->material = 0;
+			heapEntities[i]->bounds.Center = XMFLOAT3((float)i, 0, 0);
+			clutter[i] = new char[16 + random() % 256];
+		}
+		std::shuffle(heapEntities.begin(), heapEntities.end(), random);
+
+		EntityRegistry registry;
+		registry.Reserve(count);
+		std::vector<EntityHandle> handles(count);
+		for (unsigned int i = 0; i < count; i++)
+			handles[i] = registry.Create(&mesh, 0);
+		registry.Update();
+
+		// Heap objects: one pointer chase per entity
+		double start = Now();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			float sum = 0.0f;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				HeapEntity* e = heapEntities[i];
+				sum += e->bounds.Center.x + e->world._14;
+				benchmarkSink += e->mesh != 0;
+			}
+			benchmarkSink += (unsigned int)sum;
+		}
+		double heapTime = Now() - start;
+
+		// Registry: straight down the arrays
+		start = Now();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			float sum = 0.0f;
+			unsigned int n = registry.GetCount();
+			Mesh* const* meshes = registry.GetMeshes();
+			const EntityBounds* bounds = registry.GetBounds();
+			const XMFLOAT4X4* worlds = registry.GetWorldMatrices();
+			for (unsigned int i = 0; i < n; i++)
+			{
+				sum += bounds[i].Center.x + worlds[i]._14;
+				benchmarkSink += meshes[i] != 0;
+			}
+			benchmarkSink += (unsigned int)sum;
+		}
+		double registryTime = Now() - start;
+
+		// Destroy and recreate a quarter of the entities at random -
+		// the arrays stay dense, so iteration speed shouldn't change
+		for (unsigned int i = 0; i < count / 4; i++)
+		{
+			unsigned int victim = random() % count;
+			registry.Destroy(handles[victim]);
+			handles[victim] = registry.Create(&mesh, 0);
+		}
+		registry.Update();
+
+		start = Now();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			float sum = 0.0f;
+			unsigned int n = registry.GetCount();
+			Mesh* const* meshes = registry.GetMeshes();
+			const EntityBounds* bounds = registry.GetBounds();
+			const XMFLOAT4X4* worlds = registry.GetWorldMatrices();
+			for (unsigned int i = 0; i < n; i++)
+			{
+				sum += bounds[i].Center.x + worlds[i]._14;
+				benchmarkSink += meshes[i] != 0;
+			}
+			benchmarkSink += (unsigned int)sum;
+		}
+		double churnTime = Now() - start;
+
+		double visited = (double)count * passes;
+		printf("  %-10u %14.1f %14.1f %14.1f\n",
+			count,
+			visited / heapTime / 1e6,
+			visited / registryTime / 1e6,
+			visited / churnTime / 1e6);
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			delete heapEntities[i];
+			delete[] clutter[i];
+		}
+	}
+}
+
+void Benchmarks::HierarchyUpdate()
+{
+	const unsigned int nodeCount = 100000;
+	const int frames = 20;
+
+	// Deep: 100 chains, 1000 long.  Wide: 1000 roots with 99 children each.
+	const char* shapes[] = { "deep (100 x 1000)", "wide (1000 x 99)" };
+	const unsigned int groupSizes[] = { 1000, 100 };
+
+	printf("Hierarchy update (%u nodes, %d frames each)\n", nodeCount, frames);
+	printf("  %-20s %8s %12s %14s\n", "shape", "moving", "ms/frame", "rebuilt/frame");
+
+	for (int s = 0; s < 2; s++)
+	{
+		TransformHierarchy hierarchy;
+		for (unsigned int i = 0; i < nodeCount; i++)
+		{
+			bool first = i % groupSizes[s] == 0;
+			int parent = first ? -1 : (s == 0 ? (int)i - 1 : (int)(i - i % groupSizes[s]));
+			hierarchy.Add(i, parent);
+		}
+
+		// Small offsets, so the matrices stay well behaved however deep they go
+		std::vector<XMFLOAT4X4> locals(nodeCount);
+		std::vector<XMFLOAT4X4> worlds(nodeCount);
+		for (unsigned int i = 0; i < nodeCount; i++)
+			XMStoreFloat4x4(&locals[i], XMMatrixTranspose(XMMatrixRotationY(0.001f) * XMMatrixTranslation(0.01f, 0, 0)));
+		hierarchy.Update(&locals[0], &worlds[0]);
+
+		const unsigned int movingCounts[] = { nodeCount / 100, nodeCount };
+		const char* movingNames[] = { "1%", "100%" };
+		for (int m = 0; m < 2; m++)
+		{
+			std::mt19937 random(42);
+			double time = 0.0;
+			unsigned int rebuilt = 0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (unsigned int i = 0; i < movingCounts[m]; i++)
+					hierarchy.MarkDirty(movingCounts[m] == nodeCount ? i : random() % nodeCount);
+
+				double start = Now();
+				rebuilt += hierarchy.Update(&locals[0], &worlds[0]);
+				time += Now() - start;
+			}
+
+			printf("  %-20s %8s %12.3f %14u\n", shapes[s], movingNames[m], time * 1000.0 / frames, rebuilt / frames);
+		}
+	}
+}
+
+// Boxes scattered through a cube "size" wide, like a large open scene
+static void ScatterBounds(std::vector<EntityBounds>* bounds, unsigned int count, float size, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-size * 0.5f, size * 0.5f);
+	std::uniform_real_distribution<float> extent(0.5f, 5.0f);
+
+	bounds->resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		EntityBounds& b = (*bounds)[i];
+		b.Center = XMFLOAT3(position(random), position(random), position(random));
+		b.Extents = XMFLOAT3(extent(random), extent(random), extent(random));
+		b.Radius = sqrtf(b.Extents.x * b.Extents.x + b.Extents.y * b.Extents.y + b.Extents.z * b.Extents.z);
+	}
+}
+
+void Benchmarks::FrustumCulling()
+{
+	const unsigned int counts[] = { 100000, 1000000 };
+	const int passes = 20;
+
+	// A camera in the middle of the scatter, looking down +z,
+	// so roughly one entity in ten ends up inside the frustum
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(
+		XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0))));
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(
+		0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f)));
+
+	FrustumCuller culler;
+	culler.SetPlanes(view, projection);
+
+	printf("Frustum culling (%d passes each)\n", passes);
+	printf("  %-10s %8s %10s %10s %14s %14s\n", "entities", "method", "visible", "ms/pass", "tested/ms", "culled/ms");
+
+	for (int c = 0; c < 2; c++)
+	{
+		unsigned int count = counts[c];
+		std::vector<EntityBounds> bounds;
+		ScatterBounds(&bounds, count, 1000.0f, 42);
+
+		std::vector<unsigned char> visible(count);
+		const char* methods[] = { "scalar", "SIMD" };
+		for (int m = 0; m < 2; m++)
+		{
+			unsigned int visibleCount = 0;
+			double start = Now();
+			for (int pass = 0; pass < passes; pass++)
+			{
+				visibleCount = m == 0
+					? culler.CullScalar(&bounds[0], count, &visible[0])
+					: culler.Cull(&bounds[0], count, &visible[0]);
+			}
+			double ms = (Now() - start) * 1000.0 / passes;
+			benchmarkSink += visible[count / 2];
+
+			printf("  %-10u %8s %10u %10.3f %14.0f %14.0f\n",
+				count, methods[m], visibleCount, ms, count / ms, (count - visibleCount) / ms);
+		}
+	}
+}
+
+void Benchmarks::BvhBuildAndRefit()
+{
+	const unsigned int counts[] = { 100000, 500000 };
+	const int frames = 30;
+
+	printf("BVH build and refit (entities drift for %d frames)\n", frames);
+	printf("  %-10s %-14s %10s %10s %10s %10s\n", "entities", "rebuilds", "build ms", "refit ms", "rebuilt", "cost x");
+
+	for (int c = 0; c < 2; c++)
+	{
+		unsigned int count = counts[c];
+		std::vector<EntityBounds> start;
+		ScatterBounds(&start, count, 1000.0f, 42);
+
+		// Every entity heads off in its own direction, so boxes
+		// that were tight when built keep getting looser
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+		std::vector<XMFLOAT3> velocities(count);
+		for (unsigned int i = 0; i < count; i++)
+			velocities[i] = XMFLOAT3(speed(random), speed(random), speed(random));
+
+		const char* modes[] = { "refit only", "incremental" };
+		const float thresholds[] = { FLT_MAX, 1.5f };
+		for (int m = 0; m < 2; m++)
+		{
+			std::vector<EntityBounds> bounds = start;
+			BoundingVolumeHierarchy tree;
+			tree.SetRebuildThreshold(thresholds[m]);
+
+			double buildStart = Now();
+			tree.Build(&bounds[0], count);
+			double buildTime = Now() - buildStart;
+			float builtCost = tree.GetCost();
+
+			double refitTime = 0.0;
+			unsigned int rebuilt = 0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					bounds[i].Center.x += velocities[i].x;
+					bounds[i].Center.y += velocities[i].y;
+					bounds[i].Center.z += velocities[i].z;
+				}
+
+				double refitStart = Now();
+				tree.Refit(&bounds[0]);
+				refitTime += Now() - refitStart;
+				rebuilt += tree.GetRebuiltCount();
+			}
+
+			// How much worse the tree is than when it was built
+			printf("  %-10u %-14s %10.2f %10.2f %10u %10.2f\n",
+				count, modes[m], buildTime * 1000.0, refitTime * 1000.0 / frames, rebuilt, tree.GetCost() / builtCost);
+		}
+	}
+}
+
+void Benchmarks::BvhQueries()
+{
+	const unsigned int count = 500000;
+	const int passes = 20;
+	const int rayCount = 1000;
+
+	std::vector<EntityBounds> bounds;
+	ScatterBounds(&bounds, count, 1000.0f, 42);
+
+	BoundingVolumeHierarchy tree;
+	tree.Build(&bounds[0], count);
+
+	printf("BVH queries (%u entities)\n", count);
+	printf("  %-24s %12s %12s %10s\n", "query", "linear ms", "BVH ms", "results");
+
+	// Frustum: a camera in the middle looking down +z, far plane 300 away
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(
+		XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0))));
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(
+		0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 300.0f)));
+	FrustumCuller culler;
+	culler.SetPlanes(view, projection);
+
+	std::vector<unsigned char> flags(count);
+	unsigned int linearVisible = 0;
+	double start = Now();
+	for (int pass = 0; pass < passes; pass++)
+		linearVisible = culler.Cull(&bounds[0], count, &flags[0]);
+	double linearTime = (Now() - start) / passes;
+
+	std::vector<unsigned int> visible;
+	start = Now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		visible.clear();
+		tree.CullFrustum(&culler, &bounds[0], &visible);
+	}
+	double treeTime = (Now() - start) / passes;
+
+	printf("  %-24s %12.3f %12.3f %10u\n", "frustum (per pass)", linearTime * 1000.0, treeTime * 1000.0, (unsigned int)visible.size());
+	if (visible.size() != linearVisible)
+		printf("  (linear found %u)\n", linearVisible);
+
+	// Rays: from random points, in random directions
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> origins(rayCount);
+	std::vector<XMFLOAT3> directions(rayCount);
+	for (int r = 0; r < rayCount; r++)
+	{
+		origins[r] = XMFLOAT3(position(random), position(random), position(random));
+		directions[r] = XMFLOAT3(direction(random), direction(random), direction(random));
+	}
+
+	unsigned int linearHits = 0;
+	start = Now();
+	for (int r = 0; r < rayCount; r++)
+	{
+		// The same slab test the tree uses, against every entity
+		XMFLOAT3 o = origins[r];
+		XMFLOAT3 inv(1.0f / directions[r].x, 1.0f / directions[r].y, 1.0f / directions[r].z);
+		float best = FLT_MAX;
+		int hit = -1;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const EntityBounds& b = bounds[i];
+			float x0 = (b.Center.x - b.Extents.x - o.x) * inv.x, x1 = (b.Center.x + b.Extents.x - o.x) * inv.x;
+			float y0 = (b.Center.y - b.Extents.y - o.y) * inv.y, y1 = (b.Center.y + b.Extents.y - o.y) * inv.y;
+			float z0 = (b.Center.z - b.Extents.z - o.z) * inv.z, z1 = (b.Center.z + b.Extents.z - o.z) * inv.z;
+			float entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+			float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::max(z0, z1));
+			if (entry <= exit && entry < best)
+			{
+				best = entry;
+				hit = (int)i;
+			}
+		}
+		linearHits += hit >= 0;
+	}
+	linearTime = Now() - start;
+
+	unsigned int treeHits = 0;
+	start = Now();
+	for (int r = 0; r < rayCount; r++)
+	{
+		float distance;
+		treeHits += tree.RayCast(origins[r], directions[r], &bounds[0], &distance) >= 0;
+	}
+	treeTime = Now() - start;
+
+	printf("  %-24s %12.3f %12.3f %10u\n", "1000 rays (total)", linearTime * 1000.0, treeTime * 1000.0, treeHits);
+	if (treeHits != linearHits)
+		printf("  (linear hit %u)\n", linearHits);
+}
+
+// Shader, material and mesh changes between consecutive keys
+static void CountStateChanges(const unsigned long long* keys, unsigned int count, unsigned int changes[3])
+{
+	const int shifts[3] = { RenderQueue::ShaderShift, RenderQueue::MaterialShift, RenderQueue::MeshShift };
+	const unsigned long long masks[3] = { 0xFFFF, 0xFFF, 0xFFF };
+	for (int s = 0; s < 3; s++)
+	{
+		changes[s] = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (i == 0 || ((keys[i] ^ keys[i - 1]) >> shifts[s] & masks[s]) != 0)
+				changes[s]++;
+		}
+	}
+}
+
+void Benchmarks::RenderQueueSorting()
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	const int passes = 10;
+
+	// 4 shader pairs, 32 materials, 64 meshes, submitted in random order
+	printf("Render queue sorting (%d passes each)\n", passes);
+	printf("  %-10s %12s %12s %10s %10s %10s\n", "objects", "std::sort ms", "radix ms", "shaders", "materials", "meshes");
+
+	for (int c = 0; c < 3; c++)
+	{
+		unsigned int count = counts[c];
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+		std::vector<unsigned long long> keys(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int material = random() % 32;
+			keys[i] = RenderQueue::PackKey(material % 4, material, random() % 64, depth(random));
+		}
+
+		unsigned int unsortedChanges[3];
+		CountStateChanges(&keys[0], count, unsortedChanges);
+
+		std::vector<std::pair<unsigned long long, unsigned int> > pairs(count);
+		double comparisonTime = 0.0;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				pairs[i] = std::make_pair(keys[i], i);
+
+			double start = Now();
+			std::sort(pairs.begin(), pairs.end());
+			comparisonTime += Now() - start;
+		}
+
+		RenderQueue queue;
+		double radixTime = 0.0;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			queue.Clear();
+			for (unsigned int i = 0; i < count; i++)
+				queue.Add(keys[i], i);
+
+			double start = Now();
+			queue.Sort();
+			radixTime += Now() - start;
+		}
+		benchmarkSink += queue.GetValues()[0] + pairs[0].second;
+
+		unsigned int sortedChanges[3];
+		CountStateChanges(queue.GetKeys(), count, sortedChanges);
+
+		printf("  %-10u %12.3f %12.3f %10u %10u %10u  (unsorted)\n",
+			count, comparisonTime * 1000.0 / passes, radixTime * 1000.0 / passes,
+			unsortedChanges[0], unsortedChanges[1], unsortedChanges[2]);
+		printf("  %-10s %12s %12s %10u %10u %10u  (sorted)\n",
+			"", "", "", sortedChanges[0], sortedChanges[1], sortedChanges[2]);
+	}
+}
+
+// --------------------------------------------------------
+// Not a timing: binds a known sequence through a StateCache
+// in front of a NullRenderDevice, and checks the device's log
+// for exactly the calls that should have got through
+// --------------------------------------------------------
+void Benchmarks::StateCacheFiltering()
+{
+	NullRenderDevice device;
+	StateCache cache(&device);
+
+	int checks = 0;
+	int failures = 0;
+	auto expect = [&](bool condition, const char* what)
+	{
+		checks++;
+		if (!condition)
+		{
+			failures++;
+			printf("  FAILED: %s\n", what);
+		}
+	};
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = 256;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	ID3D11Buffer* vertexBuffers[2] = { device.CreateBuffer(desc, 0), device.CreateBuffer(desc, 0) };
+	desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ID3D11Buffer* indexBuffer = device.CreateBuffer(desc, 0);
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	ID3D11Buffer* constantBuffers[4];
+	for (int i = 0; i < 4; i++)
+		constantBuffers[i] = device.CreateBuffer(desc, 0);
+	ID3D11InputLayout* inputLayout = device.CreateInputLayout(0, 0, 0, 0);
+	ID3D11VertexShader* vertexShader = device.CreateVertexShader(0, 0);
+	ID3D11PixelShader* pixelShader = device.CreatePixelShader(0, 0);
+
+	// The null device can't make views or samplers, but only
+	// logs what it's given, so any distinct pointers will do
+	ID3D11ShaderResourceView* views[2] = { (ID3D11ShaderResourceView*)(size_t)1000, (ID3D11ShaderResourceView*)(size_t)1001 };
+	ID3D11SamplerState* sampler = (ID3D11SamplerState*)(size_t)2000;
+
+	UINT strides[2] = { sizeof(Vertex), sizeof(Vertex) };
+	UINT offsets[2] = { 0, 0 };
+
+	// Everything a draw binds - one call of each kind, 12 in all
+	const unsigned int bindCalls = 12;
+	auto bindAll = [&]()
+	{
+		cache.IASetInputLayout(inputLayout);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		cache.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		cache.IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		cache.VSSetShader(vertexShader);
+		cache.VSSetConstantBuffers(0, 3, constantBuffers);
+		cache.VSSetShaderResources(0, 2, views);
+		cache.VSSetSamplers(0, 1, &sampler);
+		cache.PSSetShader(pixelShader);
+		cache.PSSetConstantBuffers(0, 3, constantBuffers);
+		cache.PSSetShaderResources(0, 2, views);
+		cache.PSSetSamplers(0, 1, &sampler);
+	};
+
+	device.ClearCommands();
+	bindAll();
+	expect(device.GetCommandCount() == bindCalls, "first binds all reach the device");
+
+	device.ClearCommands();
+	cache.ResetCounters();
+	bindAll();
+	expect(device.GetCommandCount() == 0, "repeated IASet*/VSSet*/PSSet* calls are all dropped");
+	expect(cache.GetFilteredCount() == bindCalls && cache.GetIssuedCount() == 0, "dropped calls are counted as filtered");
+
+	// Ranges are trimmed to the slots that change
+	ID3D11Buffer* oneChanged[3] = { constantBuffers[0], constantBuffers[3], constantBuffers[2] };
+	device.ClearCommands();
+	cache.VSSetConstantBuffers(0, 3, oneChanged);
+	const RenderCommand* command = device.GetCommands();
+	expect(device.GetCommandCount() == 1 &&
+		command->Type == RenderCommandVSSetConstantBuffers && command->Slot == 1 && command->Count == 1,
+		"a range with one new buffer is trimmed to that slot");
+
+	UINT offsetsChanged[2] = { 0, 64 };
+	device.ClearCommands();
+	cache.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsetsChanged);
+	command = device.GetCommands();
+	expect(device.GetCommandCount() == 1 &&
+		command->Type == RenderCommandIASetVertexBuffers && command->Slot == 1 && command->Count == 1,
+		"a vertex buffer with only a new offset is rebound alone");
+
+	// The stages are tracked apart: the pixel shader still has
+	// the original buffers
+	device.ClearCommands();
+	cache.PSSetConstantBuffers(0, 3, constantBuffers);
+	expect(device.GetCommandCount() == 0, "pixel stage isn't disturbed by vertex stage binds");
+
+	// Offset binds always go through, and the next plain bind of
+	// those slots has to as well
+	UINT firstConstants[1] = { 0 };
+	UINT constantCounts[1] = { 16 };
+	device.ClearCommands();
+	cache.VSSetConstantBuffers1(0, 1, constantBuffers, firstConstants, constantCounts);
+	cache.VSSetConstantBuffers(0, 1, constantBuffers);
+	expect(device.GetCommandCount(RenderCommandVSSetConstantBuffers1) == 1 &&
+		device.GetCommandCount(RenderCommandVSSetConstantBuffers) == 1,
+		"VSSetConstantBuffers1 is passed on and forgets its slots");
+
+	// Untracked slots are never dropped
+	UINT untracked = StateCache::MaxShaderResources;
+	device.ClearCommands();
+	cache.PSSetShaderResources(untracked, 1, views);
+	cache.PSSetShaderResources(untracked, 1, views);
+	expect(device.GetCommandCount() == 2, "slots past the tracked ones always go through");
+
+	device.ClearCommands();
+	cache.Invalidate();
+	bindAll();
+	expect(device.GetCommandCount() == bindCalls, "Invalidate() lets every bind through again");
+
+	if (failures == 0)
+		printf("State cache filtering (null device): all %d checks passed\n", checks);
+	else
+		printf("State cache filtering (null device): %d of %d checks FAILED\n", failures, checks);
+}
+
+// --------------------------------------------------------
+// A shader with some matrices in one constant buffer but no
+// GPU objects, so its variables can be set without a device
+// --------------------------------------------------------
+class BenchmarkShader : public ISimpleShader
+{
+public:
+	BenchmarkShader(const char* bufferName, const char* const* names, int count) : ISimpleShader(0, 0)
+	{
+		constantBufferCount = 1;
+		constantBuffers = new SimpleConstantBuffer[1];
+		constantBuffers[0].Name = bufferName;
+		constantBuffers[0].Size = sizeof(XMFLOAT4X4) * count;
+		constantBuffers[0].ConstantBuffer = 0;
+		constantBuffers[0].LocalDataBuffer = new unsigned char[constantBuffers[0].Size]();
+		constantBuffers[0].Dirty = true;
+		constantBuffers[0].Dynamic = false;
+
+		for (int v = 0; v < count; v++)
+		{
+			SimpleShaderVariable var;
+			var.ByteOffset = sizeof(XMFLOAT4X4) * v;
+			var.Size = sizeof(XMFLOAT4X4);
+			var.ConstantBufferIndex = 0;
+
+			varTable[names[v]] = (SimpleShaderHandle)variables.size();
+			varHashTable[SimpleShaderName(names[v]).Hash] = (SimpleShaderHandle)variables.size();
+			variables.push_back(var);
+			constantBuffers[0].Variables.push_back(var);
+		}
+		shaderValid = true;
+	}
+
+	// Stands in for UploadBuffer(): copies the local data out
+	// (as a Map/WRITE_DISCARD would) if it changed
+	bool Upload(void* mapped)
+	{
+		if (!constantBuffers[0].Dirty)
+			return false;
+		memcpy(mapped, constantBuffers[0].LocalDataBuffer, constantBuffers[0].Size);
+		constantBuffers[0].Dirty = false;
+		return true;
+	}
+
+	~BenchmarkShader()
+	{
+		delete[] constantBuffers[0].LocalDataBuffer;
+		delete[] constantBuffers;
+	}
+
+	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) { return false; }
+	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) { return false; }
+
+protected:
+	bool CreateShader(ID3DBlob* shaderBlob) { return false; }
+	void SetShaderAndCBs() {}
+};
+
+void Benchmarks::ShaderVariableSets()
+{
+	const int sets = 4000000;
+	static constexpr SimpleShaderName worldName("world");
+
+	// Different matrices, so every set really writes
+	std::vector<XMFLOAT4X4> matrices(256);
+	for (size_t i = 0; i < matrices.size(); i++)
+		XMStoreFloat4x4(&matrices[i], XMMatrixTranslation((float)i, 0.0f, 0.0f));
+
+	const char* names[] = { "world", "view", "projection" };
+	BenchmarkShader shader("externalData", names, 3);
+	double times[3];
+	unsigned int succeeded = 0;
+
+	// The way the renderer used to do it: a std::string per call
+	double start = Now();
+	for (int i = 0; i < sets; i++)
+		succeeded += shader.SetMatrix4x4("world", matrices[i & 255]);
+	times[0] = Now() - start;
+
+	// Looking the handle up by hashed name every call
+	start = Now();
+	for (int i = 0; i < sets; i++)
+		succeeded += shader.SetMatrix4x4(shader.GetVariableHandle(worldName), matrices[i & 255]);
+	times[1] = Now() - start;
+
+	// Handle resolved once
+	SimpleShaderHandle world = shader.GetVariableHandle("world");
+	start = Now();
+	for (int i = 0; i < sets; i++)
+		succeeded += shader.SetMatrix4x4(world, matrices[i & 255]);
+	times[2] = Now() - start;
+	benchmarkSink += succeeded;
+
+	const char* labels[3] = { "name string", "hashed name", "handle" };
+	printf("Shader variable sets (%d float4x4 sets each)\n", sets);
+	printf("  %-12s %12s %10s %10s\n", "path", "Msets/s", "ns/set", "speedup");
+	for (int p = 0; p < 3; p++)
+	{
+		printf("  %-12s %12.2f %10.2f %9.2fx\n",
+			labels[p], sets / times[p] / 1000000.0, times[p] * 1000000000.0 / sets, times[0] / times[p]);
+	}
+}
+
+// --------------------------------------------------------
+// Runs what the vertex shader does for every vertex, on the
+// CPU: before, two matrix-matrix multiplies to combine world,
+// view and projection, then the position and normal
+// transforms; after, just the transforms, with the combined
+// matrices worked out once per object.
+//
+// Multiply-adds per vertex are counted the way the GPU does
+// them: 64 per 4x4 * 4x4, 16 per float4 * 4x4, 9 per
+// float3 * 3x3.
+// --------------------------------------------------------
+void Benchmarks::VertexTransformCost()
+{
+	const unsigned int objects = 1000;
+	const unsigned int verticesPerObject = 1000;
+	const int passes = 5;
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT4> positions(verticesPerObject);
+	std::vector<XMFLOAT3> normals(verticesPerObject);
+	for (unsigned int v = 0; v < verticesPerObject; v++)
+	{
+		positions[v] = XMFLOAT4(unit(random), unit(random), unit(random), 1.0f);
+		normals[v] = XMFLOAT3(unit(random), unit(random), unit(random));
+	}
+
+	// Non-uniformly scaled, rotated objects in front of a camera
+	XMMATRIX view = XMMatrixTranslation(0.0f, 0.0f, 50.0f);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f);
+	std::vector<XMFLOAT4X4> worlds(objects);
+	for (unsigned int i = 0; i < objects; i++)
+	{
+		XMMATRIX world =
+			XMMatrixScaling(1.0f + i % 3, 1.0f, 0.5f) *
+			XMMatrixRotationY(i * 0.01f) *
+			XMMatrixTranslation((float)(i % 32), (float)(i / 32), 0.0f);
+		XMStoreFloat4x4(&worlds[i], world);
+	}
+
+	XMVECTOR sum = XMVectorZero();
+	double perVertexTime = 0.0;
+	double perObjectTime = 0.0;
+	double precomputeTime = 0.0;
+	std::vector<ObjectMatrices> matrices(objects);
+	for (int pass = 0; pass < passes; pass++)
+	{
+		// Before: the shader combined the matrices itself
+		double start = Now();
+		for (unsigned int i = 0; i < objects; i++)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			for (unsigned int v = 0; v < verticesPerObject; v++)
+			{
+				XMMATRIX worldViewProj = XMMatrixMultiply(XMMatrixMultiply(world, view), projection);
+				XMVECTOR position = XMVector4Transform(XMLoadFloat4(&positions[v]), worldViewProj);
+				XMVECTOR normal = XMVector3TransformNormal(XMLoadFloat3(&normals[v]), world);
+				sum = XMVectorAdd(sum, XMVectorAdd(position, normal));
+			}
+		}
+		perVertexTime += Now() - start;
+
+		// After: once per object on the CPU (the renderer's
+		// matrices are transposed, as the shaders want them)...
+		start = Now();
+		XMFLOAT4X4 viewProjectionT;
+		XMStoreFloat4x4(&viewProjectionT, XMMatrixTranspose(XMMatrixMultiply(view, projection)));
+		for (unsigned int i = 0; i < objects; i++)
+		{
+			XMFLOAT4X4 worldT;
+			XMStoreFloat4x4(&worldT, XMMatrixTranspose(XMLoadFloat4x4(&worlds[i])));
+			InstancedRenderer::ComputeObjectMatrices(worldT, viewProjectionT, &matrices[i]);
+		}
+		precomputeTime += Now() - start;
+
+		// ...then only the transforms per vertex
+		start = Now();
+		for (unsigned int i = 0; i < objects; i++)
+		{
+			XMMATRIX worldViewProj = XMMatrixTranspose(XMLoadFloat4x4(&matrices[i].WorldViewProjection));
+			XMMATRIX normalMatrix = XMMatrixTranspose(XMLoadFloat4x4(&matrices[i].WorldInverseTranspose));
+			for (unsigned int v = 0; v < verticesPerObject; v++)
+			{
+				XMVECTOR position = XMVector4Transform(XMLoadFloat4(&positions[v]), worldViewProj);
+				XMVECTOR normal = XMVector3TransformNormal(XMLoadFloat3(&normals[v]), normalMatrix);
+				sum = XMVectorAdd(sum, XMVectorAdd(position, normal));
+			}
+		}
+		perObjectTime += Now() - start;
+	}
+	benchmarkSink += (unsigned int)XMVectorGetX(sum);
+
+	double vertices = (double)objects * verticesPerObject * passes;
+	printf("Vertex transform cost (%u objects x %u vertices, %d passes)\n", objects, verticesPerObject, passes);
+	printf("  %-26s %10s %10s %12s\n", "path", "mads/vert", "ns/vert", "ns/object");
+	printf("  %-26s %10d %10.2f %12s\n", "combine per vertex", 64 * 2 + 16 + 9, perVertexTime * 1e9 / vertices, "-");
+	printf("  %-26s %10d %10.2f %12.2f\n", "combine once per object", 16 + 9,
+		perObjectTime * 1e9 / vertices, precomputeTime * 1e9 / (objects * passes));
+}
+
+// --------------------------------------------------------
+// The CPU side of getting each object's ObjectMatrices to
+// its draw, for a frame of objects drawn one by one
+//
+// Before: set both matrices on the shader, then upload its
+// "perObject" buffer (one Map/Unmap per object).  After:
+// copy the matrices straight into 256-byte slots of one
+// ConstantRingBuffer-style block (one Map/Unmap per frame),
+// then bind each object's offset.
+//
+// There's no device here, so Map is a plain memcpy into
+// memory; the driver's per-Map cost, which the ring buffer
+// avoids, isn't counted.
+// --------------------------------------------------------
+void Benchmarks::ObjectConstantSetup()
+{
+	const unsigned int objects = 10000;
+	const int passes = 50;
+
+	std::vector<ObjectMatrices> matrices(objects);
+	for (unsigned int i = 0; i < objects; i++)
+	{
+		XMStoreFloat4x4(&matrices[i].WorldViewProjection, XMMatrixTranslation((float)i, 0.0f, 0.0f));
+		XMStoreFloat4x4(&matrices[i].WorldInverseTranspose, XMMatrixScaling(1.0f, (float)i, 1.0f));
+	}
+
+	const char* names[] = { "worldViewProj", "worldInverseTranspose" };
+	BenchmarkShader shader("perObject", names, 2);
+	SimpleShaderHandle worldViewProj = shader.GetVariableHandle("worldViewProj");
+	SimpleShaderHandle worldInverseTranspose = shader.GetVariableHandle("worldInverseTranspose");
+
+	// A discarding Map hands back fresh memory each time, so
+	// every object's upload lands somewhere new, as in the ring
+	unsigned int slotSize = ConstantRingBuffer::AlignedSize(sizeof(ObjectMatrices));
+	std::vector<unsigned char> discardMemory(sizeof(ObjectMatrices) * objects);
+	std::vector<unsigned char> ring(slotSize * objects);
+	std::vector<ConstantAllocation> allocations(objects);
+
+	double perObjectTime = 0.0;
+	double ringTime = 0.0;
+	unsigned int uploads = 0;
+	for (int pass = 0; pass < passes; pass++)
+	{
+		double start = Now();
+		for (unsigned int i = 0; i < objects; i++)
+		{
+			shader.SetMatrix4x4(worldViewProj, matrices[i].WorldViewProjection);
+			shader.SetMatrix4x4(worldInverseTranspose, matrices[i].WorldInverseTranspose);
+			uploads += shader.Upload(&discardMemory[sizeof(ObjectMatrices) * i]);
+		}
+		perObjectTime += Now() - start;
+
+		start = Now();
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < objects; i++)
+		{
+			allocations[i].FirstConstant = offset / 16;
+			allocations[i].ConstantCount = slotSize / 16;
+			memcpy(&ring[offset], &matrices[i], sizeof(ObjectMatrices));
+			offset += slotSize;
+		}
+		ringTime += Now() - start;
+	}
+	benchmarkSink += uploads + discardMemory[5] + ring[ring.size() - 16] + allocations[objects - 1].FirstConstant;
+
+	// Map + Unmap per upload, plus (for the ring) a bind per object
+	printf("Per-object constant setup (%u objects, %d passes)\n", objects, passes);
+	printf("  %-22s %10s %12s %12s\n", "path", "ns/object", "maps/frame", "calls/frame");
+	printf("  %-22s %10.2f %12u %12u\n", "shader buffer per draw",
+		perObjectTime * 1e9 / ((double)objects * passes), objects, objects * 2);
+	printf("  %-22s %10.2f %12u %12u\n", "ring buffer",
+		ringTime * 1e9 / ((double)objects * passes), 1u, 2 + objects);
+}
+
+// --------------------------------------------------------
+// A 1280x720 frame of the game's models in a grid, lit like
+// the game, drawn by SoftwareRasterizer on one thread and
+// then with one job per tile
+//
+// Both runs should produce exactly the same image; the
+// threaded one is saved as SoftwareRasterizer.bmp to compare
+// against a screenshot of the D3D path.
+// --------------------------------------------------------
+void Benchmarks::SoftwareRasterization()
+{
+	const unsigned int width = 1280;
+	const unsigned int height = 720;
+	const int columns = 8;
+	const int rows = 5;
+	const int frames = 10;
+
+	std::vector<MeshData*> meshes;
+	for (int m = 0; m < modelFileCount; m++)
+	{
+		MeshData* data = new MeshData();
+		if (Mesh::LoadObjData(modelFiles[m], true, data))
+			meshes.push_back(data);
+		else
+			delete data;
+	}
+	if (meshes.empty())
+	{
+		printf("Software rasterization: no models loaded\n");
+		return;
+	}
+
+	// The game's camera and lights
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 0, -5, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, (float)width / height, 0.1f, 100.0f);
+	XMFLOAT4X4 viewProjectionT;
+	XMStoreFloat4x4(&viewProjectionT, XMMatrixTranspose(XMMatrixMultiply(view, projection)));
+
+	DirectionalLight light1 = { XMFLOAT4(0.1f, 0.1f, 0.1f, 1.0f), XMFLOAT4(0, 0, 1, 1), XMFLOAT3(1, -1, 0) };
+	DirectionalLight light2 = { XMFLOAT4(0.1f, 0.1f, 0.1f, 1.0f), XMFLOAT4(1, 0, 0, 1), XMFLOAT3(-1, 1, 0) };
+	const float clearColor[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+	const XMFLOAT4 white(1, 1, 1, 1);
+
+	// Each model scaled to about the same size, turned a little
+	std::vector<ObjectMatrices> objects(columns * rows);
+	for (int i = 0; i < columns * rows; i++)
+	{
+		const MeshData* mesh = meshes[i % meshes.size()];
+		float scale = 0.9f / (mesh->BoundsRadius > 0.0f ? mesh->BoundsRadius : 1.0f);
+		XMMATRIX world =
+			XMMatrixScaling(scale, scale, scale) *
+			XMMatrixRotationRollPitchYaw(0.4f + i * 0.3f, i * 0.7f, 0.0f) *
+			XMMatrixTranslation((i % columns - (columns - 1) * 0.5f) * 2.0f, (i / columns - (rows - 1) * 0.5f) * -2.0f, 12.0f);
+
+		XMFLOAT4X4 worldT;
+		XMStoreFloat4x4(&worldT, XMMatrixTranspose(world));
+		InstancedRenderer::ComputeObjectMatrices(worldT, viewProjectionT, &objects[i]);
+	}
+
+	JobSystem jobs;
+	SoftwareRasterizer serial(width, height);
+	SoftwareRasterizer tiled(width, height, &jobs);
+	SoftwareRasterizer* rasterizers[2] = { &serial, &tiled };
+	RasterStats totals[2];
+	memset(totals, 0, sizeof(totals));
+
+	for (int r = 0; r < 2; r++)
+	{
+		SoftwareRasterizer* rasterizer = rasterizers[r];
+		rasterizer->SetLights(light1, light2);
+		for (int frame = 0; frame < frames; frame++)
+		{
+			rasterizer->Clear(clearColor);
+			for (int i = 0; i < columns * rows; i++)
+				rasterizer->DrawIndexed(*meshes[i % meshes.size()], objects[i], white);
+			rasterizer->Flush();
+
+			const RasterStats& stats = rasterizer->GetStats();
+			totals[r].Triangles += stats.Triangles;
+			totals[r].TrianglesRasterized += stats.TrianglesRasterized;
+			totals[r].PixelsShaded += stats.PixelsShaded;
+			totals[r].SetupSeconds += stats.SetupSeconds;
+			totals[r].RasterSeconds += stats.RasterSeconds;
+		}
+	}
+
+	bool same = true;
+	for (unsigned int y = 0; y < height && same; y++)
+		same = memcmp(serial.GetPixels() + y * serial.GetPitch(), tiled.GetPixels() + y * tiled.GetPitch(), width * 4) == 0;
+	bool saved = tiled.SaveBitmap("SoftwareRasterizer.bmp");
+
+	printf("Software rasterization (%ux%u, %d objects, %u triangles/frame, %u drawn, %u pixels shaded)\n",
+		width, height, columns * rows,
+		totals[0].Triangles / frames, totals[0].TrianglesRasterized / frames, totals[0].PixelsShaded / frames);
+	printf("  %-20s %10s %10s %12s %12s\n", "path", "setup ms", "raster ms", "Mtris/s", "Mpixels/s");
+	const char* names[2] = { "one thread", "tile jobs" };
+	for (int r = 0; r < 2; r++)
+	{
+		double seconds = totals[r].SetupSeconds + totals[r].RasterSeconds;
+		printf("  %-20s %10.2f %10.2f %12.2f %12.2f\n", names[r],
+			totals[r].SetupSeconds * 1000.0 / frames,
+			totals[r].RasterSeconds * 1000.0 / frames,
+			totals[r].Triangles / seconds / 1e6,
+			totals[r].PixelsShaded / totals[r].RasterSeconds / 1e6);
+	}
+	printf("  %u workers, images %s, %s\n", jobs.GetWorkerCount(),
+		same ? "identical" : "DIFFER",
+		saved ? "saved to SoftwareRasterizer.bmp" : "couldn't save SoftwareRasterizer.bmp");
+
+	for (size_t m = 0; m < meshes.size(); m++)
+		delete meshes[m];
+}
+
+// --------------------------------------------------------
+// A frame of 20k objects (16 meshes x 16 materials, nothing
+// instanced) drawn by InstancedRenderer into a
+// NullRenderDevice, recording with 1, 2, 4... threads
+//
+// The device reports no D3D11.1 offsets, so every object
+// uploads its matrices through the shader (the heaviest
+// commands to record) and each frame's calls come out exactly
+// the same - so every thread count's log is checked against
+// the single-threaded one.
+//
+// Needs the compiled shaders, so run it from the directory
+// they're built into (as the game does).
+// --------------------------------------------------------
+void Benchmarks::CommandRecording()
+{
+	const unsigned int objects = 20000;
+	const int meshCount = 16;
+	const int materialCount = 16;
+	const int frames = 20;
+
+	NullRenderDevice device(false, false);
+	StateCache stateCache(&device);
+
+	SimpleVertexShader vs(&device);
+	SimplePixelShader ps(&device);
+	vs.LoadShaderFile(L"VertexShader.cso");
+	ps.LoadShaderFile(L"PixelShader.cso");
+	if (!vs.IsShaderValid() || !ps.IsShaderValid())
+	{
+		printf("Command recording: shaders not found\n");
+		return;
+	}
+	vs.SetStateCache(&stateCache);
+	ps.SetStateCache(&stateCache);
+	vs.SetBufferDynamic("perObject", true);
+
+	// A unit cube; the meshes only differ in their buffers
+	Vertex vertices[8];
+	for (int v = 0; v < 8; v++)
+	{
+		vertices[v].Position = XMFLOAT3(v & 1 ? 0.5f : -0.5f, v & 2 ? 0.5f : -0.5f, v & 4 ? 0.5f : -0.5f);
+		vertices[v].Normal = vertices[v].Position;
+		vertices[v].UV = XMFLOAT2(0, 0);
+	}
+	UINT indices[36] = {
+		0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5 };
+
+	std::vector<Mesh*> meshes;
+	for (int m = 0; m < meshCount; m++)
+		meshes.push_back(new Mesh(vertices, 8, indices, 36, &device));
+
+	std::vector<Material*> materials;
+	for (int m = 0; m < materialCount; m++)
+	{
+		materials.push_back(new Material(&vs, &ps));
+		materials.back()->SetColor(XMFLOAT4((float)m / materialCount, 0.5f, 1.0f, 1.0f));
+	}
+
+	std::mt19937 random(23);
+	std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+	std::vector<XMFLOAT4X4> worlds(objects);
+	for (unsigned int i = 0; i < objects; i++)
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranspose(XMMatrixTranslation(spread(random), spread(random), 60.0f + spread(random))));
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(XMVectorSet(0, 0, -5, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0))));
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f)));
+
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	JobSystem jobs(std::max(maxThreads - 1, 1u));
+	InstancedRenderer renderer(&device, &stateCache);
+
+	std::vector<RenderCommand> reference;
+	double baseline = 0.0;
+	printf("Command recording (%u objects, %d frames, null device)\n", objects, frames);
+	printf("  %-8s %10s %12s %12s %12s %10s %6s\n", "threads", "slices", "record ms", "replay ms", "commands", "speedup", "same");
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		double recordTime = 0.0;
+		double replayTime = 0.0;
+		for (int f = 0; f < frames; f++)
+		{
+			renderer.Begin(view, projection);
+			for (unsigned int i = 0; i < objects; i++)
+				renderer.Add(meshes[i % meshCount], materials[(i / meshCount) % materialCount], worlds[i]);
+			renderer.End();
+
+			device.ClearCommands();
+			renderer.Draw(threads > 1 ? &jobs : 0, threads);
+			recordTime += renderer.GetStats().RecordSeconds;
+			replayTime += renderer.GetStats().ReplaySeconds;
+		}
+
+		if (threads == 1)
+		{
+			reference.assign(device.GetCommands(), device.GetCommands() + device.GetCommandCount());
+			baseline = recordTime;
+		}
+		bool same =
+			device.GetCommandCount() == reference.size() &&
+			memcmp(device.GetCommands(), &reference[0], sizeof(RenderCommand) * reference.size()) == 0;
+
+		const RenderStats& stats = renderer.GetStats();
+		printf("  %-8u %10u %12.3f %12.3f %12u %9.2fx %6s\n",
+			threads, stats.Slices, recordTime * 1000.0 / frames, replayTime * 1000.0 / frames,
+			stats.Commands, baseline / recordTime, same ? "yes" : "NO");
+
+		if (threads == maxThreads)
+			break;
+	}
+
+	for (size_t m = 0; m < materials.size(); m++)
+		delete materials[m];
+	for (size_t m = 0; m < meshes.size(); m++)
+		delete meshes[m];
+}
+
+// Busy for the given time, as a stand-in for real work
+static void Spin(double seconds)
+{
+	double end = Now() + seconds;
+	while (Now() < end)
+		benchmarkSink++;
+}
+
+void Benchmarks::FramePipelining()
+{
+	const unsigned int frames = 200;
+
+	// Milliseconds of update and draw per frame; draw alternates
+	// between its two costs, as a frame with a spike would
+	struct Workload
+	{
+		const char* Name;
+		double UpdateMs;
+		double DrawMs[2];
+	};
+	const Workload workloads[] =
+	{
+		{ "balanced 2/2 ms",		2.0, { 2.0, 2.0 } },
+		{ "update-heavy 3/1 ms",	3.0, { 1.0, 1.0 } },
+		{ "draw spikes 2/1-4 ms",	2.0, { 1.0, 4.0 } },
+	};
+
+	printf("Frame pipelining (%u frames, spinning update/draw, %u cores)\n", frames, std::thread::hardware_concurrency());
+	printf("  %-22s %6s %10s %10s %12s %12s %10s %6s\n", "workload", "depth", "frames/s", "speedup", "latency ms", "max ms", "wait ms", "order");
+	for (const Workload& workload : workloads)
+	{
+		double baseline = 0.0;
+		for (unsigned int depth = 1; depth <= 4; depth++)
+		{
+			// Each slot carries its frame number, to check the render
+			// thread sees every frame once, in order, unchanged
+			std::vector<unsigned int> snapshots(depth);
+			unsigned int nextDrawn = 0;
+			bool inOrder = true;
+
+			FramePipelineStats stats;
+			{
+				FramePipeline pipeline(depth, [&](unsigned int slot, float deltaTime, float totalTime)
+				{
+					if (snapshots[slot] != nextDrawn || (unsigned int)totalTime != nextDrawn)
+						inOrder = false;
+					nextDrawn++;
+					Spin(workload.DrawMs[snapshots[slot] % 2] / 1000.0);
+				});
+
+				for (unsigned int f = 0; f < frames; f++)
+				{
+					unsigned int slot = pipeline.BeginFrame();
+					Spin(workload.UpdateMs / 1000.0);
+					snapshots[slot] = f;
+					pipeline.SubmitFrame(0.0f, (float)f);
+				}
+				pipeline.Drain();
+				stats = pipeline.GetStats();
+			}
+
+			double framesPerSecond = stats.Frames / stats.Seconds;
+			if (depth == 1)
+				baseline = framesPerSecond;
+
+			printf("  %-22s %6u %10.1f %9.2fx %12.3f %12.3f %10.3f %6s\n",
+				workload.Name, depth, framesPerSecond, framesPerSecond / baseline,
+				stats.LatencySeconds * 1000.0 / stats.Frames, stats.MaxLatencySeconds * 1000.0,
+				stats.UpdateWaitSeconds * 1000.0 / stats.Frames,
+				inOrder && nextDrawn == frames ? "yes" : "NO");
+		}
+	}
+}
+
+// Roughly iterations * a few ns of arithmetic the compiler can't skip
+static float BusyWork(unsigned int iterations)
+{
+	float x = 1.0f;
+	for (unsigned int k = 0; k < iterations; k++)
+		x = sqrtf(x + (float)k);
+	return x;
+}
+
+void Benchmarks::JobSystemScaling()
+{
+	const unsigned int transformCount = 200000;
+	const unsigned int entityCount = 100000;
+	const unsigned int cullCount = 200000;
+	const unsigned int unevenCount = 4096;
+	const unsigned int chains = 64;
+	const unsigned int stages = 16;
+	const unsigned int jobsPerStage = 4;
+	const int frames = 10;
+
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	// The same scene for every thread count
+	TransformSystem transforms;
+	transforms.Reserve(transformCount);
+	for (unsigned int i = 0; i < transformCount; i++)
+	{
+		unsigned int id = transforms.Add();
+		transforms.SetTranslation(id, (float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+	}
+
+	Mesh mesh;
+	EntityRegistry entities;
+	entities.Reserve(entityCount);
+	std::vector<EntityHandle> handles(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		handles[i] = entities.Create(&mesh, 0);
+		entities.SetTranslation(handles[i], (float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+	}
+
+	// FrustumCulling()'s scatter and camera
+	std::vector<EntityBounds> bounds;
+	ScatterBounds(&bounds, cullCount, 1000.0f, 42);
+	BoundingVolumeHierarchy tree;
+	tree.Build(&bounds[0], cullCount);
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(
+		XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0))));
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(
+		0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f)));
+	FrustumCuller culler;
+	culler.SetPlanes(view, projection);
+
+	std::vector<unsigned int> reference;
+	std::vector<unsigned int> visible;
+	tree.CullFrustum(&culler, &bounds[0], &reference);
+
+	std::vector<float> results(unevenCount);
+	std::vector<JobCounter> stageDone(chains * stages);
+
+	// "uneven, static" is the same loop as "uneven", cut into one
+	// equal slice per thread (one job each), for comparison
+	enum { Transforms, EntityUpdate, Culling, Uneven, UnevenStatic, TaskGraph, WorkloadCount };
+	const char* names[WorkloadCount] = { "transforms", "entity update", "BVH culling", "uneven", "uneven, static", "task graph" };
+
+	printf("Job system scaling (%d frames each, %u hardware threads)\n", frames, maxThreads);
+	printf("  %-16s %8s %10s %9s %11s %10s %10s %6s\n", "workload", "threads", "ms/frame", "speedup", "efficiency", "steals", "splits", "same");
+	for (int w = 0; w < WorkloadCount; w++)
+	{
+		double baseline = 0.0;
+		for (size_t t = 0; t < threadCounts.size(); t++)
+		{
+			unsigned int threads = threadCounts[t];
+			JobSystem jobs(threads - 1);
+			bool same = true;
+
+			// Only the work itself is timed, not setting it up
+			double time = 0.0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				double start = 0.0;
+				switch (w)
+				{
+				case Transforms:
+					for (unsigned int i = 0; i < transformCount; i++)
+						transforms.SetRotation(i, frame * 0.1f, i * 0.001f, 0.2f);
+					start = Now();
+					same &= transforms.UpdateWorldMatrices(0, &jobs) == transformCount;
+					break;
+
+				case EntityUpdate:
+					for (unsigned int i = 0; i < entityCount; i++)
+						entities.SetRotation(handles[i], frame * 0.1f, i * 0.001f, 0.2f);
+					start = Now();
+					entities.Update(&jobs);
+					break;
+
+				case Culling:
+					visible.clear();
+					start = Now();
+					tree.CullFrustum(&culler, &bounds[0], &visible, &jobs);
+					same &= visible == reference;
+					break;
+
+				case Uneven:
+					start = Now();
+					jobs.ParallelFor(0, unevenCount, [&results](unsigned int begin, unsigned int end)
+					{
+						for (unsigned int i = begin; i < end; i++)
+							results[i] = BusyWork(i / 4);
+					});
+					break;
+
+				case UnevenStatic:
+				{
+					JobCounter slices;
+					start = Now();
+					for (unsigned int slice = 0; slice < threads; slice++)
+					{
+						unsigned int begin = unevenCount * slice / threads;
+						unsigned int end = unevenCount * (slice + 1) / threads;
+						jobs.Run([&results, begin, end]()
+						{
+							for (unsigned int i = begin; i < end; i++)
+								results[i] = BusyWork(i / 4);
+						}, &slices);
+					}
+					jobs.Wait(&slices);
+					break;
+				}
+
+				case TaskGraph:
+					// Chains of stages, each stage a few jobs that start
+					// once the stage before it is done
+					start = Now();
+					for (unsigned int c = 0; c < chains; c++)
+					{
+						for (unsigned int s = 0; s < stages; s++)
+						{
+							JobCounter* done = &stageDone[c * stages + s];
+							for (unsigned int j = 0; j < jobsPerStage; j++)
+							{
+								JobSystem::JobFunction work = [&results, c, j]() { results[(c * jobsPerStage + j) % unevenCount] = BusyWork(200); };
+								if (s == 0)
+									jobs.Run(work, done);
+								else
+									jobs.RunAfter(done - 1, work, done);
+							}
+						}
+					}
+					for (unsigned int c = 0; c < chains; c++)
+						jobs.Wait(&stageDone[c * stages + stages - 1]);
+					break;
+				}
+				time += Now() - start;
+			}
+			benchmarkSink += (unsigned int)results[unevenCount / 2];
+
+			if (threads == 1)
+				baseline = time;
+
+			JobSystemStats stats = jobs.GetStats();
+			printf("  %-16s %8u %10.3f %8.2fx %10.0f%% %10llu %10llu %6s\n",
+				names[w], threads, time * 1000.0 / frames, baseline / time, baseline / time / threads * 100.0,
+				stats.Steals, stats.Splits, same ? "yes" : "NO");
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// --------------------------------------------------------
+// CPU-side benchmarks for the engine's hot paths
+//
+// Build with RUN_BENCHMARKS defined to run these from
+// Game::Init; results are printed to the console window.
+// None of these need a GPU.
+// --------------------------------------------------------
+class Benchmarks
+{
+
+public:
+	static void RunAll();
+
+	// OBJ loading: old getline/sscanf_s loop vs. ObjParser, whole and split into chunks,
+	// checked against each other on the models plus a generated multi-MB file
+	static void ObjParsing();
+
+	// Vertex counts before/after welding shared corners
+	static void VertexWelding();
+
+	// Simulated post-transform cache efficiency before/after MeshOptimizer
+	static void VertexCacheOptimization();
+
+	// Cold (full OBJ import) vs. warm (mapped binary mesh) load times
+	static void MeshStartup();
+
+	// Serial imports vs. the same imports spread over a JobSystem,
+	// then the whole AsyncMeshLoader against a NullRenderDevice
+	static void AsyncLoading();
+
+	// Vertex buffer sizes and round-trip error for PackedVertex
+	static void PackedVertices();
+
+	// World matrix rebuilds per second: one at a time vs. TransformSystem's SIMD pass
+	static void TransformUpdate();
+
+	// Walking every entity: individually allocated objects vs. EntityRegistry arrays
+	static void EntityIteration();
+
+	// TransformHierarchy update cost for deep/wide trees with 1% vs. 100% of nodes moving
+	static void HierarchyUpdate();
+
+	// Entities tested and culled per ms: FrustumCuller's SSE test vs. one plane at a time
+	static void FrustumCulling();
+
+	// BoundingVolumeHierarchy build time, and refit time/quality as entities drift apart
+	static void BvhBuildAndRefit();
+
+	// Frustum and ray queries: BoundingVolumeHierarchy vs. testing every entity
+	static void BvhQueries();
+
+	// RenderQueue's radix sort vs. std::sort, and state changes before/after sorting
+	static void RenderQueueSorting();
+
+	// Not a timing: checks a NullRenderDevice's log for exactly the calls a StateCache should let through
+	static void StateCacheFiltering();
+
+	// Shader variable sets per second: by name string vs. hashed name vs. handle
+	static void ShaderVariableSets();
+
+	// Per-vertex transform cost: combining world/view/projection per vertex vs. once per object
+	static void VertexTransformCost();
+
+	// Per-object constant setup at 10k objects: shader buffer upload per draw vs. one ring buffer write
+	static void ObjectConstantSetup();
+
+	// SoftwareRasterizer triangles/s and pixels/s for the game's models, one thread vs. a JobSystem
+	static void SoftwareRasterization();
+
+	// InstancedRenderer::Draw() record and replay times with 1 to N recording threads, against a NullRenderDevice
+	static void CommandRecording();
+
+	// FramePipeline frames/s and update-to-drawn latency at depths 1 to 4, for balanced and uneven synthetic frames
+	static void FramePipelining();
+
+	// JobSystem speedup and efficiency at 1 to N threads: transforms, entity update, BVH culling, uneven loops, task graphs
+	static void JobSystemScaling();
+};
@@ -0,0 +1,508 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Nodes with this many items or fewer aren't split
+static const unsigned int maxLeafItems = 4;
+
+// Split candidates per node when building
+static const int binCount = 16;
+
+// Subtrees with fewer items than this aren't culled as a job
+// of their own
+static const unsigned int minItemsPerCullJob = 256;
+
+// Keeps a flat or point-sized box from dividing by zero
+static const float minArea = 1e-6f;
+
+static float SurfaceArea(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	float x = boxMax.x - boxMin.x;
+	float y = boxMax.y - boxMin.y;
+	float z = boxMax.z - boxMin.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+static void GrowBox(XMFLOAT3* boxMin, XMFLOAT3* boxMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+{
+	boxMin->x = std::min(boxMin->x, otherMin.x);
+	boxMin->y = std::min(boxMin->y, otherMin.y);
+	boxMin->z = std::min(boxMin->z, otherMin.z);
+	boxMax->x = std::max(boxMax->x, otherMax.x);
+	boxMax->y = std::max(boxMax->y, otherMax.y);
+	boxMax->z = std::max(boxMax->z, otherMax.z);
+}
+
+static void ItemBox(const EntityBounds& b, XMFLOAT3* boxMin, XMFLOAT3* boxMax)
+{
+	*boxMin = XMFLOAT3(b.Center.x - b.Extents.x, b.Center.y - b.Extents.y, b.Center.z - b.Extents.z);
+	*boxMax = XMFLOAT3(b.Center.x + b.Extents.x, b.Center.y + b.Extents.y, b.Center.z + b.Extents.z);
+}
+
+static int BinOf(const EntityBounds& b, int axis, float axisMin, float binScale)
+{
+	return std::min((int)(((&b.Center.x)[axis] - axisMin) * binScale), binCount - 1);
+}
+
+static const XMFLOAT3 emptyMin(FLT_MAX, FLT_MAX, FLT_MAX);
+static const XMFLOAT3 emptyMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+	rebuildThreshold = 1.5f;
+	rebuiltCount = 0;
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::Build(const EntityBounds* bounds, unsigned int count)
+{
+	nodes.clear();
+	freeNodes.clear();
+	items.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		items[i] = i;
+
+	if (count == 0)
+		return;
+
+	unsigned int root = AllocateNode();
+	nodes[root].First = 0;
+	nodes[root].Count = count;
+	BuildNode(root, bounds);
+}
+
+void BoundingVolumeHierarchy::Refit(const EntityBounds* bounds)
+{
+	rebuiltCount = 0;
+	if (!items.empty())
+		RefitNode(0, bounds);
+}
+
+void BoundingVolumeHierarchy::Update(const EntityBounds* bounds, unsigned int count)
+{
+	if (count != items.size())
+		Build(bounds, count);
+	else
+		Refit(bounds);
+}
+
+// --------------------------------------------------------
+// Walks down the tree, skipping subtrees that are outside and
+// taking subtrees that are inside whole.  Only items in leaves
+// that straddle a plane get their own test.
+//
+// With a JobSystem, the top few levels are walked here (in the
+// same order as below) down to a few subtrees per thread, and
+// each subtree is culled as its own job into its own list.
+// Joining the lists in order gives exactly the serial result.
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::CullFrustum(FrustumCuller* culler, const EntityBounds* bounds, std::vector<unsigned int>* visible, JobSystem* jobs)
+{
+	if (items.empty())
+		return;
+
+	if (!jobs || jobs->GetThreadCount() == 1 || items.size() < minItemsPerCullJob * 2)
+	{
+		CullSubtree(0, culler, bounds, visible, &traversalStack);
+		return;
+	}
+
+	// Split until there are about this many subtrees
+	unsigned int splitDepth = 0;
+	while ((1u << splitDepth) < jobs->GetThreadCount() * 4)
+		splitDepth++;
+
+	cullRoots.clear();
+	traversalStack.clear();
+	traversalStack.push_back(0);
+	cullDepths.clear();
+	cullDepths.push_back(0);
+	while (!traversalStack.empty())
+	{
+		unsigned int index = traversalStack.back();
+		unsigned int depth = cullDepths.back();
+		traversalStack.pop_back();
+		cullDepths.pop_back();
+
+		// Small or deep enough: a subtree of its own
+		const BvhNode& node = nodes[index];
+		if (depth == splitDepth || node.Left < 0 || node.Count < minItemsPerCullJob)
+		{
+			cullRoots.push_back(index);
+			continue;
+		}
+
+		FrustumTest test = culler->ClassifyBox(node.Min, node.Max);
+		if (test == FrustumOutside)
+			continue;
+
+		if (test == FrustumInside)
+		{
+			// Nothing left to test; the job just copies the run
+			cullRoots.push_back(index);
+		}
+		else
+		{
+			traversalStack.push_back(node.Left);
+			traversalStack.push_back(node.Right);
+			cullDepths.push_back(depth + 1);
+			cullDepths.push_back(depth + 1);
+		}
+	}
+
+	// Each job keeps its own list and stack, reused between frames
+	if (cullVisible.size() < cullRoots.size())
+	{
+		cullVisible.resize(cullRoots.size());
+		cullStacks.resize(cullRoots.size());
+	}
+
+	jobs->ParallelFor(0, (unsigned int)cullRoots.size(), [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			cullVisible[i].clear();
+			CullSubtree(cullRoots[i], culler, bounds, &cullVisible[i], &cullStacks[i]);
+		}
+	});
+
+	for (size_t i = 0; i < cullRoots.size(); i++)
+		visible->insert(visible->end(), cullVisible[i].begin(), cullVisible[i].end());
+}
+
+void BoundingVolumeHierarchy::CullSubtree(unsigned int root, FrustumCuller* culler, const EntityBounds* bounds,
+	std::vector<unsigned int>* visible, std::vector<unsigned int>* traversal)
+{
+	std::vector<unsigned int>& stack = *traversal;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const BvhNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		FrustumTest test = culler->ClassifyBox(node.Min, node.Max);
+		if (test == FrustumOutside)
+			continue;
+
+		if (test == FrustumInside)
+		{
+			visible->insert(visible->end(), items.begin() + node.First, items.begin() + node.First + node.Count);
+		}
+		else if (node.Left < 0)
+		{
+			for (unsigned int i = node.First; i < node.First + node.Count; i++)
+			{
+				unsigned char isVisible;
+				culler->Cull(&bounds[items[i]], 1, &isVisible);
+				if (isVisible)
+					visible->push_back(items[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(node.Left);
+			stack.push_back(node.Right);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Slab test: the distances at which the ray enters and leaves
+// the box along each axis.  Returns false on a miss or if the
+// box starts beyond maxDistance.
+// --------------------------------------------------------
+static bool RayHitsBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection,
+	const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float maxDistance, float* entry)
+{
+	float x0 = (boxMin.x - origin.x) * inverseDirection.x;
+	float x1 = (boxMax.x - origin.x) * inverseDirection.x;
+	float y0 = (boxMin.y - origin.y) * inverseDirection.y;
+	float y1 = (boxMax.y - origin.y) * inverseDirection.y;
+	float z0 = (boxMin.z - origin.z) * inverseDirection.z;
+	float z1 = (boxMax.z - origin.z) * inverseDirection.z;
+
+	float nearest = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+	float farthest = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), maxDistance));
+	*entry = nearest;
+	return nearest <= farthest;
+}
+
+// --------------------------------------------------------
+// Nearest hit first: the closer child is visited first, and
+// anything that starts beyond the best hit so far is skipped
+// --------------------------------------------------------
+int BoundingVolumeHierarchy::RayCast(const XMFLOAT3& origin, const XMFLOAT3& direction, const EntityBounds* bounds, float* hitDistance)
+{
+	if (items.empty())
+		return -1;
+
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float best = FLT_MAX;
+	int hit = -1;
+
+	float entry;
+	if (!RayHitsBox(origin, inverseDirection, nodes[0].Min, nodes[0].Max, best, &entry))
+		return -1;
+
+	std::vector<unsigned int>& stack = traversalStack;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.Left < 0)
+		{
+			for (unsigned int i = node.First; i < node.First + node.Count; i++)
+			{
+				XMFLOAT3 boxMin, boxMax;
+				ItemBox(bounds[items[i]], &boxMin, &boxMax);
+				if (RayHitsBox(origin, inverseDirection, boxMin, boxMax, best, &entry) && entry < best)
+				{
+					best = entry;
+					hit = (int)items[i];
+				}
+			}
+			continue;
+		}
+
+		float leftEntry, rightEntry;
+		bool left = RayHitsBox(origin, inverseDirection, nodes[node.Left].Min, nodes[node.Left].Max, best, &leftEntry);
+		bool right = RayHitsBox(origin, inverseDirection, nodes[node.Right].Min, nodes[node.Right].Max, best, &rightEntry);
+
+		// Pushed last is popped first
+		if (left && right)
+		{
+			bool leftFirst = leftEntry <= rightEntry;
+			stack.push_back(leftFirst ? node.Right : node.Left);
+			stack.push_back(leftFirst ? node.Left : node.Right);
+		}
+		else if (left)
+		{
+			stack.push_back(node.Left);
+		}
+		else if (right)
+		{
+			stack.push_back(node.Right);
+		}
+	}
+
+	if (hit >= 0 && hitDistance)
+		*hitDistance = best;
+	return hit;
+}
+
+float BoundingVolumeHierarchy::GetCost()
+{
+	if (items.empty())
+		return 0.0f;
+	return SubtreeArea(0) / std::max(SurfaceArea(nodes[0].Min, nodes[0].Max), minArea);
+}
+
+unsigned int BoundingVolumeHierarchy::AllocateNode()
+{
+	unsigned int node;
+	if (freeNodes.empty())
+	{
+		node = (unsigned int)nodes.size();
+		nodes.push_back(BvhNode());
+	}
+	else
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+
+	nodes[node].Left = -1;
+	nodes[node].Right = -1;
+	return node;
+}
+
+void BoundingVolumeHierarchy::FreeChildren(unsigned int node)
+{
+	int left = nodes[node].Left;
+	int right = nodes[node].Right;
+	if (left < 0)
+		return;
+
+	FreeChildren(left);
+	FreeChildren(right);
+	freeNodes.push_back(left);
+	freeNodes.push_back(right);
+	nodes[node].Left = -1;
+	nodes[node].Right = -1;
+}
+
+// --------------------------------------------------------
+// Splits a node's items along the axis where their centers
+// are most spread out.  Centers are dropped into bins, and
+// every boundary between bins is scored by
+//
+//   area(left) * count(left) + area(right) * count(right)
+//
+// Returns the subtree's cost (the sum of its node areas, with
+// leaves weighted by their item count).
+// --------------------------------------------------------
+float BoundingVolumeHierarchy::BuildNode(unsigned int node, const EntityBounds* bounds)
+{
+	unsigned int first = nodes[node].First;
+	unsigned int count = nodes[node].Count;
+
+	XMFLOAT3 nodeMin = emptyMin, nodeMax = emptyMax;
+	XMFLOAT3 centerMin = emptyMin, centerMax = emptyMax;
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		XMFLOAT3 boxMin, boxMax;
+		ItemBox(bounds[items[i]], &boxMin, &boxMax);
+		GrowBox(&nodeMin, &nodeMax, boxMin, boxMax);
+		GrowBox(&centerMin, &centerMax, bounds[items[i]].Center, bounds[items[i]].Center);
+	}
+	nodes[node].Min = nodeMin;
+	nodes[node].Max = nodeMax;
+	float area = SurfaceArea(nodeMin, nodeMax);
+
+	float spread[3] = { centerMax.x - centerMin.x, centerMax.y - centerMin.y, centerMax.z - centerMin.z };
+	int axis = spread[0] > spread[1] ? (spread[0] > spread[2] ? 0 : 2) : (spread[1] > spread[2] ? 1 : 2);
+
+	// Few enough items, or all centered on the same point
+	if (count <= maxLeafItems || spread[axis] <= 0.0f)
+	{
+		nodes[node].BuiltCost = (float)count;
+		return area * count;
+	}
+
+	float axisMin = (&centerMin.x)[axis];
+	float binScale = binCount / spread[axis];
+
+	XMFLOAT3 binMin[binCount], binMax[binCount];
+	unsigned int binItems[binCount] = {};
+	for (int b = 0; b < binCount; b++)
+	{
+		binMin[b] = emptyMin;
+		binMax[b] = emptyMax;
+	}
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		int b = BinOf(bounds[items[i]], axis, axisMin, binScale);
+		XMFLOAT3 boxMin, boxMax;
+		ItemBox(bounds[items[i]], &boxMin, &boxMax);
+		GrowBox(&binMin[b], &binMax[b], boxMin, boxMax);
+		binItems[b]++;
+	}
+
+	// Sweep from the right to get every right-hand side's cost,
+	// then from the left to score each split
+	float rightCost[binCount];
+	XMFLOAT3 sideMin = emptyMin, sideMax = emptyMax;
+	unsigned int sideItems = 0;
+	for (int b = binCount - 1; b > 0; b--)
+	{
+		GrowBox(&sideMin, &sideMax, binMin[b], binMax[b]);
+		sideItems += binItems[b];
+		rightCost[b] = sideItems ? SurfaceArea(sideMin, sideMax) * sideItems : FLT_MAX;
+	}
+
+	int bestSplit = -1;
+	float bestCost = FLT_MAX;
+	sideMin = emptyMin;
+	sideMax = emptyMax;
+	sideItems = 0;
+	for (int b = 0; b < binCount - 1; b++)
+	{
+		GrowBox(&sideMin, &sideMax, binMin[b], binMax[b]);
+		sideItems += binItems[b];
+		if (sideItems == 0 || sideItems == count)
+			continue;
+
+		float cost = SurfaceArea(sideMin, sideMax) * sideItems + rightCost[b + 1];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestSplit = b;
+		}
+	}
+
+	unsigned int middle = count / 2;
+	if (bestSplit >= 0)
+	{
+		unsigned int* split = std::partition(&items[first], &items[first] + count,
+			[&](unsigned int item) { return BinOf(bounds[item], axis, axisMin, binScale) <= bestSplit; });
+		middle = (unsigned int)(split - &items[first]);
+	}
+
+	// Allocating can move the nodes, so no references across these
+	unsigned int left = AllocateNode();
+	unsigned int right = AllocateNode();
+	nodes[node].Left = left;
+	nodes[node].Right = right;
+	nodes[left].First = first;
+	nodes[left].Count = middle;
+	nodes[right].First = first + middle;
+	nodes[right].Count = count - middle;
+
+	float cost = area + BuildNode(left, bounds) + BuildNode(right, bounds);
+	nodes[node].BuiltCost = cost / std::max(area, minArea);
+	return cost;
+}
+
+// --------------------------------------------------------
+// Children first, so each box is the union of its children's
+// fresh boxes.  A subtree that has degraded too far since it
+// was built is rebuilt from its own items; the rest of the
+// tree doesn't notice, since its item range stays the same.
+// --------------------------------------------------------
+float BoundingVolumeHierarchy::RefitNode(unsigned int node, const EntityBounds* bounds)
+{
+	XMFLOAT3 nodeMin = emptyMin, nodeMax = emptyMax;
+	if (nodes[node].Left < 0)
+	{
+		unsigned int first = nodes[node].First;
+		unsigned int count = nodes[node].Count;
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			XMFLOAT3 boxMin, boxMax;
+			ItemBox(bounds[items[i]], &boxMin, &boxMax);
+			GrowBox(&nodeMin, &nodeMax, boxMin, boxMax);
+		}
+		nodes[node].Min = nodeMin;
+		nodes[node].Max = nodeMax;
+		return SurfaceArea(nodeMin, nodeMax) * count;
+	}
+
+	int left = nodes[node].Left;
+	int right = nodes[node].Right;
+	float childCost = RefitNode(left, bounds) + RefitNode(right, bounds);
+
+	GrowBox(&nodeMin, &nodeMax, nodes[left].Min, nodes[left].Max);
+	GrowBox(&nodeMin, &nodeMax, nodes[right].Min, nodes[right].Max);
+	nodes[node].Min = nodeMin;
+	nodes[node].Max = nodeMax;
+
+	float area = SurfaceArea(nodeMin, nodeMax);
+	float cost = area + childCost;
+	if (cost > rebuildThreshold * nodes[node].BuiltCost * std::max(area, minArea))
+	{
+		FreeChildren(node);
+		cost = BuildNode(node, bounds);
+		rebuiltCount++;
+	}
+	return cost;
+}
+
+float BoundingVolumeHierarchy::SubtreeArea(unsigned int node)
+{
+	const BvhNode& n = nodes[node];
+	float area = SurfaceArea(n.Min, n.Max);
+	if (n.Left < 0)
+		return area * n.Count;
+	return area + SubtreeArea(n.Left) + SubtreeArea(n.Right);
+}
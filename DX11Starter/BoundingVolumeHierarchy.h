@@ -0,0 +1,104 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "EntityRegistry.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+// A node covers items [First, First + Count) of the item order.
+// Internal nodes have two children; leaves have Left == -1.
+struct BvhNode
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	int Left;
+	int Right;
+	unsigned int First;
+	unsigned int Count;
+
+	// Surface area heuristic cost of the subtree, relative to
+	// this node's own area, as of when it was last built
+	float BuiltCost;
+};
+
+// --------------------------------------------------------
+// A tree of axis-aligned boxes over an array of EntityBounds
+// (normally EntityRegistry::GetBounds()), for culling and
+// picking without visiting every entity
+//
+// Build() splits top-down using a binned surface area
+// heuristic.  Items are reordered in place as they're split,
+// so every subtree covers one contiguous run of them: a node
+// that is entirely inside the frustum hands back its whole
+// run without testing anything below it.
+//
+// Update() is meant to be called every frame.  The tree shape
+// is kept and only the boxes are refit bottom-up; any subtree
+// whose cost has grown past the rebuild threshold since it was
+// built (things moved apart, so its boxes overlap more) is
+// rebuilt on the spot.  Changing the item count rebuilds it all.
+// --------------------------------------------------------
+class BoundingVolumeHierarchy
+{
+
+public:
+	BoundingVolumeHierarchy();
+	~BoundingVolumeHierarchy();
+
+	void Build(const EntityBounds* bounds, unsigned int count);
+	void Refit(const EntityBounds* bounds);
+
+	// Refit, or Build if the number of items changed
+	void Update(const EntityBounds* bounds, unsigned int count);
+
+	// Appends the index of every item that passes the culler.
+	// jobs - culls subtrees on its threads; the result is the same
+	void CullFrustum(FrustumCuller* culler, const EntityBounds* bounds, std::vector<unsigned int>* visible, JobSystem* jobs = 0);
+
+	// Returns the index of the nearest item whose box the ray
+	// hits, or -1.  direction doesn't need to be normalized;
+	// hitDistance is in multiples of it.
+	int RayCast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, const EntityBounds* bounds, float* hitDistance);
+
+	// A subtree is rebuilt once its cost reaches this many times
+	// its cost when built (default 1.5)
+	void SetRebuildThreshold(float threshold) { rebuildThreshold = threshold; }
+
+	unsigned int GetNodeCount() { return (unsigned int)(nodes.size() - freeNodes.size()); }
+	unsigned int GetItemCount() { return (unsigned int)items.size(); }
+
+	// Subtrees rebuilt by the last Refit()
+	unsigned int GetRebuiltCount() { return rebuiltCount; }
+
+	// Current cost of the whole tree relative to the root's area
+	float GetCost();
+
+private:
+	std::vector<BvhNode> nodes;
+	std::vector<unsigned int> freeNodes;
+	std::vector<unsigned int> items;
+	std::vector<unsigned int> traversalStack;
+
+	// Parallel culling: the subtrees handed out, and each one's
+	// results and stack
+	std::vector<unsigned int> cullRoots;
+	std::vector<unsigned int> cullDepths;
+	std::vector<std::vector<unsigned int>> cullVisible;
+	std::vector<std::vector<unsigned int>> cullStacks;
+
+	float rebuildThreshold;
+	unsigned int rebuiltCount;
+
+	unsigned int AllocateNode();
+	void FreeChildren(unsigned int node);
+
+	float BuildNode(unsigned int node, const EntityBounds* bounds);
+	float RefitNode(unsigned int node, const EntityBounds* bounds);
+	float SubtreeArea(unsigned int node);
+
+	void CullSubtree(unsigned int root, FrustumCuller* culler, const EntityBounds* bounds,
+		std::vector<unsigned int>* visible, std::vector<unsigned int>* traversal);
+};
@@ -0,0 +1,250 @@
+#include "CommandBuffer.h"
+
+#include <cstring>
+
+// Each command's arguments, as stored after its header
+struct SetShaderArgs
+{
+	ISimpleShader* Shader;
+};
+
+struct SetShaderDataArgs
+{
+	ISimpleShader* Shader;
+	SimpleShaderHandle Handle;
+	unsigned int Size;	// Bytes of data following these
+};
+
+struct IASetVertexBuffersArgs
+{
+	UINT StartSlot;
+	UINT Count;
+	ID3D11Buffer* Buffers[CommandBuffer::MaxVertexBuffers];
+	UINT Strides[CommandBuffer::MaxVertexBuffers];
+	UINT Offsets[CommandBuffer::MaxVertexBuffers];
+};
+
+struct IASetIndexBufferArgs
+{
+	ID3D11Buffer* Buffer;
+	DXGI_FORMAT Format;
+	UINT Offset;
+};
+
+struct BindConstantsArgs
+{
+	ConstantRingBuffer* Ring;
+	unsigned int Slot;
+	ConstantAllocation Allocation;
+};
+
+struct DrawIndexedArgs
+{
+	UINT IndexCount;
+	UINT StartIndex;
+	INT BaseVertex;
+};
+
+struct DrawIndexedInstancedArgs
+{
+	UINT IndexCount;
+	UINT InstanceCount;
+	UINT StartIndex;
+	INT BaseVertex;
+	UINT StartInstance;
+};
+
+// Commands (and so their arguments) start on this boundary
+static const unsigned int CommandAlignment = sizeof(void*);
+
+// The header is padded out to the alignment, so arguments
+// start right after it
+static const unsigned int HeaderSize = CommandAlignment > 4 ? CommandAlignment : 4;
+
+CommandBuffer::CommandBuffer(unsigned int capacity)
+{
+	data.resize(capacity);
+	size = 0;
+	commandCount = 0;
+	growCount = 0;
+}
+
+CommandBuffer::~CommandBuffer()
+{
+}
+
+void CommandBuffer::Reset()
+{
+	size = 0;
+	commandCount = 0;
+}
+
+// --------------------------------------------------------
+// Reserves a command, growing the buffer (doubling) only if
+// it's full.  Nothing is written but the header.
+// --------------------------------------------------------
+template <typename A>
+A* CommandBuffer::Append(CommandType type, unsigned int extra)
+{
+	unsigned int commandSize = (HeaderSize + sizeof(A) + extra + CommandAlignment - 1) & ~(CommandAlignment - 1);
+	if (size + commandSize > data.size())
+	{
+		size_t capacity = data.size() < 1024 ? 1024 : data.size();
+		while (capacity < size + commandSize)
+			capacity *= 2;
+		data.resize(capacity);
+		growCount++;
+	}
+
+	CommandHeader* header = reinterpret_cast<CommandHeader*>(&data[size]);
+	header->Type = (unsigned short)type;
+	header->Size = (unsigned short)commandSize;
+
+	A* args = reinterpret_cast<A*>(&data[size + HeaderSize]);
+	size += commandSize;
+	commandCount++;
+	return args;
+}
+
+void CommandBuffer::SetShader(ISimpleShader* shader)
+{
+	Append<SetShaderArgs>(CommandSetShader)->Shader = shader;
+}
+
+void CommandBuffer::SetShaderData(ISimpleShader* shader, SimpleShaderHandle handle, const void* values, unsigned int valueSize)
+{
+	// Command sizes are stored in 16 bits
+	if (handle == SimpleShaderInvalidHandle || valueSize > 0xF000)
+		return;
+
+	SetShaderDataArgs* args = Append<SetShaderDataArgs>(CommandSetShaderData, valueSize);
+	args->Shader = shader;
+	args->Handle = handle;
+	args->Size = valueSize;
+	memcpy(args + 1, values, valueSize);
+}
+
+void CommandBuffer::CopyAllBufferData(ISimpleShader* shader)
+{
+	Append<SetShaderArgs>(CommandCopyAllBufferData)->Shader = shader;
+}
+
+void CommandBuffer::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	if (count > MaxVertexBuffers)
+		count = MaxVertexBuffers;
+
+	IASetVertexBuffersArgs* args = Append<IASetVertexBuffersArgs>(CommandIASetVertexBuffers);
+	args->StartSlot = startSlot;
+	args->Count = count;
+	for (UINT i = 0; i < count; i++)
+	{
+		args->Buffers[i] = buffers[i];
+		args->Strides[i] = strides[i];
+		args->Offsets[i] = offsets[i];
+	}
+}
+
+void CommandBuffer::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	IASetIndexBufferArgs* args = Append<IASetIndexBufferArgs>(CommandIASetIndexBuffer);
+	args->Buffer = buffer;
+	args->Format = format;
+	args->Offset = offset;
+}
+
+void CommandBuffer::BindConstants(ConstantRingBuffer* ring, unsigned int slot, const ConstantAllocation& allocation)
+{
+	BindConstantsArgs* args = Append<BindConstantsArgs>(CommandBindConstants);
+	args->Ring = ring;
+	args->Slot = slot;
+	args->Allocation = allocation;
+}
+
+void CommandBuffer::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	DrawIndexedArgs* args = Append<DrawIndexedArgs>(CommandDrawIndexed);
+	args->IndexCount = indexCount;
+	args->StartIndex = startIndex;
+	args->BaseVertex = baseVertex;
+}
+
+void CommandBuffer::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	DrawIndexedInstancedArgs* args = Append<DrawIndexedInstancedArgs>(CommandDrawIndexedInstanced);
+	args->IndexCount = indexCount;
+	args->InstanceCount = instanceCount;
+	args->StartIndex = startIndex;
+	args->BaseVertex = baseVertex;
+	args->StartInstance = startInstance;
+}
+
+// --------------------------------------------------------
+// Walks the commands from the start, handing each to what
+// it was recorded for
+// --------------------------------------------------------
+void CommandBuffer::Execute(StateCache* stateCache)
+{
+	RenderDevice* device = stateCache->GetDevice();
+
+	unsigned int offset = 0;
+	while (offset < size)
+	{
+		const CommandHeader* header = reinterpret_cast<const CommandHeader*>(&data[offset]);
+		const void* args = &data[offset + HeaderSize];
+		offset += header->Size;
+
+		switch (header->Type)
+		{
+		case CommandSetShader:
+			static_cast<const SetShaderArgs*>(args)->Shader->SetShader();
+			break;
+
+		case CommandSetShaderData:
+		{
+			const SetShaderDataArgs* a = static_cast<const SetShaderDataArgs*>(args);
+			a->Shader->SetData(a->Handle, a + 1, a->Size);
+			break;
+		}
+
+		case CommandCopyAllBufferData:
+			static_cast<const SetShaderArgs*>(args)->Shader->CopyAllBufferData();
+			break;
+
+		case CommandIASetVertexBuffers:
+		{
+			const IASetVertexBuffersArgs* a = static_cast<const IASetVertexBuffersArgs*>(args);
+			stateCache->IASetVertexBuffers(a->StartSlot, a->Count, a->Buffers, a->Strides, a->Offsets);
+			break;
+		}
+
+		case CommandIASetIndexBuffer:
+		{
+			const IASetIndexBufferArgs* a = static_cast<const IASetIndexBufferArgs*>(args);
+			stateCache->IASetIndexBuffer(a->Buffer, a->Format, a->Offset);
+			break;
+		}
+
+		case CommandBindConstants:
+		{
+			const BindConstantsArgs* a = static_cast<const BindConstantsArgs*>(args);
+			a->Ring->Bind(a->Slot, a->Allocation);
+			break;
+		}
+
+		case CommandDrawIndexed:
+		{
+			const DrawIndexedArgs* a = static_cast<const DrawIndexedArgs*>(args);
+			device->DrawIndexed(a->IndexCount, a->StartIndex, a->BaseVertex);
+			break;
+		}
+
+		case CommandDrawIndexedInstanced:
+		{
+			const DrawIndexedInstancedArgs* a = static_cast<const DrawIndexedInstancedArgs*>(args);
+			device->DrawIndexedInstanced(a->IndexCount, a->InstanceCount, a->StartIndex, a->BaseVertex, a->StartInstance);
+			break;
+		}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <vector>
+
+#include "SimpleShader.h"
+#include "StateCache.h"
+#include "ConstantRingBuffer.h"
+
+// The calls a CommandBuffer can hold
+enum CommandType
+{
+	CommandSetShader,
+	CommandSetShaderData,
+	CommandCopyAllBufferData,
+	CommandIASetVertexBuffers,
+	CommandIASetIndexBuffer,
+	CommandBindConstants,
+	CommandDrawIndexed,
+	CommandDrawIndexedInstanced,
+	CommandTypeCount,
+};
+
+// --------------------------------------------------------
+// A list of draw calls, written now and issued later
+//
+// Recording only appends to this buffer's own memory - nothing
+// touches a shader, the StateCache or the device - so several
+// threads can each record into their own CommandBuffer at
+// once.  Execute() then issues the calls, in order, on the
+// thread that owns the device.
+//
+// Commands are packed back to back: a small header, then the
+// arguments, with shader data copied in after them.  Shader
+// calls are replayed through the shader itself (which uploads
+// only what changed and binds through its StateCache), and
+// binds go through the StateCache, so a replay costs what the
+// same calls made directly would have.
+//
+// Reset() keeps the memory, so once a buffer has grown to a
+// frame's worth of commands, recording stops allocating.
+// --------------------------------------------------------
+class CommandBuffer
+{
+
+public:
+	// capacity - starting size in bytes; grows (and counts it) if a frame needs more
+	CommandBuffer(unsigned int capacity = 64 * 1024);
+	~CommandBuffer();
+
+	// Empties the buffer, keeping its memory
+	void Reset();
+
+	// ISimpleShader::SetShader()
+	void SetShader(ISimpleShader* shader);
+
+	// ISimpleShader::SetData() by handle; the values are copied.
+	// Invalid handles are dropped here rather than replayed.
+	void SetShaderData(ISimpleShader* shader, SimpleShaderHandle handle, const void* values, unsigned int valueSize);
+
+	// ISimpleShader::CopyAllBufferData()
+	void CopyAllBufferData(ISimpleShader* shader);
+
+	// Through the StateCache
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+	// ConstantRingBuffer::Bind()
+	void BindConstants(ConstantRingBuffer* ring, unsigned int slot, const ConstantAllocation& allocation);
+
+	// Straight to the device
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	// Issues everything recorded, oldest first.  Draws go to
+	// the StateCache's device.
+	void Execute(StateCache* stateCache);
+
+	unsigned int GetCommandCount() { return commandCount; }
+	unsigned int GetSize() { return size; }
+	unsigned int GetCapacity() { return (unsigned int)data.size(); }
+
+	// Times recording ran out of room since this buffer was made
+	unsigned int GetGrowCount() { return growCount; }
+
+	static const unsigned int MaxVertexBuffers = 2;
+
+private:
+	// In front of every command.  Size covers the header,
+	// arguments and any data, rounded up so the next command
+	// stays pointer aligned.
+	struct CommandHeader
+	{
+		unsigned short Type;
+		unsigned short Size;
+	};
+
+	std::vector<unsigned char> data;
+	unsigned int size;
+	unsigned int commandCount;
+	unsigned int growCount;
+
+	// Room for a command of the given type with argument struct
+	// A and extra bytes after it; returns where A goes
+	template <typename A>
+	A* Append(CommandType type, unsigned int extra = 0);
+};
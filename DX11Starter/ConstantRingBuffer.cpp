@@ -0,0 +1,110 @@
+#include "ConstantRingBuffer.h"
+
+ConstantRingBuffer::ConstantRingBuffer(RenderDevice* device, StateCache* stateCache, unsigned int capacity)
+{
+	this->device = device;
+	this->stateCache = stateCache;
+
+	buffer = 0;
+	this->capacity = 0;
+	mapped = 0;
+	frameStart = 0;
+	frameEnd = 0;
+	frameLimit = 0;
+
+	supported = device->CanOffsetConstantBuffers();
+	noOverwrite = device->CanMapNoOverwriteConstantBuffers();
+	if (supported)
+		supported = CreateBuffer(AlignedSize(capacity));
+}
+
+ConstantRingBuffer::~ConstantRingBuffer()
+{
+	device->Release(buffer);
+}
+
+bool ConstantRingBuffer::Begin(unsigned int bytes)
+{
+	if (!supported)
+		return false;
+
+	bytes = AlignedSize(bytes);
+	if (bytes > capacity)
+	{
+		unsigned int newCapacity = capacity;
+		while (newCapacity < bytes)
+			newCapacity *= 2;
+		if (!CreateBuffer(newCapacity))
+			return false;
+	}
+
+	// Carry on after last frame if there's room, otherwise
+	// start over with fresh memory
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (!noOverwrite || frameEnd + bytes > capacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		frameEnd = 0;
+	}
+
+	mapped = (unsigned char*)device->Map(buffer, mapType);
+	if (!mapped)
+		return false;
+
+	frameStart = frameEnd;
+	frameLimit = frameEnd + bytes;
+	return true;
+}
+
+void* ConstantRingBuffer::Allocate(unsigned int size, ConstantAllocation* allocation)
+{
+	unsigned int alignedSize = AlignedSize(size);
+	if (!mapped || frameEnd + alignedSize > frameLimit)
+		return 0;
+
+	allocation->FirstConstant = frameEnd / 16;
+	allocation->ConstantCount = alignedSize / 16;
+
+	void* data = mapped + frameEnd;
+	frameEnd += alignedSize;
+	return data;
+}
+
+void ConstantRingBuffer::End()
+{
+	if (!mapped)
+		return;
+
+	device->Unmap(buffer);
+	mapped = 0;
+}
+
+void ConstantRingBuffer::Bind(unsigned int slot, const ConstantAllocation& allocation)
+{
+	stateCache->VSSetConstantBuffers1(slot, 1, &buffer, &allocation.FirstConstant, &allocation.ConstantCount);
+}
+
+// --------------------------------------------------------
+// Replaces the buffer with an empty one of the given size
+// --------------------------------------------------------
+bool ConstantRingBuffer::CreateBuffer(unsigned int size)
+{
+	device->Release(buffer);
+	buffer = 0;
+	capacity = 0;
+	frameEnd = 0;
+
+	D3D11_BUFFER_DESC cbd;
+	cbd.Usage = D3D11_USAGE_DYNAMIC;
+	cbd.ByteWidth = size;
+	cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbd.MiscFlags = 0;
+	cbd.StructureByteStride = 0;
+	buffer = device->CreateBuffer(cbd, 0);
+	if (!buffer)
+		return false;
+
+	capacity = size;
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "RenderDevice.h"
+#include "StateCache.h"
+
+// Where an allocation landed, in 16-byte shader constants -
+// what VSSetConstantBuffers1 wants
+struct ConstantAllocation
+{
+	unsigned int FirstConstant;
+	unsigned int ConstantCount;
+};
+
+// --------------------------------------------------------
+// One big dynamic constant buffer that per-object constants
+// are sub-allocated from, so a frame's worth of objects is
+// written with one Map() and each draw just binds its slice
+// (D3D11.1 constant buffer offsets)
+//
+// Each frame: Begin() with the total size needed, Allocate()
+// and fill each object's constants, End(), then Bind() each
+// allocation before its draw.
+//
+// Frames are written one after another around the buffer
+// with WRITE_NO_OVERWRITE, so the GPU can still be reading
+// earlier frames; when a frame doesn't fit before the end,
+// the buffer is discarded and writing starts over at 0.
+// (Drivers that can't map constant buffers NO_OVERWRITE get
+// a discard every frame.)
+//
+// Without D3D11.1 IsSupported() is false and nothing here
+// works - callers fall back to their own constant buffers.
+// --------------------------------------------------------
+class ConstantRingBuffer
+{
+
+public:
+	// capacity - starting size in bytes; grows if a frame needs more
+	ConstantRingBuffer(RenderDevice* device, StateCache* stateCache, unsigned int capacity);
+	~ConstantRingBuffer();
+
+	bool IsSupported() { return supported; }
+
+	// bytes - the most this frame will allocate (AlignedSize()
+	// of each allocation, added up).  Returns false if the
+	// buffer couldn't be mapped.
+	bool Begin(unsigned int bytes);
+
+	// Returns where to write size bytes, or 0 if this frame's
+	// space has run out
+	void* Allocate(unsigned int size, ConstantAllocation* allocation);
+
+	void End();
+
+	// Binds an allocation to a vertex shader constant buffer slot
+	void Bind(unsigned int slot, const ConstantAllocation& allocation);
+
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetBytesWritten() { return frameEnd - frameStart; }
+
+	// Offsets have to be a multiple of 16 constants, and so do
+	// the sizes that are bound
+	static const unsigned int Alignment = 256;
+	static unsigned int AlignedSize(unsigned int size) { return (size + Alignment - 1) & ~(Alignment - 1); }
+
+private:
+	RenderDevice* device;
+	StateCache* stateCache;
+
+	ID3D11Buffer* buffer;
+	unsigned int capacity;
+	bool supported;
+	bool noOverwrite;
+
+	// This frame's mapped range, and where the next allocation goes
+	unsigned char* mapped;
+	unsigned int frameStart;
+	unsigned int frameEnd;
+	unsigned int frameLimit;
+
+	bool CreateBuffer(unsigned int size);
+};
@@ -0,0 +1,196 @@
+#include "D3D11RenderDevice.h"
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain)
+{
+	this->device = device;
+	this->context = context;
+	this->swapChain = swapChain;
+	backBufferRTV = 0;
+	depthStencilView = 0;
+
+	context1 = 0;
+	if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1)))
+		context1 = 0;
+
+	// Offsets need the D3D11.1 runtime and a driver that supports
+	// them; NO_OVERWRITE maps of constant buffers are optional
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		ZeroMemory(&options, sizeof(options));
+
+	canOffsetConstantBuffers = context1 && options.ConstantBufferOffsetting;
+	canMapNoOverwriteConstantBuffers = options.MapNoOverwriteOnDynamicConstantBuffer != 0;
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	if (context1) { context1->Release(); }
+}
+
+void D3D11RenderDevice::SetRenderTargets(ID3D11RenderTargetView* backBufferRTV, ID3D11DepthStencilView* depthStencilView)
+{
+	this->backBufferRTV = backBufferRTV;
+	this->depthStencilView = depthStencilView;
+}
+
+// --------------------------------------------------------
+// Resources
+// --------------------------------------------------------
+ID3D11Buffer* D3D11RenderDevice::CreateBuffer(const D3D11_BUFFER_DESC& desc, const void* initialData)
+{
+	D3D11_SUBRESOURCE_DATA data;
+	data.pSysMem = initialData;
+	data.SysMemPitch = 0;
+	data.SysMemSlicePitch = 0;
+
+	ID3D11Buffer* buffer = 0;
+	if (FAILED(device->CreateBuffer(&desc, initialData ? &data : 0, &buffer)))
+		return 0;
+	return buffer;
+}
+
+ID3D11VertexShader* D3D11RenderDevice::CreateVertexShader(const void* bytecode, SIZE_T size)
+{
+	ID3D11VertexShader* shader = 0;
+	if (FAILED(device->CreateVertexShader(bytecode, size, 0, &shader)))
+		return 0;
+	return shader;
+}
+
+ID3D11PixelShader* D3D11RenderDevice::CreatePixelShader(const void* bytecode, SIZE_T size)
+{
+	ID3D11PixelShader* shader = 0;
+	if (FAILED(device->CreatePixelShader(bytecode, size, 0, &shader)))
+		return 0;
+	return shader;
+}
+
+ID3D11InputLayout* D3D11RenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T size)
+{
+	ID3D11InputLayout* inputLayout = 0;
+	if (FAILED(device->CreateInputLayout(elements, count, bytecode, size, &inputLayout)))
+		return 0;
+	return inputLayout;
+}
+
+void D3D11RenderDevice::Release(ID3D11DeviceChild* resource)
+{
+	if (resource) { resource->Release(); }
+}
+
+// --------------------------------------------------------
+// Uploads
+// --------------------------------------------------------
+void* D3D11RenderDevice::Map(ID3D11Buffer* buffer, D3D11_MAP mapType)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, mapType, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void D3D11RenderDevice::Unmap(ID3D11Buffer* buffer)
+{
+	context->Unmap(buffer, 0);
+}
+
+void D3D11RenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* data)
+{
+	context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+// --------------------------------------------------------
+// Pipeline state
+// --------------------------------------------------------
+void D3D11RenderDevice::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderDevice::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	context->IASetPrimitiveTopology(topology);
+}
+
+void D3D11RenderDevice::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	context->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void D3D11RenderDevice::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void D3D11RenderDevice::VSSetShader(ID3D11VertexShader* shader)
+{
+	context->VSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderDevice::VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	context->VSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void D3D11RenderDevice::VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	if (context1)
+		context1->VSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+}
+
+void D3D11RenderDevice::VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	context->VSSetShaderResources(startSlot, count, views);
+}
+
+void D3D11RenderDevice::VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	context->VSSetSamplers(startSlot, count, samplers);
+}
+
+void D3D11RenderDevice::PSSetShader(ID3D11PixelShader* shader)
+{
+	context->PSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderDevice::PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	context->PSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void D3D11RenderDevice::PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	context->PSSetShaderResources(startSlot, count, views);
+}
+
+void D3D11RenderDevice::PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	context->PSSetSamplers(startSlot, count, samplers);
+}
+
+// --------------------------------------------------------
+// Drawing and the frame
+// --------------------------------------------------------
+void D3D11RenderDevice::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderDevice::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderDevice::Clear(const float color[4])
+{
+	if (backBufferRTV)
+		context->ClearRenderTargetView(backBufferRTV, color);
+	if (depthStencilView)
+		context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+}
+
+void D3D11RenderDevice::Present()
+{
+	swapChain->Present(0, 0);
+}
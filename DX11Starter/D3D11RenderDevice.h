@@ -0,0 +1,73 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// The RenderDevice that draws: each call goes straight to a
+// D3D11 device, context and swap chain
+//
+// Those are borrowed, not owned (DXCore creates them); the
+// back buffer and depth views are handed over again whenever
+// they're recreated.
+// --------------------------------------------------------
+class D3D11RenderDevice : public RenderDevice
+{
+
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain);
+	~D3D11RenderDevice();
+
+	// What Clear() clears
+	void SetRenderTargets(ID3D11RenderTargetView* backBufferRTV, ID3D11DepthStencilView* depthStencilView);
+
+	ID3D11Buffer* CreateBuffer(const D3D11_BUFFER_DESC& desc, const void* initialData);
+	ID3D11VertexShader* CreateVertexShader(const void* bytecode, SIZE_T size);
+	ID3D11PixelShader* CreatePixelShader(const void* bytecode, SIZE_T size);
+	ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T size);
+	void Release(ID3D11DeviceChild* resource);
+
+	bool CanOffsetConstantBuffers() { return canOffsetConstantBuffers; }
+	bool CanMapNoOverwriteConstantBuffers() { return canMapNoOverwriteConstantBuffers; }
+
+	void* Map(ID3D11Buffer* buffer, D3D11_MAP mapType);
+	void Unmap(ID3D11Buffer* buffer);
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data);
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+	void VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	void Clear(const float color[4]);
+	void Present();
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	IDXGISwapChain* swapChain;
+	ID3D11RenderTargetView* backBufferRTV;
+	ID3D11DepthStencilView* depthStencilView;
+
+	// Only there on the D3D11.1 runtime (Windows 8 and up)
+	ID3D11DeviceContext1* context1;
+
+	bool canOffsetConstantBuffers;
+	bool canMapNoOverwriteConstantBuffers;
+};
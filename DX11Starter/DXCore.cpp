@@ -1,7 +1,11 @@
 #include "DXCore.h"
+#include "D3D11RenderDevice.h"
+#include "NullRenderDevice.h"
+#include "FramePipeline.h"
 
 #include <WindowsX.h>
 #include <sstream>
+#include <cstdio>
 
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
@@ -26,13 +30,15 @@ LRESULT DXCore::WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 // windowWidth	- Width of the window's client (internal) area
 // windowHeight - Height of the window's client (internal) area
 // debugTitleBarStats - Show debug stats in the title bar, like FPS?
+// pipelineDepth - Frames in flight; over 1 draws on a render thread
 // --------------------------------------------------------
 DXCore::DXCore(
 	HINSTANCE hInstance,		// The application's handle
 	char* titleBarText,			// Text for the window's title bar
 	unsigned int windowWidth,	// Width of the window's client area
 	unsigned int windowHeight,	// Height of the window's client area
-	bool debugTitleBarStats)	// Show extra stats (fps) in title bar?
+	bool debugTitleBarStats,	// Show extra stats (fps) in title bar?
+	unsigned int pipelineDepth)	// Frames in flight (1 = no render thread)
 {
 	// Save a static reference to this object.
 	//  - Since the OS-level message function must be a non-member (global) function, 
@@ -57,6 +63,18 @@ DXCore::DXCore(
 	backBufferRTV = 0;
 	depthStencilView = 0;
 
+	renderDevice = 0;
+	d3d11RenderDevice = 0;
+	nullRenderDevice = 0;
+
+	this->pipelineDepth = pipelineDepth < 1 ? 1 : pipelineDepth;
+	framePipeline = 0;
+	updateSlot = 0;
+	drawSlot = 0;
+	resizePending = false;
+	pendingWidth = 0;
+	pendingHeight = 0;
+
 	// Query performance counter for accurate timing information
 	__int64 perfFreq;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
@@ -68,6 +86,10 @@ DXCore::DXCore(
 // --------------------------------------------------------
 DXCore::~DXCore()
 {
+	// Only one of these was ever created
+	delete d3d11RenderDevice;
+	delete nullRenderDevice;
+
 	// Release all DirectX resources
 	if (depthStencilView) { depthStencilView->Release(); }
 	if (backBufferRTV) { backBufferRTV->Release();}
@@ -264,10 +286,30 @@ HRESULT DXCore::InitDirectX()
 	viewport.MaxDepth	= 1.0f;
 	context->RSSetViewports(1, &viewport);
 
+	// Everything the game does with the GPU goes through this
+	d3d11RenderDevice = new D3D11RenderDevice(device, context, swapChain);
+	d3d11RenderDevice->SetRenderTargets(backBufferRTV, depthStencilView);
+	renderDevice = d3d11RenderDevice;
+
 	// Return the "everything is ok" HRESULT value
 	return S_OK;
 }
 
+// --------------------------------------------------------
+// Sets up for RunHeadless() instead of InitWindow() and
+// InitDirectX(): no window, device or swap chain, just a
+// NullRenderDevice that logs what would have been drawn
+// --------------------------------------------------------
+HRESULT DXCore::InitHeadless()
+{
+	hWnd = 0;
+	dxFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+
+	nullRenderDevice = new NullRenderDevice();
+	renderDevice = nullRenderDevice;
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // When the window is resized, the underlying 
 // buffers (textures) must also be resized to match.
@@ -278,6 +320,9 @@ HRESULT DXCore::InitDirectX()
 // --------------------------------------------------------
 void DXCore::OnResize()
 {
+	// The render thread can't be drawing into what's replaced
+	DrainPipeline();
+
 	// Release existing DirectX views and buffers
 	if (depthStencilView) { depthStencilView->Release(); }
 	if (backBufferRTV) { backBufferRTV->Release(); }
@@ -332,6 +377,30 @@ void DXCore::OnResize()
 	viewport.MinDepth = 0.0f;
 	viewport.MaxDepth = 1.0f;
 	context->RSSetViewports(1, &viewport);
+
+	// The old views are gone
+	if (d3d11RenderDevice)
+		d3d11RenderDevice->SetRenderTargets(backBufferRTV, depthStencilView);
+}
+
+
+// --------------------------------------------------------
+// Waits for the render thread to draw everything submitted.
+//
+// Called on the window's thread, which the render thread can
+// itself be waiting on: Present() may send the window a
+// message (e.g. on a fullscreen switch) and block until it's
+// handled.  So instead of one long wait, handle sent messages
+// in between short ones.
+// --------------------------------------------------------
+void DXCore::DrainPipeline()
+{
+	if (!framePipeline)
+		return;
+
+	MSG msg;
+	while (!framePipeline->Drain(0.001))
+		PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
 }
 
 
@@ -339,6 +408,9 @@ void DXCore::OnResize()
 // This is the main game loop, handling the following:
 //  - OS-level messages coming in from Windows itself
 //  - Calling update & draw back and forth, forever
+//
+// With a pipeline depth over 1, Draw() is handed to a render
+// thread instead, so it overlaps the next frame's Update().
 // --------------------------------------------------------
 HRESULT DXCore::Run()
 {
@@ -353,6 +425,13 @@ HRESULT DXCore::Run()
 	// Give subclass a chance to initialize
 	Init();
 
+	FramePipeline pipeline(pipelineDepth, [this](unsigned int slot, float frameDeltaTime, float frameTotalTime)
+	{
+		drawSlot = slot;
+		Draw(frameDeltaTime, frameTotalTime);
+	});
+	framePipeline = &pipeline;
+
 	// Our overall game and message loop
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -372,18 +451,99 @@ HRESULT DXCore::Run()
 			if(titleBarStats)
 				UpdateTitleBarStats();
 
+			// Resize between frames, never while one is being drawn
+			if (resizePending)
+			{
+				resizePending = false;
+				DrainPipeline();
+				width = pendingWidth;
+				height = pendingHeight;
+				OnResize();
+			}
+
 			// The game loop
+			updateSlot = pipeline.BeginFrame();
 			Update(deltaTime, totalTime);
-			Draw(deltaTime, totalTime);
+			pipeline.SubmitFrame(deltaTime, totalTime);
 		}
 	}
 
+	// Everything submitted gets drawn before the game goes away
+	pipeline.Drain();
+	framePipeline = 0;
+
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
 	return (HRESULT)msg.wParam;
 }
 
 
+// --------------------------------------------------------
+// The game loop without a window, after InitHeadless():
+// frameCount frames of Update() and Draw(), each frameDeltaTime
+// seconds apart, so runs repeat exactly.  Prints how long the
+// CPU spent in each, what the last frame sent to the device
+// and, pipelined, how frames overlapped.
+// --------------------------------------------------------
+void DXCore::RunHeadless(unsigned int frameCount, float frameDeltaTime)
+{
+	Init();
+
+	// Whatever Init() created isn't part of any frame
+	nullRenderDevice->ClearCommands();
+
+	// Draw's side is only touched on the render thread until the
+	// pipeline has drained
+	double updateSeconds = 0.0;
+	double drawSeconds = 0.0;
+	unsigned int commandCount = 0;
+	FramePipeline pipeline(pipelineDepth, [&](unsigned int slot, float frameDeltaTime, float frameTotalTime)
+	{
+		// Keep just the one frame's log
+		nullRenderDevice->ClearCommands();
+
+		__int64 start, drawn;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		drawSlot = slot;
+		Draw(frameDeltaTime, frameTotalTime);
+		QueryPerformanceCounter((LARGE_INTEGER*)&drawn);
+
+		// (Not counting buffers Update() created meanwhile)
+		drawSeconds += (drawn - start) * perfCounterSeconds;
+		commandCount += nullRenderDevice->GetContextCommandCount();
+	});
+	framePipeline = &pipeline;
+
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		deltaTime = frameDeltaTime;
+		totalTime = frameDeltaTime * (frame + 1);
+
+		updateSlot = pipeline.BeginFrame();
+
+		__int64 start, updated;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		Update(deltaTime, totalTime);
+		QueryPerformanceCounter((LARGE_INTEGER*)&updated);
+		updateSeconds += (updated - start) * perfCounterSeconds;
+
+		pipeline.SubmitFrame(deltaTime, totalTime);
+	}
+	pipeline.Drain();
+	framePipeline = 0;
+
+	if (frameCount == 0)
+		return;
+
+	printf("Headless: %u frames, update %.4f ms/frame, draw %.4f ms/frame, %u commands/frame\n",
+		frameCount,
+		updateSeconds * 1000.0 / frameCount,
+		drawSeconds * 1000.0 / frameCount,
+		commandCount / frameCount);
+	pipeline.PrintStats();
+	nullRenderDevice->PrintStats();
+}
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -520,6 +680,8 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	{
 	// This is the message that signifies the window closing
 	case WM_DESTROY:
+		// Let the render thread finish with the window first
+		DrainPipeline();
 		PostQuitMessage(0); // Send a quit message to our own program
 		return 0;
 
@@ -541,6 +703,17 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 		if (wParam == SIZE_MINIMIZED)
 			return 0;
 
+		// While the game loop is running, wait for it to get
+		// between frames: the render thread may be drawing with
+		// the old size (or be in the middle of a Present()).
+		if (framePipeline)
+		{
+			pendingWidth = LOWORD(lParam);
+			pendingHeight = HIWORD(lParam);
+			resizePending = true;
+			return 0;
+		}
+
 		// Save the new client area dimensions.
 		width = LOWORD(lParam);
 		height = HIWORD(lParam);
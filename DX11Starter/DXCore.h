@@ -4,6 +4,12 @@
 #include <d3d11.h>
 #include <string>
 
+#include "RenderDevice.h"
+
+class D3D11RenderDevice;
+class NullRenderDevice;
+class FramePipeline;
+
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
@@ -16,7 +22,8 @@ public:
 		char* titleBarText,			// Text for the window's title bar
 		unsigned int windowWidth,	// Width of the window's client area
 		unsigned int windowHeight,	// Height of the window's client area
-		bool debugTitleBarStats);	// Show extra stats (fps) in title bar?
+		bool debugTitleBarStats,	// Show extra stats (fps) in title bar?
+		unsigned int pipelineDepth);	// Frames in flight (1 = no render thread)
 	~DXCore();
 
 	// Static requirements for OS-level message processing
@@ -37,8 +44,18 @@ public:
 	HRESULT Run();				
 	void Quit();
 	virtual void OnResize();
+
+	// No window or GPU: everything the game draws goes to a
+	// NullRenderDevice, and RunHeadless() steps a fixed number
+	// of frames (at a fixed deltaTime) instead of Run()
+	HRESULT InitHeadless();
+	void RunHeadless(unsigned int frameCount, float frameDeltaTime);
 	
 	// Pure virtual methods for setup and game functionality
+	//  - With a pipeline depth over 1, Draw() runs on a render
+	//    thread, drawing an earlier frame while Update() runs.
+	//    Update() writes what Draw() needs into the slot
+	//    GetUpdateSlot() names, and Draw() reads GetDrawSlot()'s.
 	virtual void Init()										= 0;
 	virtual void Update(float deltaTime, float totalTime)	= 0;
 	virtual void Draw(float deltaTime, float totalTime)		= 0;
@@ -69,10 +86,40 @@ protected:
 	ID3D11RenderTargetView* backBufferRTV;
 	ID3D11DepthStencilView* depthStencilView;
 
+	// What the game creates, binds and draws through - the
+	// D3D11 device above, or a NullRenderDevice when headless
+	RenderDevice*			renderDevice;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
+	// How many slots the game should keep snapshots in, and
+	// which one this Update() or Draw() call uses
+	unsigned int GetPipelineDepth() { return pipelineDepth; }
+	unsigned int GetUpdateSlot() { return updateSlot; }
+	unsigned int GetDrawSlot() { return drawSlot; }
+
 private:
+	// Whichever one renderDevice is
+	D3D11RenderDevice*		d3d11RenderDevice;
+	NullRenderDevice*		nullRenderDevice;
+
+	// Update/draw pipelining; framePipeline only exists while running
+	unsigned int pipelineDepth;
+	FramePipeline* framePipeline;
+	unsigned int updateSlot;
+	unsigned int drawSlot;
+
+	// A WM_SIZE that came in while frames were in flight; Run()
+	// resizes before the next frame instead
+	bool resizePending;
+	unsigned int pendingWidth;
+	unsigned int pendingHeight;
+
+	// Drains the pipeline while still handling messages sent to
+	// the window, which the render thread may be waiting on
+	void DrainPipeline();
+
 	// Timing related data
 	double perfCounterSeconds;
 	float totalTime;
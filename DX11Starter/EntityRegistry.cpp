@@ -0,0 +1,241 @@
+#include "EntityRegistry.h"
+
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+EntityRegistry::EntityRegistry()
+{
+}
+
+EntityRegistry::~EntityRegistry()
+{
+}
+
+// --------------------------------------------------------
+// Adds an entity with an identity transform
+// --------------------------------------------------------
+EntityHandle EntityRegistry::Create(Mesh* mesh, Material* material)
+{
+	EntityHandle entity;
+	if (freeIndices.empty())
+	{
+		entity.Index = (unsigned int)generations.size();
+		generations.push_back(0);
+		denseOfIndex.push_back(0);
+	}
+	else
+	{
+		entity.Index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	entity.Generation = generations[entity.Index];
+
+	EntityBounds empty = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), 0.0f };
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	unsigned int dense = (unsigned int)meshes.size();
+	denseOfIndex[entity.Index] = dense;
+	meshes.push_back(mesh);
+	materials.push_back(material);
+	bounds.push_back(empty);
+	transformIds.push_back(transforms.Add());
+	nodeIds.push_back(hierarchy.Add(dense));
+	worldMatrices.push_back(identity);
+	indexOfDense.push_back(entity.Index);
+	return entity;
+}
+
+// --------------------------------------------------------
+// Removes an entity, moving the last one into its place
+// (the TransformSystem does the same with its slots)
+// --------------------------------------------------------
+void EntityRegistry::Destroy(EntityHandle entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	unsigned int dense = denseOfIndex[entity.Index];
+	unsigned int last = (unsigned int)meshes.size() - 1;
+
+	transforms.Remove(transformIds[dense]);
+	hierarchy.Remove(nodeIds[dense]);
+
+	meshes[dense] = meshes[last];
+	materials[dense] = materials[last];
+	bounds[dense] = bounds[last];
+	transformIds[dense] = transformIds[last];
+	nodeIds[dense] = nodeIds[last];
+	worldMatrices[dense] = worldMatrices[last];
+	indexOfDense[dense] = indexOfDense[last];
+	denseOfIndex[indexOfDense[dense]] = dense;
+	if (dense != last)
+		hierarchy.SetTarget(nodeIds[dense], dense);
+
+	meshes.pop_back();
+	materials.pop_back();
+	bounds.pop_back();
+	transformIds.pop_back();
+	nodeIds.pop_back();
+	worldMatrices.pop_back();
+	indexOfDense.pop_back();
+
+	generations[entity.Index]++;
+	freeIndices.push_back(entity.Index);
+}
+
+bool EntityRegistry::IsAlive(EntityHandle entity)
+{
+	return entity.Index < generations.size() && generations[entity.Index] == entity.Generation;
+}
+
+unsigned int EntityRegistry::GetDenseIndex(EntityHandle entity)
+{
+	return IsAlive(entity) ? denseOfIndex[entity.Index] : InvalidIndex;
+}
+
+EntityHandle EntityRegistry::GetHandle(unsigned int denseIndex)
+{
+	EntityHandle entity;
+	entity.Index = indexOfDense[denseIndex];
+	entity.Generation = generations[entity.Index];
+	return entity;
+}
+
+void EntityRegistry::Reserve(unsigned int capacity)
+{
+	meshes.reserve(capacity);
+	materials.reserve(capacity);
+	bounds.reserve(capacity);
+	transformIds.reserve(capacity);
+	nodeIds.reserve(capacity);
+	worldMatrices.reserve(capacity);
+	indexOfDense.reserve(capacity);
+	denseOfIndex.reserve(capacity);
+	generations.reserve(capacity);
+	transforms.Reserve(capacity);
+}
+
+void EntityRegistry::SetTranslation(EntityHandle entity, float x, float y, float z)
+{
+	if (!IsAlive(entity))
+		return;
+
+	transforms.SetTranslation(transformIds[denseOfIndex[entity.Index]], x, y, z);
+}
+
+void EntityRegistry::SetRotation(EntityHandle entity, float x, float y, float z)
+{
+	if (!IsAlive(entity))
+		return;
+
+	transforms.SetRotation(transformIds[denseOfIndex[entity.Index]], x, y, z);
+}
+
+void EntityRegistry::SetScale(EntityHandle entity, float x, float y, float z)
+{
+	if (!IsAlive(entity))
+		return;
+
+	transforms.SetScale(transformIds[denseOfIndex[entity.Index]], x, y, z);
+}
+
+void EntityRegistry::SetMesh(EntityHandle entity, Mesh* mesh)
+{
+	if (!IsAlive(entity))
+		return;
+
+	meshes[denseOfIndex[entity.Index]] = mesh;
+}
+
+void EntityRegistry::SetMaterial(EntityHandle entity, Material* material)
+{
+	if (!IsAlive(entity))
+		return;
+
+	materials[denseOfIndex[entity.Index]] = material;
+}
+
+bool EntityRegistry::SetParent(EntityHandle entity, EntityHandle parent)
+{
+	if (!IsAlive(entity))
+		return false;
+
+	int parentNode = IsAlive(parent) ? (int)nodeIds[denseOfIndex[parent.Index]] : -1;
+	return hierarchy.SetParent(nodeIds[denseOfIndex[entity.Index]], parentNode);
+}
+
+void EntityRegistry::Update(JobSystem* jobs)
+{
+	// Local matrices first (SIMD), then tell the hierarchy which
+	// ones changed so it only rebuilds the affected subtrees
+	updatedSlots.clear();
+	transforms.UpdateWorldMatrices(&updatedSlots, jobs);
+	for (size_t i = 0; i < updatedSlots.size(); i++)
+		hierarchy.MarkDirty(nodeIds[updatedSlots[i]]);
+
+	// One sweep, parents before children, so it stays on this thread
+	if (!meshes.empty())
+		hierarchy.Update(transforms.GetWorldMatrices(), &worldMatrices[0]);
+
+	// Every entity's box is its own
+	if (jobs)
+	{
+		jobs->ParallelFor(0, (unsigned int)meshes.size(), [this](unsigned int begin, unsigned int end)
+		{
+			UpdateBounds(begin, end);
+		}, MinBoundsPerJob);
+	}
+	else
+	{
+		UpdateBounds(0, (unsigned int)meshes.size());
+	}
+}
+
+// --------------------------------------------------------
+// Moves each mesh's object-space box into world space, for
+// entities [begin, end)
+//
+// Done for every entity, every frame: it's a linear sweep,
+// and meshes that finish loading in the background change
+// their bounds without their transform changing.
+//
+// World matrices are stored transposed, so row r of one is
+// everything that contributes to world-space axis r, and
+// column c is where local axis c ends up (its length is the
+// scale along that axis, which the sphere grows by).
+// --------------------------------------------------------
+void EntityRegistry::UpdateBounds(unsigned int begin, unsigned int end)
+{
+	const XMFLOAT4X4* worlds = GetWorldMatrices();
+	for (unsigned int i = begin; i < end; i++)
+	{
+		XMFLOAT3 boundsMin = meshes[i]->GetBoundsMin();
+		XMFLOAT3 boundsMax = meshes[i]->GetBoundsMax();
+		float local[3][2] =
+		{
+			{ (boundsMin.x + boundsMax.x) * 0.5f, (boundsMax.x - boundsMin.x) * 0.5f },
+			{ (boundsMin.y + boundsMax.y) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f },
+			{ (boundsMin.z + boundsMax.z) * 0.5f, (boundsMax.z - boundsMin.z) * 0.5f },
+		};
+
+		const XMFLOAT4X4& w = worlds[i];
+		float center[3];
+		float extents[3];
+		float maxScaleSq = 0.0f;
+		for (int r = 0; r < 3; r++)
+		{
+			center[r] = w.m[r][0] * local[0][0] + w.m[r][1] * local[1][0] + w.m[r][2] * local[2][0] + w.m[r][3];
+			extents[r] = fabsf(w.m[r][0]) * local[0][1] + fabsf(w.m[r][1]) * local[1][1] + fabsf(w.m[r][2]) * local[2][1];
+
+			float scaleSq = w.m[0][r] * w.m[0][r] + w.m[1][r] * w.m[1][r] + w.m[2][r] * w.m[2][r];
+			if (scaleSq > maxScaleSq) maxScaleSq = scaleSq;
+		}
+
+		bounds[i].Center = XMFLOAT3(center[0], center[1], center[2]);
+		bounds[i].Extents = XMFLOAT3(extents[0], extents[1], extents[2]);
+		bounds[i].Radius = meshes[i]->GetBoundsRadius() * sqrtf(maxScaleSq);
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "Mesh.h"
+#include "Material.h"
+#include "TransformSystem.h"
+#include "TransformHierarchy.h"
+
+// --------------------------------------------------------
+// Refers to an entity in an EntityRegistry
+//
+// The generation changes whenever an index is reused, so a
+// handle to a destroyed entity never finds its replacement.
+// --------------------------------------------------------
+struct EntityHandle
+{
+	unsigned int Index;
+	unsigned int Generation;
+};
+
+// World-space axis-aligned bounding box, plus a bounding
+// sphere around the same center
+struct EntityBounds
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 Extents;
+	float Radius;
+};
+
+// --------------------------------------------------------
+// Owns every entity in the scene, stored as parallel arrays
+// of components (mesh, material, transform, bounds)
+//
+// The arrays are dense: entity i of GetCount() has its mesh
+// at GetMeshes()[i], its world matrix at GetWorldMatrices()[i]
+// and so on.  Destroying an entity moves the last one into
+// its place, so dense positions change but handles don't.
+//
+// The transforms live in a TransformSystem that only this
+// registry adds to and removes from, in the same order, so
+// its slots always line up with the dense arrays here.  Its
+// matrices are local (relative to the parent, if any); a
+// TransformHierarchy combines them into world matrices.
+// --------------------------------------------------------
+class EntityRegistry
+{
+
+public:
+	EntityRegistry();
+	~EntityRegistry();
+
+	EntityHandle Create(Mesh* mesh, Material* material);
+	void Destroy(EntityHandle entity);
+	bool IsAlive(EntityHandle entity);
+	void Reserve(unsigned int capacity);
+
+	// Setters ignore handles that aren't alive
+	void SetTranslation(EntityHandle entity, float x, float y, float z);
+	void SetRotation(EntityHandle entity, float x, float y, float z);
+	void SetScale(EntityHandle entity, float x, float y, float z);
+	void SetMesh(EntityHandle entity, Mesh* mesh);
+	void SetMaterial(EntityHandle entity, Material* material);
+
+	// Makes the entity's transform relative to the parent's.  Pass
+	// a handle that isn't alive (e.g. a destroyed one) to detach.
+	// Destroying a parent hands its children to the grandparent.
+	// False if the entity itself isn't alive, or if the parent
+	// is the entity or one of its descendants.
+	bool SetParent(EntityHandle entity, EntityHandle parent);
+
+	// Once per frame: rebuilds changed local matrices, then
+	// world matrices for them and their descendants, then
+	// every world-space bounding box.  Given a JobSystem, the
+	// local matrices and boxes are split across its threads.
+	void Update(JobSystem* jobs = 0);
+
+	// Dense component arrays, GetCount() long
+	unsigned int GetCount() { return (unsigned int)meshes.size(); }
+	Mesh* const* GetMeshes() { return meshes.empty() ? 0 : &meshes[0]; }
+	Material* const* GetMaterials() { return materials.empty() ? 0 : &materials[0]; }
+	const EntityBounds* GetBounds() { return bounds.empty() ? 0 : &bounds[0]; }
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() { return worldMatrices.empty() ? 0 : &worldMatrices[0]; }
+
+	// Where an entity currently is in the dense arrays, or
+	// InvalidIndex if it isn't alive
+	unsigned int GetDenseIndex(EntityHandle entity);
+
+	// The entity at a dense position (e.g. one a raycast hit)
+	EntityHandle GetHandle(unsigned int denseIndex);
+
+	static const unsigned int InvalidIndex = ~0u;
+
+private:
+	// Dense, one per live entity
+	std::vector<Mesh*> meshes;
+	std::vector<Material*> materials;
+	std::vector<EntityBounds> bounds;
+	std::vector<unsigned int> transformIds;
+	std::vector<unsigned int> nodeIds;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<unsigned int> indexOfDense;
+
+	// Sparse, one per handle index ever given out
+	std::vector<unsigned int> denseOfIndex;
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> freeIndices;
+
+	TransformSystem transforms;
+	TransformHierarchy hierarchy;
+	std::vector<unsigned int> updatedSlots;
+
+	void UpdateBounds(unsigned int begin, unsigned int end);
+
+	// Entities below this aren't worth a job of their own
+	static const unsigned int MinBoundsPerJob = 256;
+};
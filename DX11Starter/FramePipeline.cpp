@@ -0,0 +1,171 @@
+#include "FramePipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+static double Now()
+{
+	return std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+FramePipeline::FramePipeline(unsigned int depth, DrawFunction draw)
+{
+	this->depth = depth < 1 ? 1 : depth;
+	this->draw = draw;
+	slots = new Slot[this->depth];
+
+	framesBegun = 0;
+	framesSubmitted = 0;
+	framesDrawn = 0;
+	shuttingDown = false;
+	ResetStats();
+
+	// One slot needs no second thread
+	if (this->depth > 1)
+		renderThread = std::thread(&FramePipeline::RenderLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	if (renderThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			shuttingDown = true;
+		}
+		frameSubmitted.notify_all();
+		renderThread.join();
+	}
+
+	delete[] slots;
+}
+
+// --------------------------------------------------------
+// A slot is free once the frame that last used it has been
+// drawn: at most depth frames are begun but not yet drawn
+// --------------------------------------------------------
+unsigned int FramePipeline::BeginFrame()
+{
+	double start = Now();
+	unsigned long long frame;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		frameDrawn.wait(lock, [this]() { return framesBegun - framesDrawn < depth; });
+		frame = framesBegun++;
+	}
+
+	double now = Now();
+	Slot& slot = slots[frame % depth];
+	slot.BeginTime = now;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.UpdateWaitSeconds += now - start;
+	return (unsigned int)(frame % depth);
+}
+
+void FramePipeline::SubmitFrame(float deltaTime, float totalTime)
+{
+	unsigned long long frame = framesSubmitted;
+	Slot& slot = slots[frame % depth];
+	slot.DeltaTime = deltaTime;
+	slot.TotalTime = totalTime;
+
+	if (depth == 1)
+	{
+		framesSubmitted++;
+		draw(0, deltaTime, totalTime);
+		FinishFrame(frame, slot);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		framesSubmitted++;
+	}
+	frameSubmitted.notify_one();
+}
+
+void FramePipeline::Drain()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	frameDrawn.wait(lock, [this]() { return framesDrawn == framesSubmitted; });
+}
+
+bool FramePipeline::Drain(double timeoutSeconds)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return frameDrawn.wait_for(lock, std::chrono::duration<double>(timeoutSeconds),
+		[this]() { return framesDrawn == framesSubmitted; });
+}
+
+// --------------------------------------------------------
+// The render thread: draws each submitted slot in turn,
+// and everything left over when shutting down
+// --------------------------------------------------------
+void FramePipeline::RenderLoop()
+{
+	for (;;)
+	{
+		unsigned long long frame;
+		double start = Now();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameSubmitted.wait(lock, [this]() { return framesDrawn < framesSubmitted || shuttingDown; });
+			if (framesDrawn == framesSubmitted)
+				return;
+			frame = framesDrawn;
+			stats.DrawWaitSeconds += Now() - start;
+		}
+
+		// The slot is ours until framesDrawn moves past it
+		const Slot& slot = slots[frame % depth];
+		draw((unsigned int)(frame % depth), slot.DeltaTime, slot.TotalTime);
+		FinishFrame(frame, slot);
+		frameDrawn.notify_all();
+	}
+}
+
+void FramePipeline::FinishFrame(unsigned long long frame, const Slot& slot)
+{
+	double latency = Now() - slot.BeginTime;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	framesDrawn = frame + 1;
+	stats.Frames++;
+	stats.LatencySeconds += latency;
+	if (latency > stats.MaxLatencySeconds)
+		stats.MaxLatencySeconds = latency;
+}
+
+FramePipelineStats FramePipeline::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FramePipelineStats current = stats;
+	current.Seconds = Now() - statsStart;
+	return current;
+}
+
+void FramePipeline::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	memset(&stats, 0, sizeof(stats));
+	statsStart = Now();
+}
+
+void FramePipeline::PrintStats()
+{
+	FramePipelineStats current = GetStats();
+	if (current.Frames == 0)
+		return;
+
+	printf("Frame pipeline (depth %u): %u frames, %.1f frames/s, latency %.3f ms (max %.3f), waits: update %.3f ms/frame, draw %.3f ms/frame\n",
+		depth,
+		current.Frames,
+		current.Frames / current.Seconds,
+		current.LatencySeconds * 1000.0 / current.Frames,
+		current.MaxLatencySeconds * 1000.0,
+		current.UpdateWaitSeconds * 1000.0 / current.Frames,
+		current.DrawWaitSeconds * 1000.0 / current.Frames);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// How frames have moved through a FramePipeline since its
+// stats were last reset
+struct FramePipelineStats
+{
+	unsigned int Frames;			// Drawn
+	double Seconds;					// Wall clock
+	double LatencySeconds;			// Added up, BeginFrame() to drawn
+	double MaxLatencySeconds;
+	double UpdateWaitSeconds;		// BeginFrame() waiting for a free slot
+	double DrawWaitSeconds;			// The render thread waiting for a frame
+};
+
+// --------------------------------------------------------
+// Runs the game's update and draw as a two-stage pipeline:
+// the calling thread simulates frame N+1 while a render
+// thread draws frame N
+//
+// Each frame lives in one of depth slots (the game keeps
+// whatever it hands from update to draw - its "snapshot" -
+// once per slot).  BeginFrame() waits for a slot the render
+// thread is done with and returns it; the caller fills it in
+// and SubmitFrame()s it, and the render thread draws slots
+// in the order they were submitted.
+//
+// Depth trades latency for throughput: with 1, there's no
+// render thread and each frame is drawn inside SubmitFrame(),
+// as if update and draw were called back to back.  With 2,
+// update runs one frame ahead of draw; more lets it run
+// further ahead, absorbing uneven frames at the cost of
+// showing each one later.
+//
+// Nothing but the slots is synchronized: draw must only read
+// its slot (and state no update touches), and update must
+// only write its own.
+// --------------------------------------------------------
+class FramePipeline
+{
+
+public:
+	// Called with the slot to draw and the deltaTime/totalTime it was submitted with
+	typedef std::function<void(unsigned int slot, float deltaTime, float totalTime)> DrawFunction;
+
+	// depth - slots, and so frames in flight; at least 1
+	FramePipeline(unsigned int depth, DrawFunction draw);
+
+	// Draws whatever was submitted, then stops the render thread
+	~FramePipeline();
+
+	unsigned int GetDepth() { return depth; }
+
+	// Waits until a slot is free, and returns it
+	unsigned int BeginFrame();
+
+	// Hands the slot from BeginFrame() to the render thread
+	void SubmitFrame(float deltaTime, float totalTime);
+
+	// Waits until every submitted frame has been drawn, so the
+	// render thread is idle (before a resize, say)
+	void Drain();
+
+	// Same, but gives up after timeoutSeconds - returns true if
+	// everything was drawn.  For threads that have to keep doing
+	// something else while they wait (pumping window messages).
+	bool Drain(double timeoutSeconds);
+
+	FramePipelineStats GetStats();
+	void ResetStats();
+	void PrintStats();
+
+private:
+	struct Slot
+	{
+		float DeltaTime;
+		float TotalTime;
+		double BeginTime;	// When BeginFrame() handed it out
+	};
+
+	unsigned int depth;
+	DrawFunction draw;
+	Slot* slots;
+
+	// Frame numbers; slot = frame % depth
+	unsigned long long framesBegun;
+	unsigned long long framesSubmitted;
+	unsigned long long framesDrawn;
+
+	std::thread renderThread;
+	std::mutex mutex;
+	std::condition_variable frameSubmitted;
+	std::condition_variable frameDrawn;
+	bool shuttingDown;
+
+	FramePipelineStats stats;
+	double statsStart;
+
+	void RenderLoop();
+	void FinishFrame(unsigned long long frame, const Slot& slot);
+};
@@ -0,0 +1,166 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+FrustumCuller::FrustumCuller()
+{
+	// Until SetPlanes() is called nothing is culled
+	for (int i = 0; i < 6; i++)
+		planes[i] = XMFLOAT4(0, 0, 0, 1);
+	TransposePlanes();
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
+
+// --------------------------------------------------------
+// Extracts the frustum planes from view * projection
+// (Gribb & Hartmann).  With row vectors, clip = v * VP, so
+// each clip coordinate is a dot product with one column of
+// VP.  The matrices come in transposed, and the rows of
+// P^T * V^T are exactly those columns.
+//
+// D3D clip space has 0 <= z <= w, so the near plane is just
+// the z column rather than w + z.
+// --------------------------------------------------------
+void FrustumCuller::SetPlanes(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMMATRIX viewT = XMLoadFloat4x4(&view);
+	XMMATRIX projectionT = XMLoadFloat4x4(&projection);
+
+	XMFLOAT4X4 columns;
+	XMStoreFloat4x4(&columns, XMMatrixMultiply(projectionT, viewT));
+
+	XMVECTOR x = XMLoadFloat4((XMFLOAT4*)columns.m[0]);
+	XMVECTOR y = XMLoadFloat4((XMFLOAT4*)columns.m[1]);
+	XMVECTOR z = XMLoadFloat4((XMFLOAT4*)columns.m[2]);
+	XMVECTOR w = XMLoadFloat4((XMFLOAT4*)columns.m[3]);
+
+	XMVECTOR planeVectors[6] =
+	{
+		XMVectorAdd(w, x),		// Left
+		XMVectorSubtract(w, x),	// Right
+		XMVectorAdd(w, y),		// Bottom
+		XMVectorSubtract(w, y),	// Top
+		z,						// Near
+		XMVectorSubtract(w, z),	// Far
+	};
+
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(planeVectors[i]));
+
+	TransposePlanes();
+}
+
+void FrustumCuller::TransposePlanes()
+{
+	for (int group = 0; group < 2; group++)
+	{
+		const XMFLOAT4& a = planes[group ? 4 : 0];
+		const XMFLOAT4& b = planes[group ? 5 : 1];
+		const XMFLOAT4& c = planes[group ? 4 : 2];
+		const XMFLOAT4& d = planes[group ? 5 : 3];
+		planesX[group] = XMFLOAT4(a.x, b.x, c.x, d.x);
+		planesY[group] = XMFLOAT4(a.y, b.y, c.y, d.y);
+		planesZ[group] = XMFLOAT4(a.z, b.z, c.z, d.z);
+		planesW[group] = XMFLOAT4(a.w, b.w, c.w, d.w);
+	}
+}
+
+// --------------------------------------------------------
+// Tests every entity against four planes per instruction:
+//
+//   distance = plane . center
+//   reach    = min(radius, |n.x| ex + |n.y| ey + |n.z| ez)
+//
+// The box's reach is how far it extends towards the plane.
+// If distance < -reach for any plane, the entity is out.
+// --------------------------------------------------------
+unsigned int FrustumCuller::Cull(const EntityBounds* bounds, unsigned int count, unsigned char* visible)
+{
+	XMVECTOR px[2], py[2], pz[2], pw[2];
+	XMVECTOR absX[2], absY[2], absZ[2];
+	for (int g = 0; g < 2; g++)
+	{
+		px[g] = XMLoadFloat4(&planesX[g]);
+		py[g] = XMLoadFloat4(&planesY[g]);
+		pz[g] = XMLoadFloat4(&planesZ[g]);
+		pw[g] = XMLoadFloat4(&planesW[g]);
+		absX[g] = XMVectorAbs(px[g]);
+		absY[g] = XMVectorAbs(py[g]);
+		absZ[g] = XMVectorAbs(pz[g]);
+	}
+
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const EntityBounds& b = bounds[i];
+		XMVECTOR cx = XMVectorReplicate(b.Center.x);
+		XMVECTOR cy = XMVectorReplicate(b.Center.y);
+		XMVECTOR cz = XMVectorReplicate(b.Center.z);
+		XMVECTOR ex = XMVectorReplicate(b.Extents.x);
+		XMVECTOR ey = XMVectorReplicate(b.Extents.y);
+		XMVECTOR ez = XMVectorReplicate(b.Extents.z);
+		XMVECTOR radius = XMVectorReplicate(b.Radius);
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int g = 0; g < 2; g++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(px[g], cx, XMVectorMultiplyAdd(py[g], cy, XMVectorMultiplyAdd(pz[g], cz, pw[g])));
+			XMVECTOR boxReach = XMVectorMultiplyAdd(absX[g], ex, XMVectorMultiplyAdd(absY[g], ey, XMVectorMultiply(absZ[g], ez)));
+			XMVECTOR reach = XMVectorMin(radius, boxReach);
+			outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, reach), XMVectorZero()));
+		}
+
+		unsigned char isVisible = XMVector4EqualInt(outside, XMVectorFalseInt()) ? 1 : 0;
+		visible[i] = isVisible;
+		visibleCount += isVisible;
+	}
+	return visibleCount;
+}
+
+unsigned int FrustumCuller::CullScalar(const EntityBounds* bounds, unsigned int count, unsigned char* visible)
+{
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const EntityBounds& b = bounds[i];
+		unsigned char isVisible = 1;
+		for (int p = 0; p < 6 && isVisible; p++)
+		{
+			const XMFLOAT4& plane = planes[p];
+			float distance = plane.x * b.Center.x + plane.y * b.Center.y + plane.z * b.Center.z + plane.w;
+			float boxReach = fabsf(plane.x) * b.Extents.x + fabsf(plane.y) * b.Extents.y + fabsf(plane.z) * b.Extents.z;
+			float reach = b.Radius < boxReach ? b.Radius : boxReach;
+			if (distance + reach < 0.0f)
+				isVisible = 0;
+		}
+
+		visible[i] = isVisible;
+		visibleCount += isVisible;
+	}
+	return visibleCount;
+}
+
+FrustumTest FrustumCuller::ClassifyBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	XMFLOAT3 center((boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f);
+	XMFLOAT3 extents((boxMax.x - boxMin.x) * 0.5f, (boxMax.y - boxMin.y) * 0.5f, (boxMax.z - boxMin.z) * 0.5f);
+
+	FrustumTest result = FrustumInside;
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = planes[p];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+		if (distance + reach < 0.0f)
+			return FrustumOutside;
+		if (distance - reach < 0.0f)
+			result = FrustumIntersects;
+	}
+	return result;
+}
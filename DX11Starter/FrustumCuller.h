@@ -0,0 +1,59 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "EntityRegistry.h"
+
+// Where a box lies relative to the frustum
+enum FrustumTest
+{
+	FrustumOutside,
+	FrustumIntersects,
+	FrustumInside,
+};
+
+// --------------------------------------------------------
+// Rejects bounding volumes that are entirely outside the
+// camera's view frustum
+//
+// SetPlanes() extracts the six planes from a view and a
+// projection matrix (stored transposed, as Camera keeps
+// them).  Cull() then tests each entity's sphere and box
+// against all six planes at once with SSE: an entity is out
+// if, for any plane, it lies completely on the outside by
+// either its sphere or its box - whichever is tighter there.
+// --------------------------------------------------------
+class FrustumCuller
+{
+
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	void SetPlanes(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Writes 1 (visible) or 0 for each entity, returns the visible count
+	unsigned int Cull(const EntityBounds* bounds, unsigned int count, unsigned char* visible);
+
+	// One plane at a time, for comparison
+	unsigned int CullScalar(const EntityBounds* bounds, unsigned int count, unsigned char* visible);
+
+	// For hierarchies: boxes that are fully inside don't need
+	// anything under them tested
+	FrustumTest ClassifyBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
+
+	// Left, right, bottom, top, near, far - normals point inwards
+	const DirectX::XMFLOAT4* GetPlanes() { return planes; }
+
+private:
+	DirectX::XMFLOAT4 planes[6];
+
+	// The same planes, transposed into two groups of four
+	// (the second group repeats the last two planes)
+	DirectX::XMFLOAT4 planesX[2];
+	DirectX::XMFLOAT4 planesY[2];
+	DirectX::XMFLOAT4 planesZ[2];
+	DirectX::XMFLOAT4 planesW[2];
+
+	void TransposePlanes();
+};
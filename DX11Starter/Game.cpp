@@ -17,31 +17,47 @@ Game::Game(HINSTANCE hInstance)
 		"DirectX Game",	   	// Text for the window's title bar
 		1280,			// Width of the window's client area
 		720,			// Height of the window's client area
-		true)			// Show extra stats (fps) in title bar?
+		true,			// Show extra stats (fps) in title bar?
+		2)				// Draw one frame while updating the next
 {
 	// Initialize fields;
 	vertexShader = 0;
+	packedVertexShader = 0;
+	instancedVertexShader = 0;
+	packedInstancedVertexShader = 0;
 	pixelShader = 0;
 
 	triangle = 0;
 	square = 0;
 	hexagon = 0;
+	placeholder = 0;
 
+	jobSystem = 0;
+	meshLoader = 0;
+	renderJobs = 0;
+	meshCache = 0;
 	for (int i = 0; i < 6; i++) {
 		models[i] = 0;
 	}
 
-	for (int i = 0; i < 5; i++) {
-		gameEntities[i] = 0;
-	}
+	entities = 0;
+	pickedEntity.Index = 0;
+	pickedEntity.Generation = 0;
+	hasPickedEntity = false;
+	entityTree = 0;
+	frustumCuller = 0;
+	instancedRenderer = 0;
+	stateCache = 0;
 
 	camera = new Camera((float)width, (float)height);
 
 	directionalLight_1 = { XMFLOAT4(0.1f, 0.1f, 0.1f, 1.0f), XMFLOAT4(0, 0, 1, 1), XMFLOAT3(1, -1, 0) };
 	directionalLight_2 = { XMFLOAT4(0.1f, 0.1f, 0.1f, 1.0f), XMFLOAT4(1, 0, 0, 1), XMFLOAT3(-1, 1, 0) };
 
-#if defined(DEBUG) || defined(_DEBUG)
+#if defined(DEBUG) || defined(_DEBUG) || defined(RUN_BENCHMARKS) || defined(RUN_HEADLESS)
 	// Do we want a console window?  Probably only in debug mode
+	// (or when benchmarking or running headless, since that's
+	// where results go)
 	CreateConsoleWindow(500, 120, 32, 120);
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
@@ -58,6 +74,9 @@ Game::~Game()
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
 	delete vertexShader;
+	delete packedVertexShader;
+	delete instancedVertexShader;
+	delete packedInstancedVertexShader;
 	delete pixelShader;
 
 	delete triangle;
@@ -66,17 +85,23 @@ Game::~Game()
 
 	for (int i = 0; i < 6; i++)
 	{
-		delete models[i];
+		if (models[i]) meshCache->Release(models[i]);
 	}
+	delete meshCache;
+	delete meshLoader;
+	delete jobSystem;
 
-	for (int i = 0; i < 5; i++) 
-	{
-		delete gameEntities[i];
-	}
+	delete entities;
+	delete entityTree;
+	delete frustumCuller;
+	delete instancedRenderer;
+	delete renderJobs;
+	delete stateCache;
 
 	delete camera;
 
 	delete defaultMaterial;
+	delete packedMaterial;
 }
 
 // --------------------------------------------------------
@@ -85,6 +110,10 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Filters out redundant binds; the shaders and renderer
+	// created below all bind through it
+	stateCache = new StateCache(renderDevice);
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
@@ -95,17 +124,16 @@ void Game::Init()
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	stateCache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	pixelShader->SetData(
-		"light_1",  // The name of the (eventual) variable in the shader
-		&directionalLight_1,   // The address of the data to copy
-		sizeof(DirectionalLight)); // The size of the data to copy
+	// Update() writes one of these per frame in flight; the
+	// lights travel in them too, so Draw() sets them
+	snapshots.resize(GetPipelineDepth());
 
-	pixelShader->SetData(
-		"light_2",  // The name of the (eventual) variable in the shader
-		&directionalLight_2,   // The address of the data to copy
-		sizeof(DirectionalLight)); // The size of the data to copy
+#if defined(RUN_BENCHMARKS)
+	// CPU-side benchmarks print their results to the console
+	Benchmarks::RunAll();
+#endif
 }
 
 // --------------------------------------------------------
@@ -116,13 +144,49 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	vertexShader = new SimpleVertexShader(device, context);
+	vertexShader = new SimpleVertexShader(renderDevice);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
 
-	pixelShader = new SimplePixelShader(device, context);
+	pixelShader = new SimplePixelShader(renderDevice);
 	pixelShader->LoadShaderFile(L"PixelShader.cso");
 
-	defaultMaterial = new Material(vertexShader, pixelShader);
+	// Variants that take world matrices per instance, for drawing
+	// many copies of a mesh at once
+	instancedVertexShader = new SimpleVertexShader(renderDevice);
+	instancedVertexShader->LoadShaderFile(L"VertexShaderInstanced.cso");
+
+	defaultMaterial = new Material(vertexShader, pixelShader, instancedVertexShader);
+
+	// For meshes stored as PackedVertex
+	packedVertexShader = new SimpleVertexShader(renderDevice);
+	packedVertexShader->LoadShaderFile(L"VertexShaderPacked.cso");
+	packedInstancedVertexShader = new SimpleVertexShader(renderDevice);
+	packedInstancedVertexShader->LoadShaderFile(L"VertexShaderPackedInstanced.cso");
+	packedMaterial = new Material(packedVertexShader, pixelShader, packedInstancedVertexShader);
+
+	SimpleVertexShader* vertexShaders[] = { vertexShader, instancedVertexShader, packedVertexShader, packedInstancedVertexShader };
+	for (int i = 0; i < 4; i++)
+		vertexShaders[i]->SetStateCache(stateCache);
+	pixelShader->SetStateCache(stateCache);
+
+	// Objects that aren't instanced get their world matrix
+	// uploaded one at a time, many times a frame
+	vertexShader->SetBufferDynamic("perObject", true);
+	packedVertexShader->SetBufferDynamic("perObject", true);
+
+#if defined(DEBUG) || defined(_DEBUG) || defined(RUN_BENCHMARKS) || defined(RUN_HEADLESS)
+	// Missing shaders don't stop anything else from running, so
+	// a headless run would otherwise happily time empty frames
+	ISimpleShader* shaders[] = { vertexShader, instancedVertexShader, packedVertexShader, packedInstancedVertexShader, pixelShader };
+	for (int i = 0; i < 5; i++)
+	{
+		if (!shaders[i]->IsShaderValid())
+		{
+			printf("Warning: shaders (.cso) not found - run from the directory they're built into, or nothing will be drawn\n");
+			break;
+		}
+	}
+#endif
 }
 
 
@@ -201,7 +265,7 @@ void Game::CreateBasicGeometry()
 	// - But just to see how it's done...
 	UINT triangleIndices[] = { 0, 1, 2 };
 
-	triangle = new Mesh(triangleVertices, 3, triangleIndices, 3, device);
+	triangle = new Mesh(triangleVertices, 3, triangleIndices, 3, renderDevice);
 
 	Vertex squareVertices[] =
 	{
@@ -211,7 +275,7 @@ void Game::CreateBasicGeometry()
 		{ XMFLOAT3(-1.0f, +1.0f, +0.0f), normal, uv },
 	};
 	UINT squareIndices[] = { 0, 1, 2, 0, 2, 3 };
-	square = new Mesh(squareVertices, 4, squareIndices, 6, device);
+	square = new Mesh(squareVertices, 4, squareIndices, 6, renderDevice);
 
 	Vertex hexagonVertices[] =
 	{
@@ -224,29 +288,42 @@ void Game::CreateBasicGeometry()
 		{ XMFLOAT3(-0.5f, +1.0f, +0.0f), normal, uv },
 	};
 	UINT hexagonIndices[] = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 0, 5, 6, 0, 6, 1 };
-	hexagon = new Mesh(hexagonVertices, 7, hexagonIndices, 18, device);
+	hexagon = new Mesh(hexagonVertices, 7, hexagonIndices, 18, renderDevice);
+
+	// Stands in for models that are still loading
+	placeholder = square;
 
 	//Import models
-	models[0] = new Mesh("../../Assets/Models/torus.obj", device);
-	models[1] = new Mesh("../../Assets/Models/cube.obj", device);
-	models[2] = new Mesh("../../Assets/Models/cone.obj", device);
-	models[3] = new Mesh("../../Assets/Models/cylinder.obj", device);
-	models[4] = new Mesh("../../Assets/Models/helix.obj", device);
-	models[5] = new Mesh("../../Assets/Models/torus.obj", device);
-	
-	//gameEntities[0] = new GameEntity(hexagon, defaultMaterial);
-	//gameEntities[1] = new GameEntity(hexagon, defaultMaterial);
-	//gameEntities[2] = new GameEntity(triangle, defaultMaterial);
-	//gameEntities[3] = new GameEntity(square, defaultMaterial);
-	//gameEntities[4] = new GameEntity(square, defaultMaterial);
-
-	gameEntities[0] = new GameEntity(models[0], defaultMaterial);
-	gameEntities[1] = new GameEntity(models[1], defaultMaterial);
-	gameEntities[2] = new GameEntity(models[2], defaultMaterial);
-	gameEntities[3] = new GameEntity(models[3], defaultMaterial);
-	gameEntities[4] = new GameEntity(models[4], defaultMaterial);
-
-	gameEntities[0]->SetTranslation(0, -0.5f, -2);
+	// - The cache hands back the same Mesh for the same file,
+	//    so models[5] shares models[0]'s buffers
+	// - Files are parsed on background threads; until a model
+	//    is ready, Draw() shows a placeholder in its place
+	jobSystem = new JobSystem();
+	meshLoader = new AsyncMeshLoader(renderDevice, jobSystem);
+	meshCache = new MeshCache(renderDevice, meshLoader);
+	models[0] = meshCache->Acquire("../../Assets/Models/torus.obj");
+	models[1] = meshCache->Acquire("../../Assets/Models/cube.obj");
+	models[2] = meshCache->Acquire("../../Assets/Models/cone.obj");
+	models[3] = meshCache->Acquire("../../Assets/Models/cylinder.obj");
+	models[4] = meshCache->Acquire("../../Assets/Models/helix.obj", VertexFormatPacked);
+	models[5] = meshCache->Acquire("../../Assets/Models/torus.obj");
+
+	entities = new EntityRegistry();
+	entityTree = new BoundingVolumeHierarchy();
+	frustumCuller = new FrustumCuller();
+	instancedRenderer = new InstancedRenderer(renderDevice, stateCache);
+	renderJobs = new JobSystem();
+	entityHandles[0] = entities->Create(models[0], defaultMaterial);
+	entityHandles[1] = entities->Create(models[1], defaultMaterial);
+	entityHandles[2] = entities->Create(models[2], defaultMaterial);
+	entityHandles[3] = entities->Create(models[3], defaultMaterial);
+	entityHandles[4] = entities->Create(models[4], packedMaterial);
+
+	entities->SetTranslation(entityHandles[0], 0, -0.5f, -2);
+	entities->SetTranslation(entityHandles[1], -3, 0, 2);
+	entities->SetTranslation(entityHandles[2], -1, 0, 2);
+	entities->SetTranslation(entityHandles[3], 1, 0, 2);
+	entities->SetTranslation(entityHandles[4], 3, 0, 2);
 }
 
 
@@ -271,75 +348,159 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
+	// Create GPU buffers for any models that finished loading.
+	// Here rather than in Draw(), so their bounds only change
+	// on this thread.
+#if defined(DEBUG) || defined(_DEBUG) || defined(RUN_BENCHMARKS)
+	// What sharing saved is only known once the shared meshes exist
+	if (meshCache->FinalizeReady() > 0 && meshLoader->GetPendingCount() == 0)
+		meshCache->PrintStats();
+#else
+	meshCache->FinalizeReady();
+#endif
+
 	//float sinTime = (sin(totalTime * 2.0f) + 5.0f) / 10.0f;
 
-	//gameEntities[0]->SetTranslation(sin(totalTime), sin(totalTime), 0);
-	//gameEntities[0]->SetRotation(0, 0, totalTime);
-	//gameEntities[0]->SetScale(sinTime, sinTime, sinTime);
+	//entities->SetTranslation(entityHandles[0], sin(totalTime), sin(totalTime), 0);
+	//entities->SetRotation(entityHandles[0], 0, 0, totalTime);
+	//entities->SetScale(entityHandles[0], sinTime, sinTime, sinTime);
+
+	//entities->SetTranslation(entityHandles[1], -totalTime / 2.0f, 0, 0);
 
-	//gameEntities[1]->SetTranslation(-totalTime / 2.0f, 0, 0);
+	//entities->SetRotation(entityHandles[2], 0, 0, totalTime);
+	//entities->SetScale(entityHandles[2], 0.5f, 0.5f, 0.5f);
 
-	//gameEntities[2]->SetRotation(0, 0, totalTime);
-	//gameEntities[2]->SetScale(0.5f, 0.5f, 0.5f);
+	//entities->SetTranslation(entityHandles[3], 2, 0, 0);
+	//entities->SetScale(entityHandles[3], sinTime, sinTime, sinTime);
 
-	//gameEntities[3]->SetTranslation(2, 0, 0);
-	//gameEntities[3]->SetScale(sinTime, sinTime, sinTime);
+	//entities->SetTranslation(entityHandles[4], 0, sin(totalTime), 0);
 
-	//gameEntities[4]->SetTranslation(0, sin(totalTime), 0);
+	// The camera doesn't depend on any entity, so it moves while
+	// they do
+	JobCounter cameraMoved;
+	jobSystem->Run([this, deltaTime, totalTime]() { camera->Update(deltaTime, totalTime); }, &cameraMoved);
 
 	//Rotate
-	gameEntities[0]->SetRotation(0, totalTime, 0);
+	entities->SetRotation(entityHandles[0], 0, totalTime, 0);
+
+	// Rebuild every world matrix that changed this frame in one
+	// pass, split across the job system's threads
+	entities->Update(jobSystem);
+
+	// Keep the culling/picking tree in step with the new bounds
+	entityTree->Update(entities->GetBounds(), entities->GetCount());
+
+	// Culling needs both
+	jobSystem->Wait(&cameraMoved);
+
+	// Hand this frame to Draw()
+	WriteSnapshot(&snapshots[GetUpdateSlot()]);
+}
+
+// --------------------------------------------------------
+// Copies out what Draw() needs this frame: the camera, the
+// lights and whatever the camera can see
+// --------------------------------------------------------
+void Game::WriteSnapshot(RenderSnapshot* snapshot)
+{
+	snapshot->View = camera->GetViewMatrix();
+	snapshot->Projection = camera->GetProjectionMatrix();
+	snapshot->Lights[0] = directionalLight_1;
+	snapshot->Lights[1] = directionalLight_2;
+
+	// Walk the registry's component arrays
+	Mesh* const* meshes = entities->GetMeshes();
+	Material* const* materials = entities->GetMaterials();
+	const XMFLOAT4X4* worldMatrices = entities->GetWorldMatrices();
+
+	// Throw out everything the camera can't see before copying
+	// anything
+	frustumCuller->SetPlanes(snapshot->View, snapshot->Projection);
+	visibleEntities.clear();
+	entityTree->CullFrustum(frustumCuller, entities->GetBounds(), &visibleEntities, jobSystem);
+
+	snapshot->Meshes.clear();
+	snapshot->Materials.clear();
+	snapshot->WorldMatrices.clear();
+	for (size_t v = 0; v < visibleEntities.size(); v++)
+	{
+		unsigned int i = visibleEntities[v];
 
-	camera->Update(deltaTime, totalTime);
+		// Still loading?  Draw the placeholder instead (packed meshes
+		// have no placeholder in their format, so they just wait)
+		Mesh* mesh = meshes[i]->IsReady() ? meshes[i] : placeholder;
+		if (mesh->GetVertexFormat() != meshes[i]->GetVertexFormat())
+			continue;
+
+		snapshot->Meshes.push_back(mesh);
+		snapshot->Materials.push_back(materials[i]);
+		snapshot->WorldMatrices.push_back(worldMatrices[i]);
+	}
 }
 
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
+//
+// Runs on the render thread when the pipeline is deeper than
+// one frame, so it reads only its snapshot and what nothing
+// in Update() touches
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	const RenderSnapshot& snapshot = snapshots[GetDrawSlot()];
+
+	// Counters are per frame
+	stateCache->ResetCounters();
+	ISimpleShader::ResetUploadCounters();
+
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
 
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
 	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV, color);
-	context->ClearDepthStencilView(
-		depthStencilView,
-		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-		1.0f,
-		0);
-	
-	for (int i = 0; i < 1; i++) 
+	renderDevice->Clear(color);
+
+	// Only uploaded if they changed
+	pixelShader->SetData(
+		"light_1",  // The name of the (eventual) variable in the shader
+		&snapshot.Lights[0],   // The address of the data to copy
+		sizeof(DirectionalLight)); // The size of the data to copy
+
+	pixelShader->SetData(
+		"light_2",
+		&snapshot.Lights[1],
+		sizeof(DirectionalLight));
+
+	// Queue up what Update() found visible; the renderer sorts it
+	// to keep state changes down and batches shared meshes and
+	// materials
+	instancedRenderer->Begin(snapshot.View, snapshot.Projection);
+	for (size_t i = 0; i < snapshot.Meshes.size(); i++)
+		instancedRenderer->Add(snapshot.Meshes[i], snapshot.Materials[i], snapshot.WorldMatrices[i]);
+	instancedRenderer->End();
+
+	// Recorded in slices on every core (this one included), then
+	// replayed here in order
+	instancedRenderer->Draw(renderJobs, renderJobs->GetThreadCount());
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Once a second, like the title bar stats
+	if ((int)totalTime != (int)(totalTime - deltaTime))
 	{
-		gameEntities[i]->PrepareMaterial(camera->GetViewMatrix(), camera->GetProjectionMatrix());
-
-		// Set buffers in the input assembler
-		//  - Do this ONCE PER OBJECT you're drawing, since each object might
-		//    have different geometry.
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		ID3D11Buffer* vBuffer = gameEntities[i]->mesh->GetVertexBuffer();
-		context->IASetVertexBuffers(0, 1, &vBuffer, &stride, &offset);
-		context->IASetIndexBuffer(gameEntities[i]->mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-		
-		// Finally do the actual drawing
-		//  - Do this ONCE PER OBJECT you intend to draw
-		//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
-		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-		//     vertices in the currently set VERTEX BUFFER
-		context->DrawIndexed(
-			gameEntities[i]->mesh->GetIndexCount(),		// The number of indices to use (we could draw a subset if we wanted)
-			0,											// Offset to the first index we want to use
-			0);											// Offset to add to each index when looking up vertices
+		instancedRenderer->PrintStats();
+		stateCache->PrintStats();
+		printf("Constant buffers: %u uploads (%u bytes), %u skipped\n",
+			ISimpleShader::GetUploadCount(),
+			ISimpleShader::GetBytesUploaded(),
+			ISimpleShader::GetUploadsSkipped());
 	}
-
+#endif
 
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(0, 0);
+	renderDevice->Present();
 }
 
 
@@ -352,7 +513,45 @@ void Game::Draw(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::OnMouseDown(WPARAM buttonState, int x, int y)
 {
-	// Add any custom code here...
+	// Left click picks whichever entity's box is under the cursor
+	if (buttonState & 0x0001)
+	{
+		// Unproject the cursor onto the near and far planes.  The
+		// camera's matrices are transposed for HLSL, so undo that.
+		XMFLOAT4X4 view = camera->GetViewMatrix();
+		XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+		XMMATRIX viewProjection = XMMatrixMultiply(
+			XMMatrixTranspose(XMLoadFloat4x4(&view)),
+			XMMatrixTranspose(XMLoadFloat4x4(&projection)));
+		XMMATRIX inverseViewProjection = XMMatrixInverse(0, viewProjection);
+
+		float ndcX = 2.0f * x / width - 1.0f;
+		float ndcY = 1.0f - 2.0f * y / height;
+		XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0, 1), inverseViewProjection);
+		XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1, 1), inverseViewProjection);
+
+		XMFLOAT3 origin;
+		XMFLOAT3 direction;
+		XMStoreFloat3(&origin, nearPoint);
+		XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint)));
+
+		float distance;
+		int picked = entityTree->RayCast(origin, direction, entities->GetBounds(), &distance);
+
+		// The tree hands back a dense position, which moves as
+		// entities are destroyed, so hold on to the handle instead
+		hasPickedEntity = picked >= 0;
+		if (hasPickedEntity)
+		{
+			pickedEntity = entities->GetHandle((unsigned int)picked);
+#if defined(DEBUG) || defined(_DEBUG)
+			printf("Picked entity %u (generation %u), %.2f units away\n",
+				pickedEntity.Index,
+				pickedEntity.Generation,
+				distance);
+#endif
+		}
+	}
 
 	// Save the previous mouse position, so we have it for the future
 	prevMousePos.x = x;
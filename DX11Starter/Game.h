@@ -3,12 +3,40 @@
 #include "DXCore.h"
 #include "SimpleShader.h"
 #include <DirectXMath.h>
+#include <vector>
 
 #include "Mesh.h"
-#include "GameEntity.h"
+#include "MeshCache.h"
+#include "AsyncMeshLoader.h"
+#include "JobSystem.h"
+#include "EntityRegistry.h"
+#include "FrustumCuller.h"
+#include "BoundingVolumeHierarchy.h"
+#include "InstancedRenderer.h"
+#include "StateCache.h"
 #include "Camera.h"
 #include "Material.h"
 #include "Lights.h"
+#include "Benchmarks.h"
+
+// --------------------------------------------------------
+// Everything Draw() needs from Update(): the camera, the
+// lights and each visible entity's mesh, material and world
+// matrix.  Update() fills in one per frame, so Draw() can
+// read the last one on the render thread while the next is
+// being written.  The arrays keep their memory between
+// frames.
+// --------------------------------------------------------
+struct RenderSnapshot
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectionalLight Lights[2];
+
+	std::vector<Mesh*> Meshes;		// Placeholders already swapped in
+	std::vector<Material*> Materials;
+	std::vector<DirectX::XMFLOAT4X4> WorldMatrices;
+};
 
 class Game 
 	: public DXCore
@@ -36,9 +64,13 @@ private:
 	void LoadShaders(); 
 	void CreateMatrices();
 	void CreateBasicGeometry();
+	void WriteSnapshot(RenderSnapshot* snapshot);
 
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* packedVertexShader;
+	SimpleVertexShader* instancedVertexShader;
+	SimpleVertexShader* packedInstancedVertexShader;
 	SimplePixelShader* pixelShader;
 
 	// The matrices to go from model space to screen space
@@ -54,15 +86,47 @@ private:
 	Mesh* triangle;
 	Mesh* square;
 	Mesh* hexagon;
+	Mesh* placeholder;
+
+	// Update()'s parallel work and background model loads
+	JobSystem* jobSystem;
 
 	//Models
+	AsyncMeshLoader* meshLoader;
+
+	// Records the renderer's draw slices - apart from jobSystem,
+	// so waiting on them never picks up a model load or the next
+	// Update()'s work and holds the frame up behind it
+	JobSystem* renderJobs;
+	MeshCache* meshCache;
 	Mesh* models[6];
 
-	GameEntity* gameEntities[5];
+	EntityRegistry* entities;
+	EntityHandle entityHandles[5];
+
+	// Last entity clicked on, if any
+	EntityHandle pickedEntity;
+	bool hasPickedEntity;
+
+	// Culling and picking go through a tree over the entities'
+	// bounds; visibleEntities is rebuilt from it every Update()
+	BoundingVolumeHierarchy* entityTree;
+	FrustumCuller* frustumCuller;
+	std::vector<unsigned int> visibleEntities;
+
+	// One per pipeline slot (see DXCore::GetPipelineDepth())
+	std::vector<RenderSnapshot> snapshots;
+
+	// Draws whatever is visible, batching shared meshes and materials
+	InstancedRenderer* instancedRenderer;
+
+	// Everything that binds pipeline state goes through here
+	StateCache* stateCache;
 
 	Camera* camera;
 
 	Material* defaultMaterial;
+	Material* packedMaterial;
 
 	//Lights
 	DirectionalLight directionalLight_1;
@@ -0,0 +1,489 @@
+#include "InstancedRenderer.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Vertex shader variables, hashed at compile time
+static constexpr SimpleShaderName WorldViewProjName("worldViewProj");
+static constexpr SimpleShaderName WorldInverseTransposeName("worldInverseTranspose");
+static constexpr SimpleShaderName BoundsMinName("boundsMin");
+static constexpr SimpleShaderName BoundsExtentName("boundsExtent");
+
+// The vertex shader buffer ObjectMatrices can stand in for
+static const char* PerObjectBufferName = "perObject";
+
+// Pixel shader variables
+static constexpr SimpleShaderName SurfaceColorName("surfaceColor");
+
+static double Now()
+{
+	return std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+InstancedRenderer::InstancedRenderer(RenderDevice* device, StateCache* stateCache)
+{
+	this->device = device;
+	this->stateCache = stateCache;
+
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+
+	// Room for 1024 objects to start with
+	constantRing = new ConstantRingBuffer(device, stateCache, 1024 * ConstantRingBuffer::AlignedSize(sizeof(ObjectMatrices)));
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+	device->Release(instanceBuffer);
+	delete constantRing;
+
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+		delete commandBuffers[i];
+}
+
+void InstancedRenderer::Begin(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	this->view = view;
+
+	// Both are transposed, so (view * projection)^T is
+	// projection^T * view^T
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&projection), XMLoadFloat4x4(&view)));
+
+	queue.Clear();
+	instances.clear();
+	worlds.clear();
+	groups.clear();
+	objectConstants.clear();
+	memset(&stats, 0, sizeof(stats));
+}
+
+void InstancedRenderer::Add(Mesh* mesh, Material* material, const XMFLOAT4X4& world)
+{
+	// How far in front of the camera the object's origin is: the
+	// view matrix's z row (transposed, so it's a row) dotted with
+	// the world matrix's translation column
+	float viewDepth =
+		view._31 * world._14 +
+		view._32 * world._24 +
+		view._33 * world._34 +
+		view._34;
+
+	Instance instance = { mesh, material };
+	queue.Add(queue.MakeKey(material, mesh, viewDepth), (unsigned int)instances.size());
+	instances.push_back(instance);
+	worlds.push_back(world);
+}
+
+// --------------------------------------------------------
+// Sorts, then splits the sorted order into groups wherever
+// the mesh or material changes
+// --------------------------------------------------------
+void InstancedRenderer::End()
+{
+	queue.Sort();
+	const unsigned int* order = queue.GetValues();
+
+	objectMatrices.resize(instances.size());
+	bool anyInstanced = false;
+	for (unsigned int i = 0; i < queue.GetCount(); i++)
+	{
+		const Instance& instance = instances[order[i]];
+		ComputeObjectMatrices(worlds[order[i]], viewProjection, &objectMatrices[i]);
+
+		if (groups.empty() ||
+			groups.back().SharedMesh != instance.mesh ||
+			groups.back().SharedMaterial != instance.material)
+		{
+			InstanceGroup group = { instance.mesh, instance.material, i, 0, false };
+			groups.push_back(group);
+		}
+
+		InstanceGroup& group = groups.back();
+		group.Count++;
+
+		SimpleVertexShader* instancedShader = group.SharedMaterial->GetInstancedVertexShader();
+		group.Instanced = group.Count > 1 && instancedShader && instancedShader->GetPerInstanceCompatible();
+		anyInstanced = anyInstanced || group.Instanced;
+	}
+
+	// Without somewhere to put the matrices, everything is drawn one by one
+	if (anyInstanced && !UploadObjectMatrices())
+	{
+		for (size_t g = 0; g < groups.size(); g++)
+			groups[g].Instanced = false;
+	}
+
+	if (!WriteObjectConstants())
+		objectConstants.clear();
+}
+
+// --------------------------------------------------------
+// Splits the groups into slices, records them (in parallel,
+// given a job system), then replays the slices in order
+//
+// The calling thread records slices too, so busy workers just
+// mean it does more of them itself.
+// --------------------------------------------------------
+void InstancedRenderer::Draw(JobSystem* jobs, unsigned int slices)
+{
+	unsigned int groupCount = (unsigned int)groups.size();
+	unsigned int objects = (unsigned int)objectMatrices.size();
+	if (!jobs || slices < 1)
+		slices = 1;
+	slices = std::min(slices, std::max(objects / MinObjectsPerSlice, 1u));
+	slices = std::min(slices, std::max(groupCount, 1u));
+
+	// Each slice starts at the first group past its share of objects
+	sliceStarts.assign(1, 0);
+	unsigned int objectsSoFar = 0;
+	for (unsigned int g = 0; g < groupCount && sliceStarts.size() < slices; g++)
+	{
+		objectsSoFar += groups[g].Count;
+		if (objectsSoFar * (unsigned long long)slices >= sliceStarts.size() * (unsigned long long)objects && g + 1 < groupCount)
+			sliceStarts.push_back(g + 1);
+	}
+	slices = (unsigned int)sliceStarts.size();
+	sliceStarts.push_back(groupCount);
+
+	while (commandBuffers.size() < slices)
+		commandBuffers.push_back(new CommandBuffer());
+	sliceStats.resize(slices);
+
+	double start = Now();
+	if (slices > 1)
+	{
+		jobs->ParallelFor(0, slices, [this](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int s = begin; s < end; s++)
+				RecordSlice(s);
+		});
+	}
+	else
+	{
+		RecordSlice(0);
+	}
+	double recorded = Now();
+
+	memset(&stats, 0, sizeof(stats));
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		commandBuffers[s]->Execute(stateCache);
+
+		const RenderStats& slice = sliceStats[s];
+		stats.Objects += slice.Objects;
+		stats.DrawCalls += slice.DrawCalls;
+		stats.DrawCallsSaved += slice.DrawCallsSaved;
+		stats.ShaderBinds += slice.ShaderBinds;
+		stats.MaterialBinds += slice.MaterialBinds;
+		stats.MeshBinds += slice.MeshBinds;
+		stats.Commands += commandBuffers[s]->GetCommandCount();
+	}
+	stats.Slices = slices;
+	stats.RecordSeconds = recorded - start;
+	stats.ReplaySeconds = Now() - recorded;
+}
+
+// --------------------------------------------------------
+// One slice's groups, into that slice's command buffer
+// --------------------------------------------------------
+void InstancedRenderer::RecordSlice(unsigned int slice)
+{
+	commandBuffers[slice]->Reset();
+	memset(&sliceStats[slice], 0, sizeof(RenderStats));
+	Record(sliceStarts[slice], sliceStarts[slice + 1], commandBuffers[slice], &sliceStats[slice]);
+}
+
+// --------------------------------------------------------
+// Groups come out of End() sorted, so each kind of state is
+// only touched when it actually changes
+//
+// Shader data follows the same boundaries: mesh data is set
+// when the mesh (or shader) changes, material data when the
+// material changes and the object's matrices per object.  The
+// shaders keep those in separate constant buffers and only
+// upload the ones that changed, so most draws upload just the
+// object's matrices - or, with the ring buffer, upload nothing
+// and just bind the object's slice of it.
+//
+// Only reads the renderer, materials and shaders; everything
+// goes into commands, so slices can be recorded at once.
+// --------------------------------------------------------
+void InstancedRenderer::Record(unsigned int firstGroup, unsigned int endGroup, CommandBuffer* commands, RenderStats* recordStats)
+{
+	SimpleVertexShader* boundVertexShader = 0;
+	SimplePixelShader* boundPixelShader = 0;
+	Material* boundMaterial = 0;
+	Mesh* boundMesh = 0;
+	bool boundInstanceBuffer = false;
+	SimpleShaderHandle worldViewProj = SimpleShaderInvalidHandle;
+	SimpleShaderHandle worldInverseTranspose = SimpleShaderInvalidHandle;
+	int perObjectSlot = -1;
+
+	for (unsigned int g = firstGroup; g < endGroup; g++)
+	{
+		const InstanceGroup& group = groups[g];
+		Material* material = group.SharedMaterial;
+		Mesh* mesh = group.SharedMesh;
+		SimpleVertexShader* vs = group.Instanced ? material->GetInstancedVertexShader() : material->GetVertexShader();
+		SimplePixelShader* ps = material->GetPixelShader();
+
+		bool newVertexShader = vs != boundVertexShader;
+		if (newVertexShader)
+		{
+			commands->SetShader(vs);
+			boundVertexShader = vs;
+			worldViewProj = vs->GetVariableHandle(WorldViewProjName);
+			worldInverseTranspose = vs->GetVariableHandle(WorldInverseTransposeName);
+			recordStats->ShaderBinds++;
+
+			// Only if the shader's buffer is laid out like ObjectMatrices
+			perObjectSlot = -1;
+			const SimpleConstantBuffer* perObject = vs->GetBufferInfo(PerObjectBufferName);
+			if (!objectConstants.empty() && perObject && perObject->Size == sizeof(ObjectMatrices))
+				perObjectSlot = (int)perObject->BindIndex;
+		}
+		if (ps != boundPixelShader)
+		{
+			commands->SetShader(ps);
+			boundPixelShader = ps;
+			recordStats->ShaderBinds++;
+		}
+
+		// Nothing in the pixel shader changes per object
+		if (material != boundMaterial)
+		{
+			XMFLOAT4 color = material->GetColor();
+			commands->SetShaderData(ps, ps->GetVariableHandle(SurfaceColorName), &color, sizeof(color));
+			commands->CopyAllBufferData(ps);
+			boundMaterial = material;
+			recordStats->MaterialBinds++;
+		}
+
+		if (newVertexShader || mesh != boundMesh)
+			RecordMeshData(commands, vs, mesh);
+
+		if (mesh != boundMesh || group.Instanced != boundInstanceBuffer)
+		{
+			ID3D11Buffer* buffers[2] = { mesh->GetVertexBuffer(), instanceBuffer };
+			UINT strides[2] = { mesh->GetVertexStride(), sizeof(ObjectMatrices) };
+			UINT offsets[2] = { 0, 0 };
+			commands->IASetVertexBuffers(0, group.Instanced ? 2 : 1, buffers, strides, offsets);
+			commands->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+			boundMesh = mesh;
+			boundInstanceBuffer = group.Instanced;
+			recordStats->MeshBinds++;
+		}
+
+		if (group.Instanced)
+		{
+			commands->CopyAllBufferData(vs);
+
+			// The group's matrices start at First in the instance buffer
+			commands->DrawIndexedInstanced(
+				mesh->GetIndexCount(),	// Indices per instance
+				group.Count,			// Number of instances
+				0,						// Offset to the first index
+				0,						// Offset to add to each index
+				group.First);			// Offset to the first instance
+
+			recordStats->DrawCalls++;
+			recordStats->DrawCallsSaved += group.Count - 1;
+		}
+		else if (perObjectSlot >= 0)
+		{
+			// Mesh data may still need uploading; the matrices are
+			// already in the ring
+			commands->CopyAllBufferData(vs);
+			for (unsigned int k = group.First; k < group.First + group.Count; k++)
+			{
+				commands->BindConstants(constantRing, perObjectSlot, objectConstants[k]);
+				commands->DrawIndexed(mesh->GetIndexCount(), 0, 0);
+				recordStats->DrawCalls++;
+			}
+		}
+		else
+		{
+			for (unsigned int k = group.First; k < group.First + group.Count; k++)
+			{
+				commands->SetShaderData(vs, worldViewProj, &objectMatrices[k].WorldViewProjection, sizeof(XMFLOAT4X4));
+				commands->SetShaderData(vs, worldInverseTranspose, &objectMatrices[k].WorldInverseTranspose, sizeof(XMFLOAT4X4));
+				commands->CopyAllBufferData(vs);
+				commands->DrawIndexed(mesh->GetIndexCount(), 0, 0);
+				recordStats->DrawCalls++;
+			}
+		}
+		recordStats->Objects += group.Count;
+	}
+}
+
+void InstancedRenderer::PrintStats()
+{
+	printf("Render: %u objects, %u draw calls (%u saved by instancing), binds: %u shader, %u material, %u mesh\n",
+		stats.Objects,
+		stats.DrawCalls,
+		stats.DrawCallsSaved,
+		stats.ShaderBinds,
+		stats.MaterialBinds,
+		stats.MeshBinds);
+	printf("  %u commands recorded in %u slices (%.3f ms), replayed in %.3f ms\n",
+		stats.Commands,
+		stats.Slices,
+		stats.RecordSeconds * 1000.0,
+		stats.ReplaySeconds * 1000.0);
+}
+
+// --------------------------------------------------------
+// Copies this frame's matrices into the instance buffer,
+// growing it first if they don't fit
+//
+// Returns false if the buffer couldn't be created or mapped
+// --------------------------------------------------------
+bool InstancedRenderer::UploadObjectMatrices()
+{
+	unsigned int count = (unsigned int)objectMatrices.size();
+	if (count > instanceCapacity)
+	{
+		device->Release(instanceBuffer);
+		instanceBuffer = 0;
+
+		instanceCapacity = std::max(instanceCapacity, 256u);
+		while (instanceCapacity < count)
+			instanceCapacity *= 2;
+
+		// Rewritten every frame, so DYNAMIC with CPU write access
+		D3D11_BUFFER_DESC ibd;
+		ibd.Usage = D3D11_USAGE_DYNAMIC;
+		ibd.ByteWidth = sizeof(ObjectMatrices) * instanceCapacity;
+		ibd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		ibd.MiscFlags = 0;
+		ibd.StructureByteStride = 0;
+		instanceBuffer = device->CreateBuffer(ibd, 0);
+		if (!instanceBuffer)
+		{
+			instanceCapacity = 0;
+			return false;
+		}
+	}
+
+	// DISCARD hands back fresh memory, so the GPU can keep
+	// reading last frame's matrices while we write these
+	void* mapped = device->Map(instanceBuffer, D3D11_MAP_WRITE_DISCARD);
+	if (!mapped)
+		return false;
+	memcpy(mapped, &objectMatrices[0], sizeof(ObjectMatrices) * count);
+	device->Unmap(instanceBuffer);
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the matrices of every object that isn't instanced
+// into the ring buffer, with one Map for the whole frame
+//
+// Returns false if there's no ring buffer (no D3D11.1) or it
+// couldn't be mapped
+// --------------------------------------------------------
+bool InstancedRenderer::WriteObjectConstants()
+{
+	if (!constantRing->IsSupported())
+		return false;
+
+	unsigned int count = 0;
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		if (!groups[g].Instanced)
+			count += groups[g].Count;
+	}
+	if (count == 0)
+		return false;
+
+	if (!constantRing->Begin(count * ConstantRingBuffer::AlignedSize(sizeof(ObjectMatrices))))
+		return false;
+
+	// Instanced objects get an empty entry, so indices line up
+	// with objectMatrices
+	ConstantAllocation none = { 0, 0 };
+	objectConstants.assign(objectMatrices.size(), none);
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		const InstanceGroup& group = groups[g];
+		if (group.Instanced)
+			continue;
+
+		for (unsigned int k = group.First; k < group.First + group.Count; k++)
+		{
+			void* data = constantRing->Allocate(sizeof(ObjectMatrices), &objectConstants[k]);
+			memcpy(data, &objectMatrices[k], sizeof(ObjectMatrices));
+		}
+	}
+
+	constantRing->End();
+	return true;
+}
+
+// --------------------------------------------------------
+// Combines the matrices a vertex shader would otherwise
+// multiply together for every vertex
+//
+// Everything is stored transposed, so the combined matrix is
+// (world * viewProjection)^T = viewProjection^T * world^T.
+//
+// The inverse transpose of the world's 3x3 is its cofactor
+// matrix over the determinant, and the cofactors are cross
+// products of the 3x3's rows (each row is where one local
+// axis ends up).  Dividing by the determinant, rather than
+// just normalizing, keeps normals pointing the right way
+// under mirroring.
+// --------------------------------------------------------
+void InstancedRenderer::ComputeObjectMatrices(const XMFLOAT4X4& world, const XMFLOAT4X4& viewProjection, ObjectMatrices* matrices)
+{
+	XMMATRIX worldT = XMLoadFloat4x4(&world);
+	XMStoreFloat4x4(&matrices->WorldViewProjection, XMMatrixMultiply(XMLoadFloat4x4(&viewProjection), worldT));
+
+	XMMATRIX rows = XMMatrixTranspose(worldT);
+	XMVECTOR cofactor0 = XMVector3Cross(rows.r[1], rows.r[2]);
+	XMVECTOR cofactor1 = XMVector3Cross(rows.r[2], rows.r[0]);
+	XMVECTOR cofactor2 = XMVector3Cross(rows.r[0], rows.r[1]);
+
+	// A degenerate (zero scale) matrix has no inverse; its
+	// cofactors still give usable directions
+	XMVECTOR determinant = XMVector3Dot(rows.r[0], cofactor0);
+	if (XMVectorGetX(XMVectorAbs(determinant)) < 1e-20f)
+		determinant = XMVectorReplicate(1.0f);
+
+	// The cofactors have w = 0, so this has a zero last row and
+	// column; put the 1 back so it stays a proper 4x4
+	XMVECTOR scale = XMVectorReciprocal(determinant);
+	XMMATRIX inverseTranspose = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(cofactor0, scale),
+		XMVectorMultiply(cofactor1, scale),
+		XMVectorMultiply(cofactor2, scale),
+		XMVectorZero()));
+	inverseTranspose.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&matrices->WorldInverseTranspose, inverseTranspose);
+}
+
+// --------------------------------------------------------
+// The per-mesh part of the vertex shader's data (shaders
+// without these variables just ignore them)
+// --------------------------------------------------------
+void InstancedRenderer::RecordMeshData(CommandBuffer* commands, SimpleVertexShader* vs, Mesh* mesh)
+{
+	// Packed meshes need their bounds to decode positions
+	if (mesh->GetVertexFormat() == VertexFormatPacked)
+	{
+		XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+		XMFLOAT3 boundsExtent = VertexPacking::GetExtent(mesh->GetBoundsMin(), mesh->GetBoundsMax());
+		commands->SetShaderData(vs, vs->GetVariableHandle(BoundsMinName), &boundsMin, sizeof(boundsMin));
+		commands->SetShaderData(vs, vs->GetVariableHandle(BoundsExtentName), &boundsExtent, sizeof(boundsExtent));
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "Mesh.h"
+#include "Material.h"
+#include "RenderQueue.h"
+#include "RenderDevice.h"
+#include "StateCache.h"
+#include "ConstantRingBuffer.h"
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+
+// Consecutive instances that share a mesh and a material
+struct InstanceGroup
+{
+	Mesh* SharedMesh;
+	Material* SharedMaterial;
+	unsigned int First;
+	unsigned int Count;
+
+	// Drawn with one DrawIndexedInstanced call (the material
+	// has an instanced vertex shader, and there's more than one)
+	bool Instanced;
+};
+
+// What the vertex shaders take per object, so they don't
+// have to combine matrices for every vertex.  Both are
+// transposed, ready for a shader.
+struct ObjectMatrices
+{
+	DirectX::XMFLOAT4X4 WorldViewProjection;
+
+	// Transforms normals, even under non-uniform scale
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+};
+
+// What one frame's Draw() cost.  Without sorting, every
+// object would bind its shaders, material and mesh.  (Each
+// slice starts with nothing bound, so binds count a little
+// higher with more slices; the StateCache drops the repeats.)
+struct RenderStats
+{
+	unsigned int Objects;
+	unsigned int DrawCalls;
+	unsigned int DrawCallsSaved;
+	unsigned int ShaderBinds;
+	unsigned int MaterialBinds;
+	unsigned int MeshBinds;
+	unsigned int Slices;		// CommandBuffers recorded
+	unsigned int Commands;
+	double RecordSeconds;		// Start to last slice recorded
+	double ReplaySeconds;
+};
+
+// --------------------------------------------------------
+// Draws a frame's worth of objects with as few state changes
+// and draw calls as it can
+//
+// Each frame: Begin(), Add() every object to draw, End(), then
+// Draw().  End() sorts the objects with a RenderQueue (shaders,
+// then material, then mesh, then front to back), works out
+// their ObjectMatrices and streams them, in that order, into
+// one dynamic vertex buffer.  Runs that share a mesh and
+// material become groups.
+//
+// Draw() walks the groups, binding shaders, material data and
+// mesh buffers only when they differ from the previous group's.
+// Instanced groups bind the matrix buffer to slot 1 (where
+// SimpleVertexShader puts inputs with a "_PER_INSTANCE"
+// semantic) and draw with one DrawIndexedInstanced.
+//
+// The walk is recorded into CommandBuffers, then replayed.
+// Given a JobSystem, Draw() splits the groups into slices of
+// about the same number of objects and records them at once -
+// on the workers and the calling thread - then replays the
+// slices in order, so the device sees the same calls as it
+// would from one thread.
+//
+// On D3D11.1, End() also writes the matrices of everything
+// drawn one by one into a ConstantRingBuffer, and Draw() binds
+// each object's slice as the vertex shader's "perObject"
+// buffer instead of uploading it per draw.  Otherwise (or for
+// shaders whose "perObject" isn't an ObjectMatrices) they go
+// through the shader's own buffer.
+// --------------------------------------------------------
+class InstancedRenderer
+{
+
+public:
+	// Binds go through stateCache; draws and uploads go
+	// straight to the device
+	InstancedRenderer(RenderDevice* device, StateCache* stateCache);
+	~InstancedRenderer();
+
+	// view, projection - the camera's, transposed
+	void Begin(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+	void Add(Mesh* mesh, Material* material, const DirectX::XMFLOAT4X4& world);
+	void End();
+
+	// jobs, slices - record up to this many slices in parallel
+	// (at least MinObjectsPerSlice objects each); 0 records
+	// everything on this thread.  Must be called from the thread
+	// that owns the device.
+	void Draw(JobSystem* jobs = 0, unsigned int slices = 1);
+
+	unsigned int GetGroupCount() { return (unsigned int)groups.size(); }
+	const InstanceGroup* GetGroups() { return groups.empty() ? 0 : &groups[0]; }
+
+	// In group order, after End()
+	const ObjectMatrices* GetObjectMatrices() { return objectMatrices.empty() ? 0 : &objectMatrices[0]; }
+
+	// viewProjection - (view * projection), transposed
+	static void ComputeObjectMatrices(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& viewProjection, ObjectMatrices* matrices);
+
+	const RenderStats& GetStats() { return stats; }
+	void PrintStats();
+
+	static const unsigned int MinObjectsPerSlice = 256;
+
+private:
+	struct Instance
+	{
+		Mesh* mesh;
+		Material* material;
+	};
+
+	RenderDevice* device;
+	StateCache* stateCache;
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	RenderQueue queue;
+	std::vector<Instance> instances;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	std::vector<ObjectMatrices> objectMatrices;
+	std::vector<InstanceGroup> groups;
+
+	// Where each object drawn one by one has its matrices in
+	// the ring buffer, by index into objectMatrices (empty if
+	// the ring isn't being used this frame)
+	ConstantRingBuffer* constantRing;
+	std::vector<ConstantAllocation> objectConstants;
+
+	ID3D11Buffer* instanceBuffer;
+	unsigned int instanceCapacity;
+
+	RenderStats stats;
+
+	// Draw()'s slices: the first group of each (plus the end),
+	// and what each recorded
+	std::vector<unsigned int> sliceStarts;
+	std::vector<CommandBuffer*> commandBuffers;
+	std::vector<RenderStats> sliceStats;
+
+	bool UploadObjectMatrices();
+	bool WriteObjectConstants();
+	void RecordSlice(unsigned int slice);
+	void Record(unsigned int firstGroup, unsigned int endGroup, CommandBuffer* commands, RenderStats* recordStats);
+	void RecordMeshData(CommandBuffer* commands, SimpleVertexShader* vs, Mesh* mesh);
+};
@@ -0,0 +1,494 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// A job and the counter it takes one off when done
+struct JobCounter::Job
+{
+	JobSystem::JobFunction Function;
+	JobCounter* Counter;
+};
+
+// Failed attempts to find a job before a worker sleeps
+static const int SpinCount = 64;
+
+// Which system (if any) the current thread works for, and as
+// which thread
+static thread_local JobSystem* currentSystem = 0;
+static thread_local int currentThreadIndex = -1;
+
+JobCounter::JobCounter()
+{
+	pending = 0;
+}
+
+// --------------------------------------------------------
+// Destructor - The last job can still be inside Finish()
+// after the count reads zero; taking the lock waits it out
+// --------------------------------------------------------
+JobCounter::~JobCounter()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+}
+
+// --------------------------------------------------------
+// WorkDeque
+// --------------------------------------------------------
+JobSystem::WorkDeque::WorkDeque()
+{
+	const long long size = 256;
+	Ring* first = new Ring();
+	first->Mask = size - 1;
+	first->Slots = new std::atomic<Job*>[size];
+
+	top = 0;
+	bottom = 0;
+	ring = first;
+}
+
+JobSystem::WorkDeque::~WorkDeque()
+{
+	outgrown.push_back(ring.load());
+	for (size_t i = 0; i < outgrown.size(); i++)
+	{
+		delete[] outgrown[i]->Slots;
+		delete outgrown[i];
+	}
+}
+
+void JobSystem::WorkDeque::Push(Job* job)
+{
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	Ring* r = ring.load(std::memory_order_relaxed);
+	if (b - t > r->Mask)
+	{
+		r = Grow(r, t, b);
+		ring.store(r, std::memory_order_release);
+	}
+
+	r->Slots[b & r->Mask].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------
+// Takes the newest job.  Only the last one left can race
+// with a thief, and whoever wins the CAS on top gets it.
+// --------------------------------------------------------
+JobSystem::Job* JobSystem::WorkDeque::Pop()
+{
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	Ring* r = ring.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_seq_cst);
+
+	if (t > b)
+	{
+		// Already empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	Job* job = r->Slots[b & r->Mask].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = 0;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+// Takes the oldest job, from any thread
+JobSystem::Job* JobSystem::WorkDeque::Steal()
+{
+	long long t = top.load(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_seq_cst);
+	if (t >= b)
+		return 0;
+
+	Ring* r = ring.load(std::memory_order_acquire);
+	Job* job = r->Slots[t & r->Mask].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return 0;
+	return job;
+}
+
+bool JobSystem::WorkDeque::IsEmpty()
+{
+	return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+JobSystem::WorkDeque::Ring* JobSystem::WorkDeque::Grow(Ring* old, long long from, long long to)
+{
+	long long size = (old->Mask + 1) * 2;
+	Ring* grown = new Ring();
+	grown->Mask = size - 1;
+	grown->Slots = new std::atomic<Job*>[size];
+	for (long long i = from; i < to; i++)
+		grown->Slots[i & grown->Mask].store(old->Slots[i & old->Mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	outgrown.push_back(old);
+	return grown;
+}
+
+// --------------------------------------------------------
+// JobSystem
+// --------------------------------------------------------
+JobSystem::JobSystem(unsigned int workerCount)
+{
+	if (workerCount == DefaultWorkerCount)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 2 ? cores - 1 : 1;
+	}
+
+	threadCount = workerCount + 1;
+	threads = new ThreadState[threadCount];
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		threads[i].NextVictim = i + 1;
+		threads[i].Jobs = 0;
+		threads[i].Steals = 0;
+		threads[i].Splits = 0;
+		threads[i].Sleeps = 0;
+	}
+
+	creatingThread = std::this_thread::get_id();
+	injectedCount = 0;
+	outstandingJobs = 0;
+	queuedJobs = 0;
+	sleepingWorkers = 0;
+	shuttingDown = false;
+
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+// --------------------------------------------------------
+// Destructor - Helps finish every job (including any they
+// start), then wakes the workers to stop them
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	int threadIndex = GetThreadIndex();
+	while (outstandingJobs.load() > 0)
+	{
+		Job* job = FindJob(threadIndex);
+		if (job)
+			Execute(job, threadIndex);
+		else
+			std::this_thread::yield();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		shuttingDown = true;
+	}
+	jobAvailable.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	delete[] threads;
+}
+
+void JobSystem::Run(JobFunction job, JobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1);
+
+	Job* created = new Job();
+	created->Function = job;
+	created->Counter = counter;
+	Push(created);
+}
+
+// --------------------------------------------------------
+// The job is counted now, so waiting on counter covers it
+// even before it's been started
+// --------------------------------------------------------
+void JobSystem::RunAfter(JobCounter* dependency, JobFunction job, JobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1);
+
+	Job* created = new Job();
+	created->Function = job;
+	created->Counter = counter;
+
+	{
+		// Finish() counts down under this lock, so either it
+		// finds the job here or the job finds zero
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (dependency->pending.load() != 0)
+		{
+			dependency->waiting.push_back(created);
+			return;
+		}
+	}
+	Push(created);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int threadIndex = GetThreadIndex();
+	while (!counter->IsDone())
+	{
+		Job* job = FindJob(threadIndex);
+		if (job)
+			Execute(job, threadIndex);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// The shared state of one ParallelFor() call
+struct JobSystem::RangeContext
+{
+	const RangeFunction* Body;
+	unsigned int Chunk;
+	JobCounter Counter;
+};
+
+void JobSystem::ParallelFor(unsigned int begin, unsigned int end, const RangeFunction& body, unsigned int minChunk)
+{
+	if (end <= begin)
+		return;
+
+	// Nobody to share with, or too little to share
+	unsigned int count = end - begin;
+	if (minChunk < 1)
+		minChunk = 1;
+	if (threadCount == 1 || count <= minChunk)
+	{
+		body(begin, end);
+		return;
+	}
+
+	// Small enough chunks that a thread notices quickly when
+	// others have gone idle, big enough to keep the checks cheap
+	RangeContext context;
+	context.Body = &body;
+	context.Chunk = std::max(minChunk, count / (threadCount * 16));
+
+	RunRange(&context, begin, end);
+	Wait(&context.Counter);
+}
+
+// --------------------------------------------------------
+// Lazy binary splitting: a chunk at a time, handing out the
+// back half of what's left whenever this thread's own queue
+// is empty (so any thread that wants work can steal it)
+// --------------------------------------------------------
+void JobSystem::RunRange(RangeContext* context, unsigned int begin, unsigned int end)
+{
+	int threadIndex = GetThreadIndex();
+	ThreadState& state = threads[threadIndex < 0 ? 0 : threadIndex];
+
+	while (begin < end)
+	{
+		if (end - begin >= 2 * context->Chunk && IsLocalQueueEmpty(threadIndex))
+		{
+			unsigned int middle = begin + (end - begin) / 2;
+			unsigned int last = end;
+			Run([this, context, middle, last]() { RunRange(context, middle, last); }, &context->Counter);
+			state.Splits.fetch_add(1, std::memory_order_relaxed);
+			end = middle;
+			continue;
+		}
+
+		unsigned int chunkEnd = std::min(begin + context->Chunk, end);
+		(*context->Body)(begin, chunkEnd);
+		begin = chunkEnd;
+	}
+}
+
+JobSystemStats JobSystem::GetStats()
+{
+	JobSystemStats stats = {};
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		stats.Jobs += threads[i].Jobs.load(std::memory_order_relaxed);
+		stats.Steals += threads[i].Steals.load(std::memory_order_relaxed);
+		stats.Splits += threads[i].Splits.load(std::memory_order_relaxed);
+		stats.Sleeps += threads[i].Sleeps.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void JobSystem::ResetStats()
+{
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		threads[i].Jobs = 0;
+		threads[i].Steals = 0;
+		threads[i].Splits = 0;
+		threads[i].Sleeps = 0;
+	}
+}
+
+int JobSystem::GetThreadIndex()
+{
+	if (currentSystem == this)
+		return currentThreadIndex;
+	if (std::this_thread::get_id() == creatingThread)
+		return 0;
+	return -1;
+}
+
+bool JobSystem::IsLocalQueueEmpty(int threadIndex)
+{
+	if (threadIndex < 0)
+		return injectedCount.load(std::memory_order_relaxed) == 0;
+	return threads[threadIndex].Deque.IsEmpty();
+}
+
+// --------------------------------------------------------
+// Onto this thread's deque (or the shared queue), waking a
+// sleeping worker if there is one.  The sleeper counts itself
+// before checking queuedJobs, and this counts the job before
+// checking sleepingWorkers, so one of the two always sees
+// the other.
+// --------------------------------------------------------
+void JobSystem::Push(Job* job)
+{
+	outstandingJobs.fetch_add(1);
+
+	int threadIndex = GetThreadIndex();
+	if (threadIndex >= 0)
+	{
+		threads[threadIndex].Deque.Push(job);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		injected.push_back(job);
+		injectedCount.fetch_add(1);
+	}
+
+	queuedJobs.fetch_add(1);
+	if (sleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		jobAvailable.notify_one();
+	}
+}
+
+// --------------------------------------------------------
+// This thread's newest job, else the shared queue's oldest,
+// else the oldest job of the first thread (starting after
+// the last one robbed) that has any
+// --------------------------------------------------------
+JobSystem::Job* JobSystem::FindJob(int threadIndex)
+{
+	Job* job = 0;
+	if (threadIndex >= 0)
+		job = threads[threadIndex].Deque.Pop();
+
+	if (!job && injectedCount.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		if (!injected.empty())
+		{
+			job = injected.front();
+			injected.pop_front();
+			injectedCount.fetch_sub(1);
+		}
+	}
+
+	if (!job)
+	{
+		// Threads from outside always start from the first
+		ThreadState& state = threads[threadIndex < 0 ? 0 : threadIndex];
+		unsigned int first = threadIndex < 0 ? 0 : state.NextVictim;
+		for (unsigned int i = 0; i < threadCount && !job; i++)
+		{
+			unsigned int victim = (first + i) % threadCount;
+			if ((int)victim == threadIndex)
+				continue;
+
+			job = threads[victim].Deque.Steal();
+			if (job)
+			{
+				if (threadIndex >= 0)
+					state.NextVictim = victim;
+				state.Steals.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	if (job)
+		queuedJobs.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::Execute(Job* job, int threadIndex)
+{
+	job->Function();
+
+	JobCounter* counter = job->Counter;
+	delete job;
+
+	threads[threadIndex < 0 ? 0 : threadIndex].Jobs.fetch_add(1, std::memory_order_relaxed);
+	if (counter)
+		Finish(counter);
+	outstandingJobs.fetch_sub(1);
+}
+
+// --------------------------------------------------------
+// Takes a finished job off its counter, starting whatever
+// was waiting for the counter to reach zero
+// --------------------------------------------------------
+void JobSystem::Finish(JobCounter* counter)
+{
+	// Under the lock, so RunAfter() either sees a count above
+	// zero and leaves its job here, or sees zero and runs it
+	std::vector<Job*> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1) == 1)
+			released.swap(counter->waiting);
+	}
+
+	for (size_t i = 0; i < released.size(); i++)
+		Push(released[i]);
+}
+
+void JobSystem::WorkerLoop(unsigned int threadIndex)
+{
+	currentSystem = this;
+	currentThreadIndex = (int)threadIndex;
+	ThreadState& state = threads[threadIndex];
+
+	while (true)
+	{
+		Job* job = 0;
+		for (int spin = 0; spin < SpinCount && !job; spin++)
+		{
+			job = FindJob((int)threadIndex);
+			if (!job)
+				std::this_thread::yield();
+		}
+
+		if (job)
+		{
+			Execute(job, (int)threadIndex);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		while (!shuttingDown && queuedJobs.load() == 0)
+		{
+			state.Sleeps.fetch_add(1, std::memory_order_relaxed);
+			jobAvailable.wait(lock);
+		}
+		sleepingWorkers.fetch_sub(1);
+
+		if (shuttingDown && queuedJobs.load() == 0)
+			return;
+	}
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Counts jobs that haven't finished yet
+//
+// Passing a counter to JobSystem::Run() adds one to it, and
+// the job takes that one away when it's done.  Wait() on it
+// to block until they're all done, or RunAfter() it to start
+// a job only then - chaining counters that way builds up a
+// graph of dependencies.  Counters can be reused once they
+// reach zero, but must outlive the jobs counted on them.
+// --------------------------------------------------------
+class JobCounter
+{
+
+public:
+	JobCounter();
+	~JobCounter();
+
+	bool IsDone() { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	struct Job;
+
+	std::atomic<int> pending;
+
+	// Jobs RunAfter() this counter, started when it reaches zero
+	std::mutex mutex;
+	std::vector<Job*> waiting;
+};
+
+// How much work moved between threads since the last ResetStats()
+struct JobSystemStats
+{
+	unsigned long long Jobs;		// Run, on any thread
+	unsigned long long Steals;		// Taken from another thread's deque
+	unsigned long long Splits;		// Ranges ParallelFor() handed out mid-loop
+	unsigned long long Sleeps;		// Workers that ran out of work and blocked
+};
+
+// --------------------------------------------------------
+// A pool of worker threads that balance jobs between them by
+// stealing
+//
+// Every worker, and the thread that created the system, owns
+// a Chase-Lev deque: it pushes and pops jobs at the bottom
+// without locking, while threads that run out take jobs from
+// the top of someone else's.  New work stays on the thread
+// that made it (and hot in its cache) until someone is idle.
+// Any other thread's jobs go into a shared, locked queue.
+//
+// Waiting never just blocks: Wait() and ParallelFor() run
+// jobs on the waiting thread until what they're waiting for
+// is done, so jobs can start and wait for jobs of their own.
+// Workers with nothing to do spin briefly, then sleep until
+// there's work.
+//
+// ParallelFor() splits lazily: each thread works through its
+// range a chunk at a time, and only hands out half of what's
+// left when its own deque has been emptied - when some other
+// thread is idle enough to have stolen from it.  Balanced
+// loops split about once per thread; uneven ones keep
+// splitting where the work turns out to be.
+// --------------------------------------------------------
+class JobSystem
+{
+
+public:
+	typedef std::function<void()> JobFunction;
+
+	// Called with a half-open range [begin, end) of indices
+	typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+
+	// workerCount - threads besides the calling one.  The default
+	// leaves one hardware core for the caller, which runs jobs
+	// whenever it waits, but is never less than one, so jobs
+	// nobody waits on (background loads) still get run.
+	JobSystem(unsigned int workerCount = DefaultWorkerCount);
+
+	// Finishes every job, then stops the workers
+	~JobSystem();
+
+	// Runs the job on whichever thread gets to it first
+	void Run(JobFunction job, JobCounter* counter = 0);
+
+	// Runs the job once dependency reaches zero (right away if
+	// it already has)
+	void RunAfter(JobCounter* dependency, JobFunction job, JobCounter* counter = 0);
+
+	// Runs jobs on this thread until the counter reaches zero
+	void Wait(JobCounter* counter);
+
+	// Calls body over [begin, end) in chunks of at least minChunk
+	// indices, on as many threads as are free, and returns once
+	// every index has been done
+	void ParallelFor(unsigned int begin, unsigned int end, const RangeFunction& body, unsigned int minChunk = 1);
+
+	unsigned int GetWorkerCount() { return (unsigned int)workers.size(); }
+
+	// Workers plus the thread that created the system
+	unsigned int GetThreadCount() { return (unsigned int)workers.size() + 1; }
+
+	JobSystemStats GetStats();
+	void ResetStats();
+
+	static const unsigned int DefaultWorkerCount = ~0u;
+
+private:
+	typedef JobCounter::Job Job;
+
+	// --------------------------------------------------------
+	// Chase & Lev's work-stealing deque, with the memory
+	// orderings from Le et al., "Correct and Efficient
+	// Work-Stealing for Weak Memory Models" (2013)
+	//
+	// Only the owning thread calls Push() and Pop(); anyone
+	// may Steal().  The ring grows when full; outgrown rings
+	// are kept until the deque goes away, since a thief may
+	// still be reading one.
+	// --------------------------------------------------------
+	class WorkDeque
+	{
+
+	public:
+		WorkDeque();
+		~WorkDeque();
+
+		void Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+		bool IsEmpty();
+
+	private:
+		struct Ring
+		{
+			long long Mask;
+			std::atomic<Job*>* Slots;
+		};
+
+		std::atomic<long long> top;
+		std::atomic<long long> bottom;
+		std::atomic<Ring*> ring;
+		std::vector<Ring*> outgrown;
+
+		Ring* Grow(Ring* old, long long from, long long to);
+	};
+
+	// Per-thread state, padded so neighbouring threads' deque
+	// ends and counters don't share a cache line
+	struct ThreadState
+	{
+		WorkDeque Deque;
+		std::atomic<unsigned long long> Jobs;
+		std::atomic<unsigned long long> Steals;
+		std::atomic<unsigned long long> Splits;
+		std::atomic<unsigned long long> Sleeps;
+		unsigned int NextVictim;
+		char Padding[64];
+	};
+
+	// Index 0 is the creating thread; workers are 1 and up
+	std::vector<std::thread> workers;
+	ThreadState* threads;
+	unsigned int threadCount;
+
+	std::thread::id creatingThread;
+
+	// Jobs from threads that aren't one of the above
+	std::mutex injectedMutex;
+	std::deque<Job*> injected;
+	std::atomic<int> injectedCount;
+
+	// Pushed and not yet finished, so the destructor knows
+	// when everything is done
+	std::atomic<int> outstandingJobs;
+
+	// Jobs pushed and not yet taken, so sleepers know to wake
+	std::atomic<int> queuedJobs;
+	std::atomic<int> sleepingWorkers;
+	std::mutex sleepMutex;
+	std::condition_variable jobAvailable;
+	std::atomic<bool> shuttingDown;
+
+	// -1 for a thread that isn't part of this system
+	int GetThreadIndex();
+	bool IsLocalQueueEmpty(int threadIndex);
+	void Push(Job* job);
+	Job* FindJob(int threadIndex);
+	void Execute(Job* job, int threadIndex);
+	void Finish(JobCounter* counter);
+
+	void WorkerLoop(unsigned int threadIndex);
+
+	struct RangeContext;
+	void RunRange(RangeContext* context, unsigned int begin, unsigned int end);
+};
@@ -51,6 +51,16 @@ int WINAPI WinMain(
 	// Result variable for function calls below
 	HRESULT hr = S_OK;
 
+#if defined(RUN_HEADLESS)
+	// No window or GPU: run a fixed number of frames into a
+	// NullRenderDevice and print how long they took
+	hr = dxGame.InitHeadless();
+	if(FAILED(hr)) return hr;
+
+	dxGame.RunHeadless(600, 1.0f / 60.0f);
+	return 0;
+#else
+
 	// Attempt to create the window for our program, and
 	// exit early if something failed
 	hr = dxGame.InitWindow();
@@ -64,4 +74,5 @@ int WINAPI WinMain(
 	// Begin the message and game loop, and then return
 	// whatever we get back once the game loop is over
 	return dxGame.Run();
+#endif
 }
@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+{
+	// Initialize fields
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	data = 0;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps the whole file at the given path for reading
+//
+// Returns true if the file is open and its data is available
+// --------------------------------------------------------
+bool MappedFile::Open(const char* path)
+{
+	// Clean up first, in the event this method is
+	// called more than once on the same object
+	Close();
+
+	file = CreateFileA(
+		path,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	// Windows refuses to map an empty file, but an empty
+	// file is still a perfectly valid (empty) file
+	if (size == 0)
+		return true;
+
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data) { UnmapViewOfFile(data); data = 0; }
+	if (mapping) { CloseHandle(mapping); mapping = 0; }
+	if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); file = INVALID_HANDLE_VALUE; }
+	size = 0;
+}
+
+bool MappedFile::IsOpen()
+{
+	return file != INVALID_HANDLE_VALUE;
+}
+
+const char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
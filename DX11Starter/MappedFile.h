@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// A read-only view of an entire file, mapped into our
+// address space by the OS.  The data is paged in lazily,
+// so opening a large file costs (almost) nothing until
+// we actually touch the bytes.
+// --------------------------------------------------------
+class MappedFile
+{
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+
+	const char* data;
+	size_t size;
+};
@@ -3,10 +3,12 @@
 // For the DirectX Math library
 using namespace DirectX;
 
-Material::Material(SimpleVertexShader* vShader, SimplePixelShader* pShader)
+Material::Material(SimpleVertexShader* vShader, SimplePixelShader* pShader, SimpleVertexShader* instancedVShader)
 {
 	vertexShader = vShader;
 	pixelShader = pShader;
+	instancedVertexShader = instancedVShader;
+	color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 }
 
 Material::~Material()
@@ -22,4 +24,19 @@ SimpleVertexShader* Material::GetVertexShader()
 SimplePixelShader* Material::GetPixelShader()
 {
 	return pixelShader;
+}
+
+SimpleVertexShader* Material::GetInstancedVertexShader()
+{
+	return instancedVertexShader;
+}
+
+XMFLOAT4 Material::GetColor()
+{
+	return color;
+}
+
+void Material::SetColor(XMFLOAT4 color)
+{
+	this->color = color;
 }
\ No newline at end of file
@@ -8,15 +8,24 @@ class Material
 {
 
 public:
-	Material(SimpleVertexShader* vShader, SimplePixelShader* pShader);
+	// instancedVShader - optional; reads world matrices from a
+	// per-instance buffer instead of the constant buffer
+	Material(SimpleVertexShader* vShader, SimplePixelShader* pShader, SimpleVertexShader* instancedVShader = 0);
 	~Material();
 
 	SimpleVertexShader* GetVertexShader();
 	SimplePixelShader* GetPixelShader();
+	SimpleVertexShader* GetInstancedVertexShader();
+
+	// Multiplies the lit color; white by default
+	XMFLOAT4 GetColor();
+	void SetColor(XMFLOAT4 color);
 
 private:
 	// Buffers to hold actual geometry data
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
+	SimpleVertexShader* instancedVertexShader;
+	XMFLOAT4 color;
 
 };
\ No newline at end of file
@@ -3,6 +3,11 @@
 // For the DirectX Math library
 using namespace DirectX;
 
+static inline XMFLOAT3 BoxCenter(XMFLOAT3 min, XMFLOAT3 max)
+{
+	return XMFLOAT3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+}
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -11,113 +16,289 @@ using namespace DirectX;
 //
 // hInstance - the application's OS-level handle (unique ID)
 // --------------------------------------------------------
-Mesh::Mesh(Vertex* vertices, int vCount, UINT* indices, int iCount, ID3D11Device* device)
+Mesh::Mesh(Vertex* vertices, int vCount, UINT* indices, int iCount, RenderDevice* device, VertexFormat format)
 {
 	// Initialize fields
+	this->device = 0;
 	vertexBuffer = 0;
 	indexBuffer = 0;
+	vertexFormat = format;
 
 	vertexCount = vCount;
 	indexCount = iCount;
+	CalculateBounds(vertices, vCount, &boundsMin, &boundsMax);
+	boundsRadius = CalculateBoundingRadius(vertices, vCount, GetBoundsCenter());
 
 	CreateBuffers(vertices, indices, device);
 }
 
-Mesh::Mesh(char* objFile, ID3D11Device* device)
+// --------------------------------------------------------
+// Loads a mesh from an OBJ file (see LoadObjData)
+// --------------------------------------------------------
+Mesh::Mesh(const char* objFile, RenderDevice* device, bool optimize, VertexFormat format)
 {
 	// Initialize fields
+	this->device = 0;
 	vertexBuffer = 0;
 	indexBuffer = 0;
+	vertexFormat = format;
+	vertexCount = 0;
+	indexCount = 0;
+	boundsMin = XMFLOAT3(0, 0, 0);
+	boundsMax = XMFLOAT3(0, 0, 0);
+	boundsRadius = 0.0f;
+
+	MeshData data;
+	if (LoadObjData(objFile, optimize, &data))
+		Finalize(&data, device);
+}
 
-	// File input object
-	std::ifstream obj(objFile);
+// --------------------------------------------------------
+// Creates an empty mesh, to be filled in later by Finalize()
+// (e.g. once a background load completes)
+// --------------------------------------------------------
+Mesh::Mesh(VertexFormat format)
+{
+	// Initialize fields
+	device = 0;
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	vertexFormat = format;
+	vertexCount = 0;
+	indexCount = 0;
+	boundsMin = XMFLOAT3(0, 0, 0);
+	boundsMax = XMFLOAT3(0, 0, 0);
+	boundsRadius = 0.0f;
+}
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
+// --------------------------------------------------------
+// Everything an OBJ load needs to do on the CPU.  Touches no
+// DirectX objects, so it is safe to call from any thread.
+//
+// The first import also writes a binary copy next to the OBJ
+// (objFile + ".mesh").  Later runs map that file and expose
+// its data directly, skipping the parse entirely.  The copy is
+// rebuilt whenever the OBJ's size or timestamp changes.
+//
+// Returns false if the file is missing or has no triangles
+// --------------------------------------------------------
+bool Mesh::LoadObjData(const char* objFile, bool optimize, MeshData* data, JobSystem* jobs)
+{
+	unsigned long long sourceSize = 0;
+	unsigned long long sourceWriteTime = 0;
+	if (!MeshFile::GetSourceStamp(objFile, &sourceSize, &sourceWriteTime))
+		return false;
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-	
-										 // Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+	std::string cachePath = std::string(objFile) + ".mesh";
+	unsigned int flags = optimize ? MeshFile::FlagOptimized : 0;
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+	// Is there an up to date binary copy?
+	if (data->File.Open(cachePath.c_str()))
+	{
+		const MeshFileHeader* header = data->File.GetHeader();
+		if (header->Flags == flags &&
+			header->SourceSize == sourceSize &&
+			header->SourceWriteTime == sourceWriteTime &&
+			header->IndexCount > 0)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			data->VertexPointer = data->File.GetVertices();
+			data->IndexPointer = data->File.GetIndices();
+			data->VertexCount = header->VertexCount;
+			data->IndexCount = header->IndexCount;
+			data->BoundsMin = header->BoundsMin;
+			data->BoundsMax = header->BoundsMax;
+			data->BoundsRadius = header->BoundsRadius;
+			return true;
 		}
-		else if (chars[0] == 'f')
+		data->File.Close();
+	}
+
+	// No - do the full import
+	if (!ImportObj(objFile, optimize, &data->Vertices, &data->Indices, jobs))
+		return false;
+
+	data->VertexPointer = &data->Vertices[0];
+	data->IndexPointer = &data->Indices[0];
+	data->VertexCount = (int)data->Vertices.size();
+	data->IndexCount = (int)data->Indices.size();
+	CalculateBounds(data->VertexPointer, data->VertexCount, &data->BoundsMin, &data->BoundsMax);
+	data->BoundsRadius = CalculateBoundingRadius(data->VertexPointer, data->VertexCount,
+		BoxCenter(data->BoundsMin, data->BoundsMax));
+
+	// Save it for next time (failure just means we parse again)
+	MeshFileHeader header = {};
+	header.Magic = MeshFile::Magic;
+	header.Version = MeshFile::Version;
+	header.Flags = flags;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = data->VertexCount;
+	header.IndexCount = data->IndexCount;
+	header.SourceSize = sourceSize;
+	header.SourceWriteTime = sourceWriteTime;
+	header.BoundsMin = data->BoundsMin;
+	header.BoundsMax = data->BoundsMax;
+	header.BoundsRadius = data->BoundsRadius;
+	MeshFile::Write(cachePath.c_str(), header, data->VertexPointer, data->IndexPointer);
+
+	return true;
+}
+
+// --------------------------------------------------------
+// The GPU half of a load: takes loaded data and creates the
+// buffers.  Must be called on the thread that owns the device.
+// --------------------------------------------------------
+void Mesh::Finalize(MeshData* data, RenderDevice* device)
+{
+	vertexCount = data->VertexCount;
+	indexCount = data->IndexCount;
+	boundsMin = data->BoundsMin;
+	boundsMax = data->BoundsMax;
+	boundsRadius = data->BoundsRadius;
+	CreateBuffers(data->VertexPointer, data->IndexPointer, device);
+}
+
+// --------------------------------------------------------
+// The CPU half of an OBJ import: parse, weld and (optionally)
+// reorder for the vertex caches
+//
+// Returns false if the file is missing or has no triangles
+// --------------------------------------------------------
+bool Mesh::ImportObj(const char* objFile, bool optimize, std::vector<Vertex>* verts, std::vector<UINT>* indices, JobSystem* jobs)
+{
+	// Parse the whole file up front (in parallel for big files,
+	// given somewhere to run the pieces)
+	ObjData obj;
+	if (!ObjParser::ParseFile(objFile, &obj, jobs) || obj.Corners.empty())
+		return false;
+
+	// Weld the corners into shared vertices and real indices
+	AssembleObj(obj, verts, indices);
+
+	// Reorder for the GPU's vertex caches before uploading
+	if (optimize)
+	{
+		int vertexCount = (int)verts->size();
+		int indexCount = (int)indices->size();
+		MeshOptimizer::OptimizeVertexCache(&(*indices)[0], indexCount, vertexCount);
+		verts->resize(MeshOptimizer::OptimizeVertexFetch(&(*verts)[0], vertexCount, &(*indices)[0], indexCount));
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Axis-aligned bounds of a set of vertices
+// --------------------------------------------------------
+void Mesh::CalculateBounds(const Vertex* vertices, int vCount, XMFLOAT3* min, XMFLOAT3* max)
+{
+	if (vCount <= 0)
+	{
+		*min = XMFLOAT3(0, 0, 0);
+		*max = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	XMVECTOR minVector = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR maxVector = minVector;
+	for (int i = 1; i < vCount; i++)
+	{
+		XMVECTOR position = XMLoadFloat3(&vertices[i].Position);
+		minVector = XMVectorMin(minVector, position);
+		maxVector = XMVectorMax(maxVector, position);
+	}
+
+	XMStoreFloat3(min, minVector);
+	XMStoreFloat3(max, maxVector);
+}
+
+// --------------------------------------------------------
+// Radius of the smallest sphere around "center" (normally
+// the box's center) that holds every vertex.  Usually
+// tighter than the box's half diagonal.
+// --------------------------------------------------------
+float Mesh::CalculateBoundingRadius(const Vertex* vertices, int vCount, XMFLOAT3 center)
+{
+	XMVECTOR centerVector = XMLoadFloat3(&center);
+	XMVECTOR maxLengthSq = XMVectorZero();
+	for (int i = 0; i < vCount; i++)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&vertices[i].Position), centerVector);
+		maxLengthSq = XMVectorMax(maxLengthSq, XMVector3LengthSq(offset));
+	}
+	return XMVectorGetX(XMVectorSqrt(maxLengthSq));
+}
+
+// --------------------------------------------------------
+// Hash of a corner's (position, uv, normal) index triple
+// --------------------------------------------------------
+static inline unsigned int HashCorner(const ObjCorner& corner)
+{
+	unsigned int h = (unsigned int)corner.Position * 0x9E3779B1u;
+	h ^= (unsigned int)corner.UV * 0x85EBCA77u + (h << 6) + (h >> 2);
+	h ^= (unsigned int)corner.Normal * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+	return h ^ (h >> 15);
+}
+
+// --------------------------------------------------------
+// Turns parsed OBJ data into a vertex and index list
+//
+// Corners that reference the same (position, uv, normal)
+// triple become the same vertex, so shared vertices are only
+// stored (and transformed by the GPU) once.  The table is
+// open-addressed with linear probing and sized up front, so
+// welding never allocates per corner.
+// --------------------------------------------------------
+void Mesh::AssembleObj(const ObjData& obj, std::vector<Vertex>* verts, std::vector<UINT>* indices)
+{
+	verts->clear();
+	indices->clear();
+	indices->reserve(obj.Corners.size());
+
+	// Keep the table at most half full
+	size_t capacity = 16;
+	while (capacity < obj.Corners.size() * 2)
+		capacity *= 2;
+	size_t mask = capacity - 1;
+	std::vector<UINT> table(capacity, 0xFFFFFFFF);    // Vertex index per slot
+	std::vector<ObjCorner> vertCorners;               // Key of each welded vertex
+	vertCorners.reserve(obj.Corners.size() / 2);
+
+	// Every 3 corners make a triangle
+	for (size_t c = 0; c < obj.Corners.size(); c += 3)
+	{
+		// Add the corners in flipped winding order (see below)
+		static const int order[3] = { 0, 2, 1 };
+		for (int k = 0; k < 3; k++)
 		{
-			// Read the face indices into an array
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
+			const ObjCorner& corner = obj.Corners[c + order[k]];
+
+			// Find this triple, or the empty slot where it belongs
+			size_t slot = HashCorner(corner) & mask;
+			while (table[slot] != 0xFFFFFFFF)
+			{
+				const ObjCorner& existing = vertCorners[table[slot]];
+				if (existing.Position == corner.Position &&
+					existing.UV == corner.UV &&
+					existing.Normal == corner.Normal)
+					break;
+				slot = (slot + 1) & mask;
+			}
+
+			// Already welded?  Just reference it
+			if (table[slot] != 0xFFFFFFFF)
+			{
+				indices->push_back(table[slot]);
+				continue;
+			}
+
+			// - Create the vert by looking up
 			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
+			// - The parser has already made the
+			//    indices 0-based (and -1 if missing)
+			Vertex v;
+			v.Position = obj.Positions[corner.Position];
+			v.UV = corner.UV >= 0 ? obj.UVs[corner.UV] : XMFLOAT2(0, 0);
+			v.Normal = corner.Normal >= 0 ? obj.Normals[corner.Normal] : XMFLOAT3(0, 0, 0);
 
 			// The model is most likely in a right-handed space,
 			// especially if it came from Maya.  We want to convert
@@ -129,76 +310,17 @@ Mesh::Mesh(char* objFile, ID3D11Device* device)
 			// We also need to flip the UV coordinate since DirectX
 			// defines (0,0) as the top left of the texture, and many
 			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
+			v.UV.y = 1.0f - v.UV.y;
+			v.Position.z *= -1.0f;
+			v.Normal.z *= -1.0f;
+
+			UINT index = (UINT)verts->size();
+			table[slot] = index;
+			vertCorners.push_back(corner);
+			verts->push_back(v);
+			indices->push_back(index);
 		}
 	}
-
-	// Close the file and create the actual buffers
-	obj.close();
-
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-	vertexCount = (int)verts.size();
-	indexCount = (int)indices.size();
-	CreateBuffers(&verts[0], &indices[0], device);
 }
 
 // --------------------------------------------------------
@@ -210,31 +332,43 @@ Mesh::~Mesh()
 {
 	// Release any (and all!) DirectX objects
 	// we've made in the Game class
-	if (vertexBuffer) { vertexBuffer->Release(); }
-	if (indexBuffer) { indexBuffer->Release(); }
+	if (device)
+	{
+		device->Release(vertexBuffer);
+		device->Release(indexBuffer);
+	}
 }
 
-void Mesh::CreateBuffers(Vertex* vertices, UINT* indices, ID3D11Device* device)
+void Mesh::CreateBuffers(const Vertex* vertices, const UINT* indices, RenderDevice* device)
 {
+	// Needed again to release the buffers
+	this->device = device;
+
+	// Packed meshes are compressed here, relative to the bounds,
+	// so the file cache and loaders only ever deal with Vertex
+	std::vector<PackedVertex> packed;
+	const void* vertexData = vertices;
+	if (vertexFormat == VertexFormatPacked)
+	{
+		packed.resize(vertexCount);
+		VertexPacking::Pack(vertices, vertexCount, boundsMin, boundsMax, &packed[0]);
+		vertexData = &packed[0];
+	}
+
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertexCount;       // 3 = number of vertices in the buffer
+	vbd.ByteWidth = GetVertexStride() * vertexCount;       // 3 = number of vertices in the buffer
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
 	vbd.StructureByteStride = 0;
 
-	// Create the proper struct to hold the initial vertex data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertices;
-
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer);
+	vertexBuffer = device->CreateBuffer(vbd, vertexData);
 
 
 
@@ -249,14 +383,9 @@ void Mesh::CreateBuffers(Vertex* vertices, UINT* indices, ID3D11Device* device)
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 
-	// Create the proper struct to hold the initial index data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
-
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+	indexBuffer = device->CreateBuffer(ibd, indices);
 }
 
 void Mesh::Draw(ID3D11DeviceContext* context)
@@ -264,6 +393,23 @@ void Mesh::Draw(ID3D11DeviceContext* context)
 
 }
 
+// --------------------------------------------------------
+// Fills an empty mesh with another (ready) mesh's buffers
+// rather than its own copy of the same data.  The source
+// keeps ownership, so it must outlive this mesh.
+// --------------------------------------------------------
+void Mesh::ShareBuffers(Mesh* source)
+{
+	device = 0;
+	vertexBuffer = source->vertexBuffer;
+	indexBuffer = source->indexBuffer;
+	vertexCount = source->vertexCount;
+	indexCount = source->indexCount;
+	boundsMin = source->boundsMin;
+	boundsMax = source->boundsMax;
+	boundsRadius = source->boundsRadius;
+}
+
 ID3D11Buffer* Mesh::GetVertexBuffer()
 {
 	return vertexBuffer;
@@ -274,7 +420,47 @@ ID3D11Buffer* Mesh::GetIndexBuffer()
 	return indexBuffer;
 }
 
+bool Mesh::IsReady()
+{
+	return indexBuffer != 0;
+}
+
 int Mesh::GetIndexCount()
 {
 	return indexCount;
+}
+
+int Mesh::GetVertexCount()
+{
+	return vertexCount;
+}
+
+VertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+UINT Mesh::GetVertexStride()
+{
+	return vertexFormat == VertexFormatPacked ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return BoxCenter(boundsMin, boundsMax);
+}
+
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
 }
\ No newline at end of file
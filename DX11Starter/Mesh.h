@@ -1,34 +1,89 @@
 #pragma once
 
-#include "DXCore.h"
+#include "RenderDevice.h"
 #include <DirectXMath.h>
 
 #include <vector>
-#include <iostream>
-#include <fstream>
+#include <string>
 
 #include "Vertex.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "MeshFile.h"
+#include "VertexPacking.h"
+
+// --------------------------------------------------------
+// CPU-side result of loading a mesh file
+//
+// The pointers either point into the vectors (fresh import)
+// or directly into the mapped binary file (cached load).
+// --------------------------------------------------------
+struct MeshData
+{
+	const Vertex* VertexPointer;
+	const UINT* IndexPointer;
+	int VertexCount;
+	int IndexCount;
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+	float BoundsRadius;
+
+	std::vector<Vertex> Vertices;
+	std::vector<UINT> Indices;
+	MeshFile File;
+};
 
 class Mesh
 {
 
 public:
-	Mesh(Vertex* vertices, int vCount, UINT* indices, int iCount, ID3D11Device* device);
-	Mesh(char* objFile, ID3D11Device* device);
+	Mesh(Vertex* vertices, int vCount, UINT* indices, int iCount, RenderDevice* device, VertexFormat format = VertexFormatFull);
+	Mesh(const char* objFile, RenderDevice* device, bool optimize = true, VertexFormat format = VertexFormatFull);
+	Mesh(VertexFormat format = VertexFormatFull);
 	~Mesh();
 	
-	void CreateBuffers(Vertex* vertices, UINT* indices, ID3D11Device* device);
+	// Loading in two halves, so the CPU work can happen elsewhere.
+	// Given a JobSystem, big files are parsed across its threads.
+	static bool LoadObjData(const char* objFile, bool optimize, MeshData* data, JobSystem* jobs = 0);
+	void Finalize(MeshData* data, RenderDevice* device);
+
+	static bool ImportObj(const char* objFile, bool optimize, std::vector<Vertex>* verts, std::vector<UINT>* indices, JobSystem* jobs = 0);
+	static void AssembleObj(const ObjData& obj, std::vector<Vertex>* verts, std::vector<UINT>* indices);
+	static void CalculateBounds(const Vertex* vertices, int vCount, DirectX::XMFLOAT3* min, DirectX::XMFLOAT3* max);
+	static float CalculateBoundingRadius(const Vertex* vertices, int vCount, DirectX::XMFLOAT3 center);
+
+	void CreateBuffers(const Vertex* vertices, const UINT* indices, RenderDevice* device);
+	void ShareBuffers(Mesh* source);
 	void Draw(ID3D11DeviceContext* context);
 
+	bool IsReady();
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
+	int GetVertexCount();
+	VertexFormat GetVertexFormat();
+	UINT GetVertexStride();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
 
 private:
-	// Buffers to hold actual geometry data
+	// Buffers to hold actual geometry data, and what made them
+	RenderDevice* device;
 	ID3D11Buffer* vertexBuffer;
 	ID3D11Buffer* indexBuffer;
 
 	int vertexCount;
 	int indexCount;
+
+	// Layout of the vertex buffer (packed meshes need
+	// the bounds below to decode their positions)
+	VertexFormat vertexFormat;
+
+	// Object-space bounding box, and a sphere around
+	// the box's center that contains every vertex
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	float boundsRadius;
 };
\ No newline at end of file
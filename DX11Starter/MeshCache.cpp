@@ -0,0 +1,235 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+
+MeshCache::MeshCache(RenderDevice* device, AsyncMeshLoader* loader)
+{
+	this->device = device;
+	this->loader = loader;
+
+	hitCount = 0;
+	missCount = 0;
+	bytesSaved = 0;
+}
+
+// --------------------------------------------------------
+// Destructor - Anything still referenced is deleted here,
+// so leaked references don't leak GPU memory
+// --------------------------------------------------------
+MeshCache::~MeshCache()
+{
+	for (std::unordered_map<Mesh*, Entry*>::iterator it = meshTable.begin(); it != meshTable.end(); ++it)
+	{
+		if (loader) loader->Cancel(it->second->mesh);
+		delete it->second->mesh;
+		delete it->second;
+	}
+}
+
+// --------------------------------------------------------
+// Returns the Mesh for the given file, loading it only if
+// no equivalent file has been loaded yet
+//
+// Never returns 0: a file that can't be read gets an empty
+// mesh that never becomes ready, so callers draw their
+// placeholder for it like any mesh that is still loading
+// --------------------------------------------------------
+Mesh* MeshCache::Acquire(const char* objFile, VertexFormat format)
+{
+	// Same file, same (canonical) name, unchanged since?
+	std::string path = CanonicalPath(objFile);
+	unsigned long long size = 0;
+	unsigned long long writeTime = 0;
+	bool readable = MeshFile::GetSourceStamp(path.c_str(), &size, &writeTime);
+
+	std::string key = path + "|" + std::to_string(size) + "|" + std::to_string(writeTime);
+	if (format == VertexFormatPacked) key += "|packed";
+
+	std::unordered_map<std::string, Entry*>::iterator byPath = pathTable.find(key);
+	if (byPath != pathTable.end())
+		return Hit(byPath->second)->mesh;
+
+	// Without a loader the file is read right here anyway, so
+	// same contents under another name are found up front
+	unsigned long long hash = 0;
+	bool hashed = readable && !loader && MeshFile::HashSource(path.c_str(), &hash);
+	if (hashed)
+	{
+		hash ^= (unsigned long long)format * 0x9E3779B97F4A7C15ULL;
+
+		std::unordered_map<unsigned long long, Entry*>::iterator byHash = hashTable.find(hash);
+		if (byHash != hashTable.end())
+		{
+			pathTable[key] = byHash->second;
+			return Hit(byHash->second)->mesh;
+		}
+	}
+
+	// Genuinely new (as far as we know yet) - load it
+	missCount++;
+
+	Entry* entry = new Entry();
+	if (!readable)
+		entry->mesh = new Mesh(format);
+	else if (loader)
+		entry->mesh = loader->Load(path.c_str(), true, format);
+	else
+		entry->mesh = new Mesh(path.c_str(), device, true, format);
+	entry->refCount = 1;
+	entry->contentHash = hash;
+	entry->hashed = hashed;
+	entry->pendingHits = 0;
+	entry->sharedFrom = 0;
+
+	pathTable[key] = entry;
+	if (hashed) hashTable[hash] = entry;
+	meshTable[entry->mesh] = entry;
+	return entry->mesh;
+}
+
+// --------------------------------------------------------
+// Drops one reference to a mesh from Acquire()
+// --------------------------------------------------------
+void MeshCache::Release(Mesh* mesh)
+{
+	std::unordered_map<Mesh*, Entry*>::iterator it = meshTable.find(mesh);
+	if (it == meshTable.end())
+		return;
+
+	Entry* entry = it->second;
+	if (--entry->refCount > 0)
+		return;
+	SettlePendingHits(entry);
+
+	// Last reference - forget every name it was known by
+	for (std::unordered_map<std::string, Entry*>::iterator p = pathTable.begin(); p != pathTable.end();)
+	{
+		if (p->second == entry) p = pathTable.erase(p);
+		else ++p;
+	}
+	std::unordered_map<unsigned long long, Entry*>::iterator byHash = hashTable.find(entry->contentHash);
+	if (entry->hashed && byHash != hashTable.end() && byHash->second == entry)
+		hashTable.erase(byHash);
+	meshTable.erase(it);
+
+	Entry* sharedFrom = entry->sharedFrom;
+	if (loader) loader->Cancel(entry->mesh);
+	delete entry->mesh;
+	delete entry;
+
+	// Its buffers belonged to this one
+	if (sharedFrom)
+		Release(sharedFrom->mesh);
+}
+
+// --------------------------------------------------------
+// Finalizes the loader's finished meshes, except those whose
+// contents turn out to be loaded already under another name:
+// they are cancelled before creating any buffers, and share
+// the first mesh's buffers once that one is ready.
+// --------------------------------------------------------
+int MeshCache::FinalizeReady()
+{
+	if (!loader)
+		return 0;
+
+	for (std::unordered_map<Mesh*, Entry*>::iterator it = meshTable.begin(); it != meshTable.end(); ++it)
+	{
+		Entry* entry = it->second;
+		unsigned long long hash;
+		if (entry->hashed || !loader->GetContentHash(entry->mesh, &hash))
+			continue;
+
+		hash ^= (unsigned long long)entry->mesh->GetVertexFormat() * 0x9E3779B97F4A7C15ULL;
+		entry->contentHash = hash;
+		entry->hashed = true;
+
+		std::unordered_map<unsigned long long, Entry*>::iterator byHash = hashTable.find(hash);
+		if (byHash == hashTable.end())
+		{
+			hashTable[hash] = entry;
+			continue;
+		}
+
+		// A copy - keep the first one alive for as long as this is
+		loader->Cancel(entry->mesh);
+		entry->sharedFrom = byHash->second;
+		entry->sharedFrom->refCount++;
+	}
+
+	int readyCount = loader->FinalizeReady();
+
+	for (std::unordered_map<Mesh*, Entry*>::iterator it = meshTable.begin(); it != meshTable.end(); ++it)
+	{
+		Entry* entry = it->second;
+		if (!entry->sharedFrom || entry->mesh->IsReady() || !entry->sharedFrom->mesh->IsReady())
+			continue;
+
+		// Saves as much as a hit would have
+		entry->mesh->ShareBuffers(entry->sharedFrom->mesh);
+		entry->pendingHits++;
+		readyCount++;
+	}
+
+	return readyCount;
+}
+
+// --------------------------------------------------------
+// Bytes that would have been loaded again without sharing.
+// Hits on meshes that are still loading are counted once
+// those meshes are ready (until then, their size is unknown).
+// --------------------------------------------------------
+unsigned long long MeshCache::GetBytesSaved()
+{
+	for (std::unordered_map<Mesh*, Entry*>::iterator it = meshTable.begin(); it != meshTable.end(); ++it)
+		SettlePendingHits(it->second);
+
+	return bytesSaved;
+}
+
+void MeshCache::PrintStats()
+{
+	printf("Mesh cache: %u hits, %u misses, %.1f KB of GPU memory and loading saved\n",
+		hitCount,
+		missCount,
+		GetBytesSaved() / 1024.0);
+}
+
+MeshCache::Entry* MeshCache::Hit(Entry* entry)
+{
+	hitCount++;
+	entry->pendingHits++;
+	SettlePendingHits(entry);
+	entry->refCount++;
+	return entry;
+}
+
+void MeshCache::SettlePendingHits(Entry* entry)
+{
+	if (entry->pendingHits == 0 || !entry->mesh->IsReady())
+		return;
+
+	bytesSaved += entry->pendingHits * (
+		(unsigned long long)entry->mesh->GetVertexCount() * entry->mesh->GetVertexStride() +
+		(unsigned long long)entry->mesh->GetIndexCount() * sizeof(UINT));
+	entry->pendingHits = 0;
+}
+
+// --------------------------------------------------------
+// Full, lower case path with consistent slashes, so that
+// "../Models/a.obj" and "..\models\A.obj" are the same key
+// --------------------------------------------------------
+std::string MeshCache::CanonicalPath(const char* path)
+{
+	char fullPath[MAX_PATH];
+	DWORD length = GetFullPathNameA(path, MAX_PATH, fullPath, 0);
+	std::string result = (length > 0 && length < MAX_PATH) ? fullPath : path;
+
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		if (result[i] == '/') result[i] = '\\';
+		else if (result[i] >= 'A' && result[i] <= 'Z') result[i] += 'a' - 'A';
+	}
+
+	return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "AsyncMeshLoader.h"
+
+// --------------------------------------------------------
+// Shares one Mesh between everything that loads the same
+// model file
+//
+// Meshes are looked up by canonical path, size and last write
+// time, so Acquire() never reads the file itself.  Copies of
+// one file under different names are found by a hash of their
+// contents instead, which the loader works out in its jobs.
+// Each Acquire() must be matched by a Release(); the Mesh is
+// deleted when the last reference goes away.
+//
+// The same file in two vertex formats is two separate meshes.
+//
+// Given an AsyncMeshLoader, new meshes are loaded in the
+// background and Acquire() returns them before they are ready.
+// Call FinalizeReady() instead of the loader's, so copies get
+// the buffers that are already loaded instead of their own.
+// --------------------------------------------------------
+class MeshCache
+{
+
+public:
+	MeshCache(RenderDevice* device, AsyncMeshLoader* loader = 0);
+	~MeshCache();
+
+	Mesh* Acquire(const char* objFile, VertexFormat format = VertexFormatFull);
+	void Release(Mesh* mesh);
+
+	// Scene update thread only - returns how many meshes became ready
+	int FinalizeReady();
+
+	unsigned int GetHitCount() { return hitCount; }
+	unsigned int GetMissCount() { return missCount; }
+	unsigned long long GetBytesSaved();
+	void PrintStats();
+
+private:
+	struct Entry
+	{
+		Mesh* mesh;
+		int refCount;
+		unsigned long long contentHash;
+		bool hashed;
+		unsigned int pendingHits;
+		Entry* sharedFrom;	// Same contents, loaded first
+	};
+
+	RenderDevice* device;
+	AsyncMeshLoader* loader;
+
+	std::unordered_map<std::string, Entry*> pathTable;
+	std::unordered_map<unsigned long long, Entry*> hashTable;
+	std::unordered_map<Mesh*, Entry*> meshTable;
+
+	unsigned int hitCount;
+	unsigned int missCount;
+	unsigned long long bytesSaved;
+
+	static std::string CanonicalPath(const char* path);
+
+	Entry* Hit(Entry* entry);
+	void SettlePendingHits(Entry* entry);
+};
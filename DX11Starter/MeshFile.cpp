@@ -0,0 +1,131 @@
+#include "MeshFile.h"
+
+#include <string>
+
+// The blobs are read in place, so the header must keep them aligned
+static_assert(sizeof(MeshFileHeader) % 16 == 0, "MeshFileHeader must keep the vertex blob aligned");
+
+// --------------------------------------------------------
+// Writes a complete mesh file.  Data goes to a temporary file
+// first and is then moved into place, so a crash mid-write
+// never leaves a truncated file behind to be mapped later.
+// --------------------------------------------------------
+bool MeshFile::Write(
+	const char* path,
+	const MeshFileHeader& header,
+	const Vertex* vertices,
+	const unsigned int* indices)
+{
+	std::string tempPath = std::string(path) + ".tmp";
+
+	HANDLE file = CreateFileA(
+		tempPath.c_str(),
+		GENERIC_WRITE,
+		0,
+		0,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	DWORD vertexBytes = header.VertexCount * header.VertexStride;
+	DWORD indexBytes = header.IndexCount * sizeof(unsigned int);
+	bool ok =
+		WriteFile(file, &header, sizeof(MeshFileHeader), &written, 0) && written == sizeof(MeshFileHeader) &&
+		WriteFile(file, vertices, vertexBytes, &written, 0) && written == vertexBytes &&
+		WriteFile(file, indices, indexBytes, &written, 0) && written == indexBytes;
+	CloseHandle(file);
+
+	if (!ok || !MoveFileExA(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshFile::GetSourceStamp(const char* path, unsigned long long* size, unsigned long long* writeTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+		return false;
+
+	*size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	*writeTime =
+		((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+		attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+// --------------------------------------------------------
+// 64-bit FNV-1a of the whole file
+// --------------------------------------------------------
+bool MeshFile::HashSource(const char* path, unsigned long long* hash)
+{
+	MappedFile source;
+	if (!source.Open(path))
+		return false;
+
+	unsigned long long h = 14695981039346656037ULL;
+	const unsigned char* data = (const unsigned char*)source.GetData();
+	for (size_t i = 0; i < source.GetSize(); i++)
+	{
+		h ^= data[i];
+		h *= 1099511628211ULL;
+	}
+
+	*hash = h;
+	return true;
+}
+
+// --------------------------------------------------------
+// Maps the file and checks that it's a mesh file we can use
+// as-is.  Returns false (and closes) if anything is off.
+// --------------------------------------------------------
+bool MeshFile::Open(const char* path)
+{
+	if (!file.Open(path))
+		return false;
+
+	const MeshFileHeader* header = GetHeader();
+	bool valid =
+		file.GetSize() >= sizeof(MeshFileHeader) &&
+		header->Magic == Magic &&
+		header->Version == Version &&
+		header->VertexStride == sizeof(Vertex) &&
+		file.GetSize() ==
+			sizeof(MeshFileHeader) +
+			(unsigned long long)header->VertexCount * sizeof(Vertex) +
+			(unsigned long long)header->IndexCount * sizeof(unsigned int);
+
+	if (!valid)
+	{
+		file.Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshFile::Close()
+{
+	file.Close();
+}
+
+const MeshFileHeader* MeshFile::GetHeader()
+{
+	return (const MeshFileHeader*)file.GetData();
+}
+
+const Vertex* MeshFile::GetVertices()
+{
+	return (const Vertex*)(file.GetData() + sizeof(MeshFileHeader));
+}
+
+const unsigned int* MeshFile::GetIndices()
+{
+	return (const unsigned int*)(file.GetData() + sizeof(MeshFileHeader) + GetHeader()->VertexCount * sizeof(Vertex));
+}
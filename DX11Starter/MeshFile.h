@@ -0,0 +1,74 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Header of a binary mesh file.  The vertex blob (in the
+// exact Vertex layout) follows immediately, then the index
+// blob, so a mapped file can be handed straight to the GPU.
+// --------------------------------------------------------
+struct MeshFileHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int Flags;
+	unsigned int VertexStride;		// Must match sizeof(Vertex)
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+
+	// Identifies the source file this was built from,
+	// so a stale cache is rebuilt when the source changes
+	unsigned long long SourceSize;
+	unsigned long long SourceWriteTime;
+
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+
+	// Around the box's center, so loads needn't visit every vertex
+	float BoundsRadius;
+	unsigned int Reserved[3];
+};
+
+// --------------------------------------------------------
+// Reads and writes binary mesh files
+//
+// Open() memory-maps the file and validates it, after which
+// the vertex and index pointers point directly into the map
+// (no parsing, no copies).  They stay valid until Close().
+// --------------------------------------------------------
+class MeshFile
+{
+
+public:
+	static const unsigned int Magic = 0x3148534D; // "MSH1"
+	static const unsigned int Version = 2;
+
+	// Flags
+	static const unsigned int FlagOptimized = 1;
+
+	static bool Write(
+		const char* path,
+		const MeshFileHeader& header,
+		const Vertex* vertices,
+		const unsigned int* indices);
+
+	// Size and last write time of a source file (false if missing)
+	static bool GetSourceStamp(const char* path, unsigned long long* size, unsigned long long* writeTime);
+
+	// Hash of a source file's contents (false if unreadable).
+	// Reads the whole file, so keep it off the main thread.
+	static bool HashSource(const char* path, unsigned long long* hash);
+
+	bool Open(const char* path);
+	void Close();
+
+	const MeshFileHeader* GetHeader();
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+
+private:
+	MappedFile file;
+};
@@ -0,0 +1,259 @@
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <cstring>
+
+// Forsyth's tuning values
+static const int CacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+static const int MaxValence = 64;
+
+// --------------------------------------------------------
+// Scores are only a function of cache position and how many
+// triangles still need the vertex, so they're tabulated once
+// --------------------------------------------------------
+struct ForsythScoreTables
+{
+	float cacheScore[CacheSize + 3];
+	float valenceScore[MaxValence + 1];
+
+	ForsythScoreTables()
+	{
+		for (int i = 0; i < CacheSize + 3; i++)
+		{
+			if (i < 3)
+			{
+				// The last triangle's verts are deliberately scored lower
+				// so we don't just keep using the same few vertices
+				cacheScore[i] = LastTriScore;
+			}
+			else if (i < CacheSize)
+			{
+				float scaler = 1.0f - (float)(i - 3) / (CacheSize - 3);
+				cacheScore[i] = powf(scaler, CacheDecayPower);
+			}
+			else
+			{
+				cacheScore[i] = 0.0f;
+			}
+		}
+
+		// Boost verts with few triangles left, so we finish them
+		// off rather than leaving lone triangles for later
+		valenceScore[0] = 0.0f;
+		for (int i = 1; i <= MaxValence; i++)
+			valenceScore[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+	}
+};
+
+static float VertexScore(const ForsythScoreTables& tables, int cachePosition, int activeTris)
+{
+	// No triangles left?  This vertex is done
+	if (activeTris == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? tables.cacheScore[cachePosition] : 0.0f;
+	return score + tables.valenceScore[activeTris < MaxValence ? activeTris : MaxValence];
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount)
+{
+	static const ForsythScoreTables tables;
+
+	int triCount = indexCount / 3;
+	if (triCount == 0 || vertexCount == 0)
+		return;
+
+	// Build vertex -> triangle adjacency (compressed rows)
+	std::vector<int> activeTris(vertexCount, 0);
+	for (int i = 0; i < triCount * 3; i++)
+		activeTris[indices[i]]++;
+
+	std::vector<int> adjacencyOffset(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + activeTris[v];
+
+	std::vector<int> adjacency(triCount * 3);
+	std::vector<int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (int t = 0; t < triCount; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+
+	// Initial scores
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScore[v] = VertexScore(tables, -1, activeTris[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	for (int t = 0; t < triCount; t++)
+		triScore[t] =
+			vertexScore[indices[t * 3]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+
+	// Simulated LRU cache (with room for the 3 verts being added)
+	int cache[CacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output(triCount * 3);
+	int bestTri = -1;
+	int scanPosition = 0;
+
+	for (int emittedCount = 0; emittedCount < triCount; emittedCount++)
+	{
+		// Nothing good in the cache?  Take the next triangle in
+		// original order (keeps this linear instead of a full search)
+		if (bestTri < 0)
+		{
+			while (emitted[scanPosition]) scanPosition++;
+			bestTri = scanPosition;
+		}
+
+		// Emit it
+		emitted[bestTri] = true;
+		unsigned int* tri = &indices[bestTri * 3];
+		memcpy(&output[emittedCount * 3], tri, sizeof(unsigned int) * 3);
+
+		// Remove the triangle from its verts' adjacency
+		for (int k = 0; k < 3; k++)
+		{
+			int v = tri[k];
+			int* begin = &adjacency[adjacencyOffset[v]];
+			int* end = begin + activeTris[v];
+			for (int* a = begin; a < end; a++)
+			{
+				if (*a == bestTri)
+				{
+					*a = end[-1];
+					break;
+				}
+			}
+			activeTris[v]--;
+		}
+
+		// Move the triangle's verts to the front of the cache
+		int newCache[CacheSize + 3];
+		newCache[0] = tri[0];
+		newCache[1] = tri[1];
+		newCache[2] = tri[2];
+		int newCount = 3;
+		for (int c = 0; c < cacheCount; c++)
+		{
+			int v = cache[c];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Re-score everything that was (or still is) in the cache.
+		// A triangle can touch several of these verts, so its
+		// score isn't final until they've all been updated.
+		for (int c = 0; c < newCount; c++)
+		{
+			int v = newCache[c];
+			cachePosition[v] = c < CacheSize ? c : -1;
+
+			float score = VertexScore(tables, cachePosition[v], activeTris[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			int* begin = &adjacency[adjacencyOffset[v]];
+			int* end = begin + activeTris[v];
+			for (int* a = begin; a < end; a++)
+				triScore[*a] += delta;
+		}
+
+		// Then find the best triangle touching those verts
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for (int c = 0; c < newCount; c++)
+		{
+			int v = newCache[c];
+			int* begin = &adjacency[adjacencyOffset[v]];
+			int* end = begin + activeTris[v];
+			for (int* a = begin; a < end; a++)
+			{
+				if (triScore[*a] > bestScore)
+				{
+					bestScore = triScore[*a];
+					bestTri = *a;
+				}
+			}
+		}
+
+		cacheCount = newCount < CacheSize ? newCount : CacheSize;
+		memcpy(cache, newCache, sizeof(int) * cacheCount);
+	}
+
+	memcpy(indices, &output[0], sizeof(unsigned int) * triCount * 3);
+}
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the index buffer first
+// uses them.  Unreferenced vertices are dropped.
+//
+// Returns the new vertex count
+// --------------------------------------------------------
+int MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	std::vector<unsigned int> remap(vertexCount, 0xFFFFFFFF);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int& index = indices[i];
+		if (remap[index] == 0xFFFFFFFF)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	if (!reordered.empty())
+		memcpy(vertices, &reordered[0], sizeof(Vertex) * reordered.size());
+	return (int)reordered.size();
+}
+
+// --------------------------------------------------------
+// Counts how many vertices a FIFO post-transform cache of
+// the given size would have to transform
+// --------------------------------------------------------
+int MeshOptimizer::SimulateFifoCache(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	// A vertex is in the cache if it was added within
+	// the last "cacheSize" misses
+	std::vector<int> timestamp(vertexCount, -cacheSize - 1);
+	int misses = 0;
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (misses - timestamp[v] > cacheSize)
+		{
+			timestamp[v] = misses;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+float MeshOptimizer::CalculateACMR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	if (indexCount < 3)
+		return 0.0f;
+	return (float)SimulateFifoCache(indices, indexCount, vertexCount, cacheSize) / (indexCount / 3);
+}
+
+float MeshOptimizer::CalculateATVR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	if (vertexCount == 0)
+		return 0.0f;
+	return (float)SimulateFifoCache(indices, indexCount, vertexCount, cacheSize) / vertexCount;
+}
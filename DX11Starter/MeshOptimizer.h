@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Index/vertex reordering for better GPU cache use
+//
+// - OptimizeVertexCache reorders triangles (Tom Forsyth's
+//    linear-speed algorithm) so recently transformed
+//    vertices get reused before they fall out of the
+//    post-transform cache
+// - OptimizeVertexFetch then reorders the vertices into
+//    first-use order so fetches walk memory linearly
+// - The ACMR/ATVR helpers simulate a FIFO post-transform
+//    cache so the effect can be measured without a GPU
+// --------------------------------------------------------
+class MeshOptimizer
+{
+
+public:
+	static void OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount);
+	static int OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+
+	// Average cache miss ratio: transformed verts per triangle (0.5 - 3.0)
+	static float CalculateACMR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize = 16);
+
+	// Average transform to vertex ratio: transformed verts per vertex (1.0+)
+	static float CalculateATVR(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize = 16);
+
+private:
+	static int SimulateFifoCache(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize);
+};
@@ -0,0 +1,347 @@
+#include "NullRenderDevice.h"
+
+#include <cstdio>
+#include <cstring>
+
+NullRenderDevice::NullRenderDevice(bool canOffsetConstantBuffers, bool canMapNoOverwriteConstantBuffers)
+{
+	this->canOffsetConstantBuffers = canOffsetConstantBuffers;
+	this->canMapNoOverwriteConstantBuffers = canMapNoOverwriteConstantBuffers;
+	liveResources = 0;
+	contextCommandCount = 0;
+}
+
+NullRenderDevice::~NullRenderDevice()
+{
+}
+
+// --------------------------------------------------------
+// Resources
+// --------------------------------------------------------
+ID3D11Buffer* NullRenderDevice::CreateBuffer(const D3D11_BUFFER_DESC& desc, const void* initialData)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	void* buffer = CreateResource(RenderCommandCreateBuffer, initialData, desc.ByteWidth);
+	RenderCommand* command = Record(RenderCommandCreateBuffer, buffer);
+	command->Args[0] = desc.ByteWidth;
+	command->Args[1] = desc.BindFlags;
+	return (ID3D11Buffer*)buffer;
+}
+
+ID3D11VertexShader* NullRenderDevice::CreateVertexShader(const void* bytecode, SIZE_T size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	void* shader = CreateResource(RenderCommandCreateVertexShader, 0, 0);
+	Record(RenderCommandCreateVertexShader, shader)->Args[0] = (unsigned int)size;
+	return (ID3D11VertexShader*)shader;
+}
+
+ID3D11PixelShader* NullRenderDevice::CreatePixelShader(const void* bytecode, SIZE_T size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	void* shader = CreateResource(RenderCommandCreatePixelShader, 0, 0);
+	Record(RenderCommandCreatePixelShader, shader)->Args[0] = (unsigned int)size;
+	return (ID3D11PixelShader*)shader;
+}
+
+ID3D11InputLayout* NullRenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	void* inputLayout = CreateResource(RenderCommandCreateInputLayout, 0, 0);
+	Record(RenderCommandCreateInputLayout, inputLayout)->Args[0] = count;
+	return (ID3D11InputLayout*)inputLayout;
+}
+
+void NullRenderDevice::Release(ID3D11DeviceChild* resource)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int id = GetResourceId(resource);
+	if (id == 0 || id > resources.size() || !resources[id - 1].Live)
+		return;
+
+	Record(RenderCommandRelease, resource);
+	resources[id - 1].Live = false;
+	resources[id - 1].Data.clear();
+	resources[id - 1].Data.shrink_to_fit();
+	liveResources--;
+}
+
+// --------------------------------------------------------
+// Uploads land in the buffer's CPU copy
+// --------------------------------------------------------
+void* NullRenderDevice::Map(ID3D11Buffer* buffer, D3D11_MAP mapType)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandMap, buffer)->Args[0] = mapType;
+
+	Resource* resource = FindBuffer(buffer);
+	if (!resource || resource->Data.empty())
+		return 0;
+	return &resource->Data[0];
+}
+
+void NullRenderDevice::Unmap(ID3D11Buffer* buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandUnmap, buffer);
+}
+
+void NullRenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Resource* resource = FindBuffer(buffer);
+	unsigned int size = resource ? (unsigned int)resource->Data.size() : 0;
+	Record(RenderCommandUpdateBuffer, buffer)->Args[0] = size;
+
+	if (size > 0)
+		memcpy(&resource->Data[0], data, size);
+}
+
+// --------------------------------------------------------
+// Pipeline state
+// --------------------------------------------------------
+void NullRenderDevice::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandIASetInputLayout, inputLayout);
+}
+
+void NullRenderDevice::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandIASetPrimitiveTopology)->Args[0] = topology;
+}
+
+void NullRenderDevice::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderCommand* command = Record(RenderCommandIASetVertexBuffers, count ? buffers[0] : 0, startSlot, count);
+	command->Args[0] = count ? strides[0] : 0;
+	command->Args[1] = count ? offsets[0] : 0;
+}
+
+void NullRenderDevice::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderCommand* command = Record(RenderCommandIASetIndexBuffer, buffer);
+	command->Args[0] = format;
+	command->Args[1] = offset;
+}
+
+void NullRenderDevice::VSSetShader(ID3D11VertexShader* shader)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandVSSetShader, shader);
+}
+
+void NullRenderDevice::VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandVSSetConstantBuffers, count ? buffers[0] : 0, startSlot, count);
+}
+
+void NullRenderDevice::VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderCommand* command = Record(RenderCommandVSSetConstantBuffers1, count ? buffers[0] : 0, startSlot, count);
+	command->Args[0] = count ? firstConstants[0] : 0;
+	command->Args[1] = count ? constantCounts[0] : 0;
+}
+
+void NullRenderDevice::VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandVSSetShaderResources, count ? views[0] : 0, startSlot, count);
+}
+
+void NullRenderDevice::VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandVSSetSamplers, count ? samplers[0] : 0, startSlot, count);
+}
+
+void NullRenderDevice::PSSetShader(ID3D11PixelShader* shader)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandPSSetShader, shader);
+}
+
+void NullRenderDevice::PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandPSSetConstantBuffers, count ? buffers[0] : 0, startSlot, count);
+}
+
+void NullRenderDevice::PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandPSSetShaderResources, count ? views[0] : 0, startSlot, count);
+}
+
+void NullRenderDevice::PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandPSSetSamplers, count ? samplers[0] : 0, startSlot, count);
+}
+
+// --------------------------------------------------------
+// Drawing and the frame
+// --------------------------------------------------------
+void NullRenderDevice::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderCommand* command = Record(RenderCommandDrawIndexed);
+	command->Args[0] = indexCount;
+	command->Args[1] = startIndex;
+	command->Args[2] = (unsigned int)baseVertex;
+}
+
+void NullRenderDevice::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderCommand* command = Record(RenderCommandDrawIndexedInstanced);
+	command->Args[0] = indexCount;
+	command->Args[1] = instanceCount;
+	command->Args[2] = startIndex;
+	command->Args[3] = (unsigned int)baseVertex;
+	command->Args[4] = startInstance;
+}
+
+void NullRenderDevice::Clear(const float color[4])
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandClear);
+}
+
+void NullRenderDevice::Present()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Record(RenderCommandPresent);
+}
+
+// --------------------------------------------------------
+// Reading the log back
+// --------------------------------------------------------
+unsigned int NullRenderDevice::GetCommandCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (unsigned int)commands.size();
+}
+
+unsigned int NullRenderDevice::GetCommandCount(RenderCommandType type)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int count = 0;
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		if (commands[i].Type == type)
+			count++;
+	}
+	return count;
+}
+
+unsigned int NullRenderDevice::GetContextCommandCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return contextCommandCount;
+}
+
+void NullRenderDevice::ClearCommands()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	commands.clear();
+	contextCommandCount = 0;
+}
+
+unsigned int NullRenderDevice::GetLiveResourceCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return liveResources;
+}
+
+const void* NullRenderDevice::GetBufferData(ID3D11Buffer* buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Resource* resource = FindBuffer(buffer);
+	if (!resource || resource->Data.empty())
+		return 0;
+	return &resource->Data[0];
+}
+
+const char* NullRenderDevice::GetCommandName(RenderCommandType type)
+{
+	static const char* names[RenderCommandTypeCount] =
+	{
+		"CreateBuffer", "CreateVertexShader", "CreatePixelShader", "CreateInputLayout", "Release",
+		"Map", "Unmap", "UpdateBuffer",
+		"IASetInputLayout", "IASetPrimitiveTopology", "IASetVertexBuffers", "IASetIndexBuffer",
+		"VSSetShader", "VSSetConstantBuffers", "VSSetConstantBuffers1", "VSSetShaderResources", "VSSetSamplers",
+		"PSSetShader", "PSSetConstantBuffers", "PSSetShaderResources", "PSSetSamplers",
+		"DrawIndexed", "DrawIndexedInstanced", "Clear", "Present",
+	};
+	return type < RenderCommandTypeCount ? names[type] : "?";
+}
+
+void NullRenderDevice::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int counts[RenderCommandTypeCount] = {};
+	for (size_t i = 0; i < commands.size(); i++)
+		counts[commands[i].Type]++;
+
+	printf("Null device: %u commands (%u bytes), %u live resources\n",
+		(unsigned int)commands.size(), (unsigned int)(commands.size() * sizeof(RenderCommand)), liveResources);
+	for (int t = 0; t < RenderCommandTypeCount; t++)
+	{
+		if (counts[t])
+			printf("  %-24s %8u\n", GetCommandName((RenderCommandType)t), counts[t]);
+	}
+}
+
+// --------------------------------------------------------
+// Appends a command with the common fields filled in; the
+// caller fills in its args
+// --------------------------------------------------------
+RenderCommand* NullRenderDevice::Record(RenderCommandType type, const void* resource, UINT slot, UINT count)
+{
+	RenderCommand command;
+	memset(&command, 0, sizeof(command));
+	command.Type = (unsigned char)type;
+	command.Slot = (unsigned char)slot;
+	command.Count = (unsigned short)count;
+	command.Resource = GetResourceId(resource);
+	commands.push_back(command);
+	if (type > RenderCommandRelease)
+		contextCommandCount++;
+	return &commands.back();
+}
+
+// --------------------------------------------------------
+// Hands out the next id, as a pointer.  Buffers get size
+// bytes of storage, filled from data if there is any.
+// --------------------------------------------------------
+void* NullRenderDevice::CreateResource(RenderCommandType type, const void* data, unsigned int size)
+{
+	Resource resource;
+	resource.CreatedBy = type;
+	resource.Live = true;
+	resource.Data.resize(size);
+	if (data && size > 0)
+		memcpy(&resource.Data[0], data, size);
+
+	resources.push_back(resource);
+	liveResources++;
+	return (void*)(size_t)resources.size();
+}
+
+NullRenderDevice::Resource* NullRenderDevice::FindBuffer(const void* buffer)
+{
+	unsigned int id = GetResourceId(buffer);
+	if (id == 0 || id > resources.size())
+		return 0;
+
+	Resource* resource = &resources[id - 1];
+	if (!resource->Live || resource->CreatedBy != RenderCommandCreateBuffer)
+		return 0;
+	return resource;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "RenderDevice.h"
+
+// The calls NullRenderDevice records, one per RenderDevice method
+enum RenderCommandType
+{
+	RenderCommandCreateBuffer,
+	RenderCommandCreateVertexShader,
+	RenderCommandCreatePixelShader,
+	RenderCommandCreateInputLayout,
+	RenderCommandRelease,
+
+	// Everything after Release goes through the context
+	RenderCommandMap,
+	RenderCommandUnmap,
+	RenderCommandUpdateBuffer,
+	RenderCommandIASetInputLayout,
+	RenderCommandIASetPrimitiveTopology,
+	RenderCommandIASetVertexBuffers,
+	RenderCommandIASetIndexBuffer,
+	RenderCommandVSSetShader,
+	RenderCommandVSSetConstantBuffers,
+	RenderCommandVSSetConstantBuffers1,
+	RenderCommandVSSetShaderResources,
+	RenderCommandVSSetSamplers,
+	RenderCommandPSSetShader,
+	RenderCommandPSSetConstantBuffers,
+	RenderCommandPSSetShaderResources,
+	RenderCommandPSSetSamplers,
+	RenderCommandDrawIndexed,
+	RenderCommandDrawIndexedInstanced,
+	RenderCommandClear,
+	RenderCommandPresent,
+	RenderCommandTypeCount,
+};
+
+// --------------------------------------------------------
+// One recorded call
+//
+// Resources are recorded by id: the order NullRenderDevice
+// created them in, from 1 (0 is "none").  Binds that cover
+// several slots record the first slot, the slot count and
+// the first resource.  Args, by type (unused ones are 0):
+//
+//  CreateBuffer           byte width, bind flags
+//  CreateVertexShader,
+//  CreatePixelShader      bytecode size
+//  CreateInputLayout      element count
+//  Map                    D3D11_MAP type
+//  UpdateBuffer           bytes
+//  IASetPrimitiveTopology topology
+//  IASetVertexBuffers     first stride, first offset
+//  IASetIndexBuffer       format, offset
+//  VSSetConstantBuffers1  first constant, constant count
+//  DrawIndexed            indices, start index, base vertex
+//  DrawIndexedInstanced   indices, instances, start index,
+//                         base vertex, start instance
+// --------------------------------------------------------
+struct RenderCommand
+{
+	unsigned char Type;
+	unsigned char Slot;
+	unsigned short Count;
+	unsigned int Resource;
+	unsigned int Args[5];
+};
+
+// --------------------------------------------------------
+// A RenderDevice with no GPU behind it: every call is
+// appended to a command log, and nothing is drawn
+//
+// Resources are ids dressed up as pointers, never objects -
+// the rest of the code only passes them back in here.
+// Buffers do keep a CPU copy of their contents (initial data,
+// maps and updates all land in it), so what was uploaded can
+// be checked as well as how.
+//
+// The log only grows; clear it once a frame (or whenever)
+// to keep long runs small.
+//
+// Like a D3D11 device, it can be called from more than one
+// thread (every call takes a lock) - the game creates mesh
+// buffers on its update thread while the render thread draws.
+// The counts are safe to read at any time; only walk the log
+// itself while nothing else is calling in.
+// --------------------------------------------------------
+class NullRenderDevice : public RenderDevice
+{
+
+public:
+	// The capabilities to report, so either side of code that
+	// checks them can be run
+	NullRenderDevice(bool canOffsetConstantBuffers = true, bool canMapNoOverwriteConstantBuffers = true);
+	~NullRenderDevice();
+
+	ID3D11Buffer* CreateBuffer(const D3D11_BUFFER_DESC& desc, const void* initialData);
+	ID3D11VertexShader* CreateVertexShader(const void* bytecode, SIZE_T size);
+	ID3D11PixelShader* CreatePixelShader(const void* bytecode, SIZE_T size);
+	ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T size);
+	void Release(ID3D11DeviceChild* resource);
+
+	bool CanOffsetConstantBuffers() { return canOffsetConstantBuffers; }
+	bool CanMapNoOverwriteConstantBuffers() { return canMapNoOverwriteConstantBuffers; }
+
+	void* Map(ID3D11Buffer* buffer, D3D11_MAP mapType);
+	void Unmap(ID3D11Buffer* buffer);
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data);
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+	void VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	void Clear(const float color[4]);
+	void Present();
+
+	// The log, oldest first
+	const RenderCommand* GetCommands() { return commands.empty() ? 0 : &commands[0]; }
+	unsigned int GetCommandCount();
+	unsigned int GetCommandCount(RenderCommandType type);
+	void ClearCommands();
+
+	// Commands other than creating and releasing resources, i.e.
+	// what went through the context.  Resource commands can come
+	// from other threads (a mesh finalizing mid-frame), so these
+	// are the ones that belong to whatever is drawing.
+	unsigned int GetContextCommandCount();
+
+	// A resource's id (as in the log), and a buffer's contents
+	// (0 for anything that isn't a live buffer)
+	static unsigned int GetResourceId(const void* resource) { return (unsigned int)(size_t)resource; }
+	const void* GetBufferData(ID3D11Buffer* buffer);
+	unsigned int GetLiveResourceCount();
+
+	static const char* GetCommandName(RenderCommandType type);
+
+	// How many of each call the log holds
+	void PrintStats();
+
+private:
+	struct Resource
+	{
+		RenderCommandType CreatedBy;
+		bool Live;
+		std::vector<unsigned char> Data;
+	};
+
+	std::mutex mutex;
+	std::vector<RenderCommand> commands;
+	unsigned int contextCommandCount;
+	std::vector<Resource> resources;
+	unsigned int liveResources;
+
+	bool canOffsetConstantBuffers;
+	bool canMapNoOverwriteConstantBuffers;
+
+	RenderCommand* Record(RenderCommandType type, const void* resource = 0, UINT slot = 0, UINT count = 0);
+	void* CreateResource(RenderCommandType type, const void* data, unsigned int size);
+	Resource* FindBuffer(const void* buffer);
+};
@@ -0,0 +1,366 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+#include <climits>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Everything one thread pulls out of its chunk of the file.
+//
+// Relative (negative) face indices can't be resolved until we
+// know how many elements came before this chunk, so they are
+// stored chunk-local, shifted down by RelativeOffset, and fixed
+// up during the merge.
+// --------------------------------------------------------
+struct ObjChunk
+{
+	const char* start;
+	const char* end;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<ObjCorner> corners;
+};
+
+static const int RelativeOffset = 0x40000000;
+
+static inline bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p)) p++;
+	return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n') p++;
+	return p < end ? p + 1 : end;
+}
+
+// --------------------------------------------------------
+// Hand-written float tokenizer.  Handles the formats modeling
+// packages actually write: [-]digits[.digits][e[-]digits]
+// --------------------------------------------------------
+static const char* ParseFloat(const char* p, const char* end, float* out)
+{
+	static const double powersOf10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+		1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+	};
+
+	p = SkipSpaces(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	// Accumulate up to 18 significant digits as an integer,
+	// remembering where the decimal point was
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		if (digits < 18) { mantissa = mantissa * 10 + (*p - '0'); digits++; }
+		else exponent++;
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (digits < 18) { mantissa = mantissa * 10 + (*p - '0'); digits++; exponent--; }
+			p++;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = (*p == '-');
+			p++;
+		}
+		int e = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (e < 1000) e = e * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+
+	double value = (double)mantissa;
+	while (exponent > 18) { value *= 1e18; exponent -= 18; }
+	while (exponent < -18) { value /= 1e18; exponent += 18; }
+	if (exponent >= 0) value *= powersOf10[exponent];
+	else value /= powersOf10[-exponent];
+
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+static const char* ParseInt(const char* p, const char* end, int* out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	int value = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	*out = negative ? -value : value;
+	return p;
+}
+
+// --------------------------------------------------------
+// Converts a 1-based (or negative, relative) OBJ index to our
+// 0-based encoding.  0 is never valid in an OBJ, so it means
+// "missing".  Relative indices may reach back into an earlier
+// chunk, so the chunk-local index can itself be negative.
+// --------------------------------------------------------
+static inline int ResolveIndex(int objIndex, size_t localCount)
+{
+	if (objIndex > 0) return objIndex - 1;
+	if (objIndex < 0) return (int)localCount + objIndex - RelativeOffset;
+	return INT_MIN;
+}
+
+// --------------------------------------------------------
+// Parses one face corner: v, v/t, v//n or v/t/n
+// --------------------------------------------------------
+static const char* ParseCorner(const char* p, const char* end, ObjChunk* chunk, ObjCorner* corner)
+{
+	int v = 0, t = 0, n = 0;
+	p = ParseInt(p, end, &v);
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/')
+			p = ParseInt(p, end, &t);
+		if (p < end && *p == '/')
+		{
+			p++;
+			p = ParseInt(p, end, &n);
+		}
+	}
+
+	corner->Position = ResolveIndex(v, chunk->positions.size());
+	corner->UV = ResolveIndex(t, chunk->uvs.size());
+	corner->Normal = ResolveIndex(n, chunk->normals.size());
+	return p;
+}
+
+static void ParseChunk(ObjChunk* chunk)
+{
+	const char* p = chunk->start;
+	const char* end = chunk->end;
+
+	// Reused between faces so polygons don't allocate
+	std::vector<ObjCorner> face;
+
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end) break;
+
+		if (p[0] == 'v' && p + 1 < end && IsSpace(p[1]))
+		{
+			XMFLOAT3 pos;
+			p = ParseFloat(p + 2, end, &pos.x);
+			p = ParseFloat(p, end, &pos.y);
+			p = ParseFloat(p, end, &pos.z);
+			chunk->positions.push_back(pos);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && IsSpace(p[2]))
+		{
+			XMFLOAT3 norm;
+			p = ParseFloat(p + 3, end, &norm.x);
+			p = ParseFloat(p, end, &norm.y);
+			p = ParseFloat(p, end, &norm.z);
+			chunk->normals.push_back(norm);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && IsSpace(p[2]))
+		{
+			XMFLOAT2 uv;
+			p = ParseFloat(p + 3, end, &uv.x);
+			p = ParseFloat(p, end, &uv.y);
+			chunk->uvs.push_back(uv);
+		}
+		else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+		{
+			face.clear();
+			p += 2;
+			while (true)
+			{
+				p = SkipSpaces(p, end);
+				if (p >= end || *p == '\r' || *p == '\n' || *p == '#')
+					break;
+
+				ObjCorner corner;
+				const char* next = ParseCorner(p, end, chunk, &corner);
+				if (next == p) break; // Not a number - malformed line
+				p = next;
+				face.push_back(corner);
+			}
+
+			// Triangulate as a fan around the first corner
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				chunk->corners.push_back(face[0]);
+				chunk->corners.push_back(face[i - 1]);
+				chunk->corners.push_back(face[i]);
+			}
+		}
+
+		// Anything else (comments, groups, materials, etc.)
+		// and whatever is left of this line is skipped
+		p = SkipLine(p, end);
+	}
+}
+
+// --------------------------------------------------------
+// Turns a chunk-relative index into a file-wide index
+// --------------------------------------------------------
+static inline int FixUpIndex(int index, int base)
+{
+	if (index == INT_MIN) return -1;
+	if (index < 0) return base + index + RelativeOffset;
+	return index;
+}
+
+bool ObjParser::ParseFile(const char* objFile, ObjData* out, JobSystem* jobs)
+{
+	MappedFile file;
+	if (!file.Open(objFile))
+		return false;
+
+	return ParseMemory(file.GetData(), file.GetSize(), out, jobs);
+}
+
+bool ObjParser::ParseMemory(const char* data, size_t size, ObjData* out, JobSystem* jobs)
+{
+	out->Positions.clear();
+	out->Normals.clear();
+	out->UVs.clear();
+	out->Corners.clear();
+	if (size == 0)
+		return true;
+
+	// How many pieces are we splitting the file into?
+	size_t threadCount = jobs ? jobs->GetThreadCount() : 1;
+	size_t maxChunks = size / MinChunkSize + 1;
+	size_t chunkCount = threadCount < maxChunks ? threadCount : maxChunks;
+	if (chunkCount == 0)
+		chunkCount = 1;
+
+	// Split on line boundaries, so no line straddles two chunks
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* start = data;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		const char* chunkEnd = (c == chunkCount - 1) ? end : data + size * (c + 1) / chunkCount;
+		if (chunkEnd < start) chunkEnd = start;
+		chunkEnd = (chunkEnd < end && chunkEnd > data && chunkEnd[-1] != '\n') ? SkipLine(chunkEnd, end) : chunkEnd;
+
+		chunks[c].start = start;
+		chunks[c].end = chunkEnd;
+		start = chunkEnd;
+	}
+
+	// Parse every chunk, on whichever threads are free
+	if (jobs && chunkCount > 1)
+	{
+		jobs->ParallelFor(0, (unsigned int)chunkCount, [&chunks](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int c = begin; c < end; c++)
+				ParseChunk(&chunks[c]);
+		});
+	}
+	else
+	{
+		for (size_t c = 0; c < chunkCount; c++)
+			ParseChunk(&chunks[c]);
+	}
+
+	// Size the output once, then stitch the chunks together
+	size_t positionCount = 0, normalCount = 0, uvCount = 0, cornerCount = 0;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		positionCount += chunks[c].positions.size();
+		normalCount += chunks[c].normals.size();
+		uvCount += chunks[c].uvs.size();
+		cornerCount += chunks[c].corners.size();
+	}
+	out->Positions.reserve(positionCount);
+	out->Normals.reserve(normalCount);
+	out->UVs.reserve(uvCount);
+	out->Corners.reserve(cornerCount);
+
+	int positionBase = 0, normalBase = 0, uvBase = 0;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		ObjChunk& chunk = chunks[c];
+		out->Positions.insert(out->Positions.end(), chunk.positions.begin(), chunk.positions.end());
+		out->Normals.insert(out->Normals.end(), chunk.normals.begin(), chunk.normals.end());
+		out->UVs.insert(out->UVs.end(), chunk.uvs.begin(), chunk.uvs.end());
+
+		for (size_t i = 0; i < chunk.corners.size(); i++)
+		{
+			ObjCorner corner = chunk.corners[i];
+			corner.Position = FixUpIndex(corner.Position, positionBase);
+			corner.UV = FixUpIndex(corner.UV, uvBase);
+			corner.Normal = FixUpIndex(corner.Normal, normalBase);
+			out->Corners.push_back(corner);
+		}
+
+		positionBase += (int)chunk.positions.size();
+		normalBase += (int)chunk.normals.size();
+		uvBase += (int)chunk.uvs.size();
+	}
+
+	// Drop any corners that point outside the file's data
+	// rather than letting them crash whoever uses them
+	size_t valid = 0;
+	for (size_t i = 0; i + 2 < out->Corners.size(); i += 3)
+	{
+		bool ok = true;
+		for (size_t k = 0; k < 3; k++)
+		{
+			const ObjCorner& corner = out->Corners[i + k];
+			ok = ok &&
+				corner.Position >= 0 && corner.Position < (int)positionCount &&
+				corner.UV >= -1 && corner.UV < (int)uvCount &&
+				corner.Normal >= -1 && corner.Normal < (int)normalCount;
+		}
+		if (!ok) continue;
+
+		out->Corners[valid++] = out->Corners[i];
+		out->Corners[valid++] = out->Corners[i + 1];
+		out->Corners[valid++] = out->Corners[i + 2];
+	}
+	out->Corners.resize(valid);
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// A single face corner from an OBJ file.  Indices are
+// already converted to 0-based; -1 means "not present"
+// (e.g. "f 1//3" has no UV).
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+};
+
+// --------------------------------------------------------
+// Raw OBJ data, exactly as it appears in the file.
+// Faces are triangulated as fans, so every 3 corners
+// make one triangle (in the file's original winding).
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<DirectX::XMFLOAT2> UVs;
+	std::vector<ObjCorner> Corners;
+};
+
+// --------------------------------------------------------
+// Fast OBJ parser
+//
+// The file is memory-mapped and split into line-aligned
+// chunks, each of which is tokenized as a job of its own.
+// The per-chunk arrays are then stitched back together.
+// --------------------------------------------------------
+class ObjParser
+{
+
+public:
+	// jobs - splits the file across its threads; 0 parses it all
+	// on the calling thread.  Safe to call from inside a job.
+	static bool ParseFile(const char* objFile, ObjData* out, JobSystem* jobs = 0);
+	static bool ParseMemory(const char* data, size_t size, ObjData* out, JobSystem* jobs = 0);
+
+	// Chunks smaller than this aren't worth a job
+	static const size_t MinChunkSize = 256 * 1024;
+};
@@ -6,12 +6,18 @@ struct DirectionalLight
 	float3 Direction;
 };
 
-cbuffer externalData : register(b0)
+// Split by how often they change, like the vertex shaders'
+cbuffer perFrame : register(b0)
 {
 	DirectionalLight light_1;
 	DirectionalLight light_2;
 };
 
+cbuffer perMaterial : register(b1)
+{
+	float4 surfaceColor;
+};
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -58,6 +64,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 direction_2 = normalize(-light_2.Direction);
 	float4 amount_2 = saturate(dot(input.normal, direction_2));
 
-	return (amount_1 * light_1.DiffuseColor + light_1.AmbientColor) + (amount_2 * light_2.DiffuseColor + light_2.AmbientColor);
+	float4 lighting = (amount_1 * light_1.DiffuseColor + light_1.AmbientColor) + (amount_2 * light_2.DiffuseColor + light_2.AmbientColor);
+	return lighting * surfaceColor;
 
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Every GPU call the game makes - creating buffers and
+// shaders, uploads, binds, draws and the frame itself - behind
+// one interface, so they can go somewhere other than a GPU
+//
+// D3D11RenderDevice passes them to a D3D11 device and
+// context.  NullRenderDevice records them instead, so whole
+// frames run (and can be profiled or checked) without one.
+//
+// Resources are still D3D11 interface pointers, but only as
+// handles: nothing outside a RenderDevice calls methods on
+// them, and they are freed with Release() here, not their own.
+// Bind calls usually come through a StateCache rather than
+// straight here.
+// --------------------------------------------------------
+class RenderDevice
+{
+
+public:
+	virtual ~RenderDevice() {}
+
+	// Resources - each returns 0 if it couldn't be created
+	virtual ID3D11Buffer* CreateBuffer(const D3D11_BUFFER_DESC& desc, const void* initialData) = 0;
+	virtual ID3D11VertexShader* CreateVertexShader(const void* bytecode, SIZE_T size) = 0;
+	virtual ID3D11PixelShader* CreatePixelShader(const void* bytecode, SIZE_T size) = 0;
+	virtual ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T size) = 0;
+	virtual void Release(ID3D11DeviceChild* resource) = 0;	// Ignores 0
+
+	// D3D11.1 constant buffer offsets (VSSetConstantBuffers1), and
+	// NO_OVERWRITE maps of dynamic constant buffers
+	virtual bool CanOffsetConstantBuffers() = 0;
+	virtual bool CanMapNoOverwriteConstantBuffers() = 0;
+
+	// Uploads.  Map() returns where to write, or 0 if it failed;
+	// UpdateBuffer() replaces a whole (non-dynamic) buffer.
+	virtual void* Map(ID3D11Buffer* buffer, D3D11_MAP mapType) = 0;
+	virtual void Unmap(ID3D11Buffer* buffer) = 0;
+	virtual void UpdateBuffer(ID3D11Buffer* buffer, const void* data) = 0;
+
+	// Pipeline state
+	virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+	virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+
+	virtual void VSSetShader(ID3D11VertexShader* shader) = 0;
+	virtual void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+	virtual void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) = 0;
+	virtual void VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+
+	virtual void PSSetShader(ID3D11PixelShader* shader) = 0;
+	virtual void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+	virtual void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+
+	// Drawing
+	virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+
+	// The frame: clear the back buffer (and depth), then show it
+	virtual void Clear(const float color[4]) = 0;
+	virtual void Present() = 0;
+};
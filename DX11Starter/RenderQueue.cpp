@@ -0,0 +1,113 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+RenderQueue::RenderQueue()
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::Clear()
+{
+	keys.clear();
+	values.clear();
+}
+
+void RenderQueue::Add(unsigned long long key, unsigned int value)
+{
+	keys.push_back(key);
+	values.push_back(value);
+}
+
+unsigned long long RenderQueue::MakeKey(Material* material, Mesh* mesh, float viewDepth)
+{
+	unsigned int shaders =
+		(GetId(shaderIds, material->GetVertexShader()) & 0xFF) << 8 |
+		(GetId(shaderIds, material->GetPixelShader()) & 0xFF);
+	return PackKey(shaders, GetId(materialIds, material), GetId(meshIds, mesh), viewDepth);
+}
+
+// --------------------------------------------------------
+// Positive floats sort the same way as their bit patterns,
+// so the depth bits are just the top 24 bits of the float
+// (below the sign).  Anything behind the camera counts as 0.
+// --------------------------------------------------------
+unsigned long long RenderQueue::PackKey(unsigned int shaders, unsigned int material, unsigned int mesh, float viewDepth)
+{
+	unsigned int depthBits = 0;
+	if (viewDepth > 0.0f)
+	{
+		memcpy(&depthBits, &viewDepth, sizeof(float));
+		depthBits >>= 7;
+	}
+
+	return
+		(unsigned long long)(shaders & 0xFFFF) << ShaderShift |
+		(unsigned long long)(material & 0xFFF) << MaterialShift |
+		(unsigned long long)(mesh & 0xFFF) << MeshShift |
+		(depthBits & DepthMask);
+}
+
+// --------------------------------------------------------
+// All eight byte histograms are counted in one read of the
+// keys, then each pass scatters into the other buffer.  A
+// pass where one bucket holds every key would not move
+// anything, so it's skipped.
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	size_t count = keys.size();
+	if (count < 2)
+		return;
+
+	unsigned int histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = keys[i];
+		for (int pass = 0; pass < 8; pass++)
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	scratchKeys.resize(count);
+	scratchValues.resize(count);
+	for (int pass = 0; pass < 8; pass++)
+	{
+		unsigned int* histogram = histograms[pass];
+		int shift = pass * 8;
+		if (histogram[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		// Counts to starting offsets
+		unsigned int offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			unsigned int bucketCount = histogram[b];
+			histogram[b] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int to = histogram[(keys[i] >> shift) & 0xFF]++;
+			scratchKeys[to] = keys[i];
+			scratchValues[to] = values[i];
+		}
+		keys.swap(scratchKeys);
+		values.swap(scratchValues);
+	}
+}
+
+unsigned int RenderQueue::GetId(std::unordered_map<const void*, unsigned int>& ids, const void* object)
+{
+	std::unordered_map<const void*, unsigned int>::iterator it = ids.find(object);
+	if (it != ids.end())
+		return it->second;
+
+	unsigned int id = (unsigned int)ids.size();
+	ids[object] = id;
+	return id;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "Material.h"
+
+// --------------------------------------------------------
+// Orders draws so that expensive state changes happen as
+// rarely as possible
+//
+// Every draw gets a 64-bit key, most significant bits first:
+//
+//   63-48  shaders   (vertex shader id, pixel shader id)
+//   47-36  material
+//   35-24  mesh
+//   23-0   depth     (front to back)
+//
+// so sorting the keys puts everything that shares shaders
+// together, then everything that shares a material within
+// that, and so on.  Ids are handed out the first time each
+// shader/material/mesh is seen and kept from then on, so the
+// order is stable from one frame to the next.  (Past 256
+// shaders, 4096 materials or 4096 meshes the ids wrap around:
+// the order gets worse, but nothing breaks.)
+//
+// Sort() is an LSD radix sort, one byte per pass, which skips
+// any pass where every key has the same byte - usually most of
+// the high ones, since scenes have few shaders.
+// --------------------------------------------------------
+class RenderQueue
+{
+
+public:
+	static const int ShaderShift = 48;
+	static const int MaterialShift = 36;
+	static const int MeshShift = 24;
+	static const unsigned long long DepthMask = 0xFFFFFF;
+
+	RenderQueue();
+	~RenderQueue();
+
+	void Clear();
+	void Add(unsigned long long key, unsigned int value);
+	void Sort();
+
+	// viewDepth - distance in front of the camera
+	unsigned long long MakeKey(Material* material, Mesh* mesh, float viewDepth);
+	static unsigned long long PackKey(unsigned int shaders, unsigned int material, unsigned int mesh, float viewDepth);
+
+	// Sorted by key after Sort()
+	unsigned int GetCount() { return (unsigned int)keys.size(); }
+	const unsigned long long* GetKeys() { return keys.empty() ? 0 : &keys[0]; }
+	const unsigned int* GetValues() { return values.empty() ? 0 : &values[0]; }
+
+private:
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> values;
+	std::vector<unsigned long long> scratchKeys;
+	std::vector<unsigned int> scratchValues;
+
+	std::unordered_map<const void*, unsigned int> shaderIds;
+	std::unordered_map<const void*, unsigned int> materialIds;
+	std::unordered_map<const void*, unsigned int> meshIds;
+
+	static unsigned int GetId(std::unordered_map<const void*, unsigned int>& ids, const void* object);
+};
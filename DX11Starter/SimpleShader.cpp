@@ -1,9 +1,15 @@
 #include "SimpleShader.h"
 
+#include <cstdio>
+
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+unsigned int ISimpleShader::uploadCount = 0;
+unsigned int ISimpleShader::uploadsSkipped = 0;
+unsigned int ISimpleShader::bytesUploaded = 0;
+
 // --------------------------------------------------------
 // Constructor accepts DirectX device & context
 // --------------------------------------------------------
@@ -12,6 +18,8 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	// Save the device
 	this->device = device;
 	this->deviceContext = context;
+	this->renderDevice = 0;
+	this->stateCache = 0;
 
 	// Set up fields
 	constantBufferCount = 0;
@@ -19,6 +27,22 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	shaderBlob = 0;
 }
 
+// --------------------------------------------------------
+// Constructor for shaders whose GPU calls go through a
+// RenderDevice (which may not have a GPU behind it)
+// --------------------------------------------------------
+ISimpleShader::ISimpleShader(RenderDevice* device)
+{
+	this->device = 0;
+	this->deviceContext = 0;
+	this->renderDevice = device;
+	this->stateCache = 0;
+
+	constantBufferCount = 0;
+	constantBuffers = 0;
+	shaderBlob = 0;
+}
+
 // --------------------------------------------------------
 // Destructor
 // --------------------------------------------------------
@@ -38,7 +62,7 @@ void ISimpleShader::CleanUp()
 	// Handle constant buffers and local data buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		constantBuffers[i].ConstantBuffer->Release();
+		ReleaseResource(constantBuffers[i].ConstantBuffer);
 		delete[] constantBuffers[i].LocalDataBuffer;
 	}
 
@@ -55,7 +79,9 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
+	variables.clear();
 	varTable.clear();
+	varHashTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
 	textureTable.clear();
@@ -165,18 +191,16 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].Name = bufferDesc.Name;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc;
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = max(bufferDesc.Size, 16); // NEW: Must be multiple of 16
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
+		// Create this constant buffer.  Every field is set first,
+		// so they're all valid even if creation fails.  It starts
+		// dirty, since the GPU copy hasn't been filled in.
+		constantBuffers[b].Size = bufferDesc.Size;
+		constantBuffers[b].ConstantBuffer = 0;
+		constantBuffers[b].Dynamic = false;
+		constantBuffers[b].Dirty = true;
+		CreateConstantBuffer(&constantBuffers[b], false);
 
 		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
@@ -200,9 +224,18 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			// Get a string version
 			std::string varName(varDesc.Name);
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			// Add this variable to the flat array (its index is
+			// its handle), the tables and the constant buffer
+			SimpleShaderHandle handle = (SimpleShaderHandle)variables.size();
+			variables.push_back(varStruct);
+			varTable.insert(std::pair<std::string, SimpleShaderHandle>(varName, handle));
 			constantBuffers[b].Variables.push_back(varStruct);
+
+			// Two names with the same hash can't be told apart, so
+			// neither can be found by hash
+			unsigned int hash = SimpleShaderName(varDesc.Name).Hash;
+			if (!varHashTable.insert(std::pair<unsigned int, SimpleShaderHandle>(hash, handle)).second)
+				varHashTable[hash] = SimpleShaderInvalidHandle;
 		}
 	}
 
@@ -221,15 +254,30 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	std::unordered_map<std::string, SimpleShaderHandle>::iterator result =
 		varTable.find(name);
 
 	// Did we find the key?
 	if (result == varTable.end())
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	return FindVariable(result->second, size);
+}
+
+// --------------------------------------------------------
+// Helper for looking up a variable by handle and also
+// verifying that it is the requested size
+//
+// handle - the variable's handle (from GetVariableHandle)
+// size - the size of the variable (for verification), or -1 to bypass
+// --------------------------------------------------------
+SimpleShaderVariable* ISimpleShader::FindVariable(SimpleShaderHandle handle, int size)
+{
+	// Is the handle in range?
+	if (handle < 0 || handle >= (SimpleShaderHandle)variables.size())
+		return 0;
+
+	SimpleShaderVariable* var = &variables[handle];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -256,6 +304,109 @@ SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 	return result->second;
 }
 
+// --------------------------------------------------------
+// Helper for (re)creating a constant buffer's GPU copy.
+// Dynamic buffers can be mapped by the CPU; default ones
+// are updated with UpdateSubresource.
+//
+// On failure the buffer is left exactly as it was
+// --------------------------------------------------------
+bool ISimpleShader::CreateConstantBuffer(SimpleConstantBuffer* cb, bool dynamic)
+{
+	D3D11_BUFFER_DESC newBuffDesc;
+	newBuffDesc.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	newBuffDesc.ByteWidth = max(cb->Size, 16); // NEW: Must be multiple of 16
+	newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	newBuffDesc.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	newBuffDesc.MiscFlags = 0;
+	newBuffDesc.StructureByteStride = 0;
+
+	ID3D11Buffer* buffer = 0;
+	if (renderDevice)
+		buffer = renderDevice->CreateBuffer(newBuffDesc, 0);
+	else if (FAILED(device->CreateBuffer(&newBuffDesc, 0, &buffer)))
+		buffer = 0;
+	if (!buffer)
+		return false;
+
+	ReleaseResource(cb->ConstantBuffer);
+	cb->ConstantBuffer = buffer;
+	cb->Dynamic = dynamic;
+	cb->Dirty = true;
+	return true;
+}
+
+// --------------------------------------------------------
+// Helper for copying a buffer's local data to the GPU, if it
+// has changed since the last time
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	if (!cb->Dirty)
+	{
+		uploadsSkipped++;
+		return;
+	}
+
+	// Creation failed - nothing to upload to
+	if (!cb->ConstantBuffer)
+		return;
+
+	if (renderDevice)
+	{
+		if (cb->Dynamic)
+		{
+			void* mapped = renderDevice->Map(cb->ConstantBuffer, D3D11_MAP_WRITE_DISCARD);
+			if (!mapped)
+				return;
+			memcpy(mapped, cb->LocalDataBuffer, cb->Size);
+			renderDevice->Unmap(cb->ConstantBuffer);
+		}
+		else
+		{
+			renderDevice->UpdateBuffer(cb->ConstantBuffer, cb->LocalDataBuffer);
+		}
+	}
+	else if (cb->Dynamic)
+	{
+		// The whole buffer is replaced, so the driver can hand
+		// back fresh memory instead of waiting on the GPU
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(deviceContext->Map(cb->ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		memcpy(mapped.pData, cb->LocalDataBuffer, cb->Size);
+		deviceContext->Unmap(cb->ConstantBuffer, 0);
+	}
+	else
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer, 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+	}
+
+	cb->Dirty = false;
+	uploadCount++;
+	bytesUploaded += cb->Size;
+}
+
+void ISimpleShader::ReleaseResource(ID3D11DeviceChild* resource)
+{
+	if (!resource)
+		return;
+
+	if (renderDevice)
+		renderDevice->Release(resource);
+	else
+		resource->Release();
+}
+
+void ISimpleShader::ResetUploadCounters()
+{
+	uploadCount = 0;
+	uploadsSkipped = 0;
+	bytesUploaded = 0;
+}
+
 // --------------------------------------------------------
 // Sets the shader and associated constant buffers in DirectX
 // --------------------------------------------------------
@@ -273,20 +424,18 @@ void ISimpleShader::SetShader()
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
 // buffer, use CopyBufferData()
+//
+// Buffers that haven't changed since they were last
+// copied are skipped.
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any changes
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		UploadBuffer(&constantBuffers[i]);
 }
 
 // --------------------------------------------------------
@@ -313,10 +462,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -335,10 +482,39 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Switches a constant buffer between a dynamic buffer
+// (uploaded with Map/WRITE_DISCARD - best for data that
+// changes several times a frame) and a default one
+// (uploaded with UpdateSubresource)
+//
+// Returns false if the buffer doesn't exist or couldn't
+// be recreated
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferDynamic(unsigned int index, bool dynamic)
+{
+	if (!shaderValid || index >= constantBufferCount)
+		return false;
+
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->Dynamic == dynamic)
+		return true;
+
+	// The new buffer replaces the bound one, so it has to be
+	// bound again before the next draw
+	return CreateConstantBuffer(cb, dynamic);
+}
+
+bool ISimpleShader::SetBufferDynamic(std::string bufferName, bool dynamic)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (!cb) return false;
+
+	return SetBufferDynamic((unsigned int)(cb - constantBuffers), dynamic);
 }
 
 
@@ -359,11 +535,36 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 	if (var == 0)
 		return false;
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	return WriteVariable(var, data);
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the
+// specified size - same as above, minus the name lookup
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	SimpleShaderVariable* var = FindVariable(handle, size);
+	if (var == 0)
+		return false;
+
+	return WriteVariable(var, data);
+}
+
+// --------------------------------------------------------
+// Helper for copying a variable's data into its local data
+// buffer, marking the buffer for upload only if something
+// actually changed
+// --------------------------------------------------------
+bool ISimpleShader::WriteVariable(const SimpleShaderVariable* var, const void* data)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* dest = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(dest, data, var->Size) != 0)
+	{
+		memcpy(dest, data, var->Size);
+		cb->Dirty = true;
+	}
 
 	// Success
 	return true;
@@ -449,6 +650,72 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Handle versions of the setters above
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(SimpleShaderHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleShaderHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Gets a variable's handle by name, for the handle setters
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	std::unordered_map<std::string, SimpleShaderHandle>::iterator result =
+		varTable.find(name);
+	return result == varTable.end() ? SimpleShaderInvalidHandle : result->second;
+}
+
+// --------------------------------------------------------
+// Gets a variable's handle by its hashed name
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(SimpleShaderName name)
+{
+	std::unordered_map<unsigned int, SimpleShaderHandle>::iterator result =
+		varHashTable.find(name.Hash);
+	SimpleShaderHandle handle = result == varHashTable.end() ? SimpleShaderInvalidHandle : result->second;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// The hash alone can't tell a missing name from one that
+	// collides with a variable's, so check the name itself
+	SimpleShaderHandle byName = GetVariableHandle(std::string(name.Name));
+	if (handle != byName)
+	{
+		printf("Shader variable \"%s\" hashes the same as another name - look it up by string instead\n", name.Name);
+		handle = byName;
+	}
+#endif
+
+	return handle;
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
@@ -607,6 +874,17 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContex
 	this->perInstanceCompatible = perInstanceCompatible;
 }
 
+// --------------------------------------------------------
+// Constructor for going through a RenderDevice
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(RenderDevice* device)
+	: ISimpleShader(device)
+{
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -621,8 +899,10 @@ SimpleVertexShader::~SimpleVertexShader()
 void SimpleVertexShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-	if (inputLayout) { inputLayout->Release(); inputLayout = 0; }
+	ReleaseResource(shader);
+	ReleaseResource(inputLayout);
+	shader = 0;
+	inputLayout = 0;
 }
 
 // --------------------------------------------------------
@@ -639,15 +919,26 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 	this->CleanUp();
 
 	// Create the shader from the blob
-	HRESULT result = device->CreateVertexShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Did the creation work?
-	if (result != S_OK)
-		return false;
+	if (renderDevice)
+	{
+		shader = renderDevice->CreateVertexShader(
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize());
+		if (!shader)
+			return false;
+	}
+	else
+	{
+		HRESULT result = device->CreateVertexShader(
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize(),
+			0,
+			&shader);
+
+		// Did the creation work?
+		if (result != S_OK)
+			return false;
+	}
 
 	// Do we already have an input layout?
 	// (This would come from one of the constructor overloads)
@@ -731,23 +1022,77 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 		}
 
+		// Packed attributes: a semantic ending in "_UNORM", "_SNORM"
+		// or "_HALF" reads 16-bit data from the buffer, which the
+		// input assembler expands to floats for the shader
+		// (no digits in the suffix - HLSL would take those as the
+		// semantic index)
+		DXGI_FORMAT packedFormat = GetPackedInputFormat(sem, paramDesc.Mask);
+		if (packedFormat != DXGI_FORMAT_UNKNOWN)
+			elementDesc.Format = packedFormat;
+
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
 	// Try to create Input Layout
-	HRESULT hr = device->CreateInputLayout(
-		&inputLayoutDesc[0], 
-		(unsigned int)inputLayoutDesc.size(), 
-		shaderBlob->GetBufferPointer(), 
-		shaderBlob->GetBufferSize(),
-		&inputLayout);
+	if (renderDevice)
+	{
+		inputLayout = renderDevice->CreateInputLayout(
+			&inputLayoutDesc[0],
+			(unsigned int)inputLayoutDesc.size(),
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize());
+	}
+	else
+	{
+		device->CreateInputLayout(
+			&inputLayoutDesc[0], 
+			(unsigned int)inputLayoutDesc.size(), 
+			shaderBlob->GetBufferPointer(), 
+			shaderBlob->GetBufferSize(),
+			&inputLayout);
+	}
 
 	// All done, clean up
 	refl->Release();
 	return true;
 }
 
+// --------------------------------------------------------
+// Determines the 16-bit format for a packed input, based on
+// its semantic name's suffix and how many components it has
+//
+// Returns DXGI_FORMAT_UNKNOWN if the input isn't packed
+// --------------------------------------------------------
+DXGI_FORMAT SimpleVertexShader::GetPackedInputFormat(std::string semanticName, unsigned int mask)
+{
+	static const char* suffixes[] = { "_UNORM", "_SNORM", "_HALF" };
+
+	// There are no 3-component 16-bit formats, so 3 components read
+	// 4 from the buffer (the shader just ignores the last one)
+	static const DXGI_FORMAT formats[3][3] =
+	{
+		{ DXGI_FORMAT_R16_UNORM, DXGI_FORMAT_R16G16_UNORM, DXGI_FORMAT_R16G16B16A16_UNORM },
+		{ DXGI_FORMAT_R16_SNORM, DXGI_FORMAT_R16G16_SNORM, DXGI_FORMAT_R16G16B16A16_SNORM },
+		{ DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_R16G16B16A16_FLOAT },
+	};
+
+	for (int i = 0; i < 3; i++)
+	{
+		std::string suffix = suffixes[i];
+		int lenDiff = (int)semanticName.size() - (int)suffix.size();
+		if (lenDiff < 0 || semanticName.compare(lenDiff, suffix.size(), suffix) != 0)
+			continue;
+
+		if (mask == 1) return formats[i][0];
+		else if (mask <= 3) return formats[i][1];
+		else return formats[i][2];
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
 // --------------------------------------------------------
 // Sets the vertex shader, input layout and constant buffers
 // for future DirectX drawing
@@ -758,8 +1103,21 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	if (stateCache)
+	{
+		stateCache->IASetInputLayout(inputLayout);
+		stateCache->VSSetShader(shader);
+	}
+	else if (renderDevice)
+	{
+		renderDevice->IASetInputLayout(inputLayout);
+		renderDevice->VSSetShader(shader);
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout);
+		deviceContext->VSSetShader(shader, 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -769,6 +1127,23 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		if (stateCache)
+		{
+			stateCache->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
+			continue;
+		}
+		if (renderDevice)
+		{
+			renderDevice->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
+			continue;
+		}
+
 		deviceContext->VSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -792,7 +1167,12 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else if (renderDevice)
+		renderDevice->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -814,7 +1194,12 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else if (renderDevice)
+		renderDevice->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -834,6 +1219,15 @@ SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext*
 	this->shader = 0;
 }
 
+// --------------------------------------------------------
+// Constructor for going through a RenderDevice
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(RenderDevice* device)
+	: ISimpleShader(device)
+{
+	this->shader = 0;
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -848,7 +1242,8 @@ SimplePixelShader::~SimplePixelShader()
 void SimplePixelShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
+	ReleaseResource(shader);
+	shader = 0;
 }
 
 // --------------------------------------------------------
@@ -865,6 +1260,14 @@ bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob)
 	this->CleanUp();
 
 	// Create the shader from the blob
+	if (renderDevice)
+	{
+		shader = renderDevice->CreatePixelShader(
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize());
+		return shader != 0;
+	}
+
 	HRESULT result = device->CreatePixelShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
@@ -885,7 +1288,12 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	if (stateCache)
+		stateCache->PSSetShader(shader);
+	else if (renderDevice)
+		renderDevice->PSSetShader(shader);
+	else
+		deviceContext->PSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -895,6 +1303,23 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		if (stateCache)
+		{
+			stateCache->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
+			continue;
+		}
+		if (renderDevice)
+		{
+			renderDevice->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
+			continue;
+		}
+
 		deviceContext->PSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -918,7 +1343,12 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else if (renderDevice)
+		renderDevice->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -940,7 +1370,12 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else if (renderDevice)
+		renderDevice->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
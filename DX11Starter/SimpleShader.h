@@ -10,6 +10,9 @@
 #include <vector>
 #include <string>
 
+#include "RenderDevice.h"
+#include "StateCache.h"
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -21,6 +24,37 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// Resolved index of a variable in one shader - see
+// ISimpleShader::GetVariableHandle()
+// --------------------------------------------------------
+typedef int SimpleShaderHandle;
+static const SimpleShaderHandle SimpleShaderInvalidHandle = -1;
+
+// --------------------------------------------------------
+// A variable name hashed (FNV-1a) at compile time, for
+// looking up handles without building a std::string:
+//
+//   static constexpr SimpleShaderName worldName("world");
+//   SimpleShaderHandle world = vs->GetVariableHandle(worldName);
+//
+// Only the hash is compared, so a name the shader doesn't
+// have could still find a variable whose name hashes the
+// same.  Debug builds check the name itself as well.
+// --------------------------------------------------------
+struct SimpleShaderName
+{
+	unsigned int Hash;
+	const char* Name;
+
+	constexpr explicit SimpleShaderName(const char* name) : Hash(HashString(name, 2166136261u)), Name(name) {}
+
+	static constexpr unsigned int HashString(const char* name, unsigned int hash)
+	{
+		return *name ? HashString(name + 1, (hash ^ (unsigned char)*name) * 16777619u) : hash;
+	}
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -35,6 +69,8 @@ struct SimpleConstantBuffer
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+	bool Dirty;		// LocalDataBuffer has changed since the last upload
+	bool Dynamic;	// Uploaded with Map/WRITE_DISCARD instead of UpdateSubresource
 };
 
 // --------------------------------------------------------
@@ -62,6 +98,10 @@ class ISimpleShader
 {
 public:
 	ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// Creates, uploads and binds through a RenderDevice instead
+	// of a D3D11 device and context (vertex and pixel shaders only)
+	ISimpleShader(RenderDevice* device);
 	virtual ~ISimpleShader();
 
 	// Initialization method (since we can't invoke derived class
@@ -71,12 +111,29 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
+	// Binds through the cache (which skips anything already
+	// bound) instead of straight to the context.  Only vertex
+	// and pixel shaders use it; 0 turns it off.
+	void SetStateCache(StateCache* cache) { stateCache = cache; }
+
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Frequently changing buffers (like per-object data) are
+	// cheaper to upload as dynamic buffers
+	bool SetBufferDynamic(unsigned int index, bool dynamic);
+	bool SetBufferDynamic(std::string bufferName, bool dynamic);
+
+	// Uploads made and skipped (buffer hadn't changed) by every
+	// shader since the last reset - reset once a frame
+	static unsigned int GetUploadCount() { return uploadCount; }
+	static unsigned int GetUploadsSkipped() { return uploadsSkipped; }
+	static unsigned int GetBytesUploaded() { return bytesUploaded; }
+	static void ResetUploadCounters();
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -91,6 +148,22 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Resolve a name once, then set by handle - no string is built
+	// or hashed per call.  Handles only work with the shader that
+	// gave them out.  Returns SimpleShaderInvalidHandle if there's
+	// no such variable.
+	SimpleShaderHandle GetVariableHandle(std::string name);
+	SimpleShaderHandle GetVariableHandle(SimpleShaderName name);
+
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderHandle handle, int data);
+	bool SetFloat(SimpleShaderHandle handle, float data);
+	bool SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
 	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
@@ -121,6 +194,8 @@ protected:
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+	RenderDevice* renderDevice;
+	StateCache* stateCache;
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -130,7 +205,9 @@ protected:
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::vector<SimpleShaderVariable> variables;			 // Handles index this
+	std::unordered_map<std::string, SimpleShaderHandle> varTable;
+	std::unordered_map<unsigned int, SimpleShaderHandle> varHashTable;
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
@@ -142,7 +219,20 @@ protected:
 
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
+	SimpleShaderVariable* FindVariable(SimpleShaderHandle handle, int size);
+	bool WriteVariable(const SimpleShaderVariable* var, const void* data);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+
+	// Helpers for constant buffer uploads
+	bool CreateConstantBuffer(SimpleConstantBuffer* cb, bool dynamic);
+	void UploadBuffer(SimpleConstantBuffer* cb);
+
+	// Releases through the RenderDevice, if there is one
+	void ReleaseResource(ID3D11DeviceChild* resource);
+
+	static unsigned int uploadCount;
+	static unsigned int uploadsSkipped;
+	static unsigned int bytesUploaded;
 };
 
 // --------------------------------------------------------
@@ -153,6 +243,7 @@ class SimpleVertexShader : public ISimpleShader
 public:
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context);
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader(RenderDevice* device);
 	~SimpleVertexShader();
 	ID3D11VertexShader* GetDirectXShader() { return shader; }
 	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
@@ -166,6 +257,7 @@ protected:
 	ID3D11InputLayout* inputLayout;
 	ID3D11VertexShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
+	DXGI_FORMAT GetPackedInputFormat(std::string semanticName, unsigned int mask);
 	void SetShaderAndCBs();
 	void CleanUp();
 };
@@ -178,6 +270,7 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context);
+	SimplePixelShader(RenderDevice* device);
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
@@ -0,0 +1,519 @@
+#include "SoftwareRasterizer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+static double Now()
+{
+	return std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned int width, unsigned int height, JobSystem* jobs)
+{
+	this->width = width;
+	this->height = height;
+	this->jobs = jobs;
+	pitch = (width + 3) & ~3u;
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+
+	colorBuffer.resize(pitch * height);
+	depthBuffer.resize(pitch * height);
+	bins.resize(tilesX * tilesY);
+	tilePixels.resize(tilesX * tilesY);
+
+	// No light until SetLights()
+	DirectionalLight none = { XMFLOAT4(0, 0, 0, 0), XMFLOAT4(0, 0, 0, 0), XMFLOAT3(0, 0, 1) };
+	SetLights(none, none);
+
+	const float black[4] = { 0, 0, 0, 0 };
+	Clear(black);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+}
+
+void SoftwareRasterizer::SetLights(const DirectionalLight& light1, const DirectionalLight& light2)
+{
+	const DirectionalLight* lights[2] = { &light1, &light2 };
+	for (int i = 0; i < 2; i++)
+	{
+		XMVECTOR direction = XMVector3Normalize(XMVectorNegate(XMLoadFloat3(&lights[i]->Direction)));
+		XMStoreFloat3(&lightDirections[i], direction);
+		lightDiffuse[i] = lights[i]->DiffuseColor;
+	}
+
+	ambient = XMFLOAT4(
+		light1.AmbientColor.x + light2.AmbientColor.x,
+		light1.AmbientColor.y + light2.AmbientColor.y,
+		light1.AmbientColor.z + light2.AmbientColor.z,
+		light1.AmbientColor.w + light2.AmbientColor.w);
+}
+
+void SoftwareRasterizer::Clear(const float color[4])
+{
+	unsigned int packed = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		float value = color[c] < 0.0f ? 0.0f : (color[c] > 1.0f ? 1.0f : color[c]);
+		packed |= (unsigned int)(value * 255.0f + 0.5f) << (c * 8);
+	}
+
+	for (size_t i = 0; i < colorBuffer.size(); i++)
+	{
+		colorBuffer[i] = packed;
+		depthBuffer[i] = 1.0f;
+	}
+
+	triangles.clear();
+	for (size_t t = 0; t < bins.size(); t++)
+		bins[t].clear();
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+// --------------------------------------------------------
+// The vertex shader, then clipping and setup
+//
+// Triangles entirely outside any one plane are dropped
+// straight away.  Ones that cross the near or far plane are
+// clipped to it (those are the only planes D3D really clips
+// against); everything else is left for the pixel bounds and
+// edge functions to trim.
+// --------------------------------------------------------
+void SoftwareRasterizer::DrawIndexed(const Vertex* vertices, int vertexCount, const UINT* indices, int indexCount,
+	const ObjectMatrices& matrices, const XMFLOAT4& surfaceColor)
+{
+	double start = Now();
+
+	// The matrices are transposed for HLSL
+	XMMATRIX worldViewProj = XMMatrixTranspose(XMLoadFloat4x4(&matrices.WorldViewProjection));
+	XMMATRIX normalMatrix = XMMatrixTranspose(XMLoadFloat4x4(&matrices.WorldInverseTranspose));
+
+	transformed.resize(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		XMVECTOR position = XMLoadFloat3(&vertices[v].Position);
+		position = XMVectorSetW(position, 1.0f);
+		XMStoreFloat4(&transformed[v].Position, XMVector4Transform(position, worldViewProj));
+		XMStoreFloat3(&transformed[v].Normal, XMVector3TransformNormal(XMLoadFloat3(&vertices[v].Normal), normalMatrix));
+	}
+
+	for (int i = 0; i + 2 < indexCount; i += 3)
+	{
+		stats.Triangles++;
+		if (indices[i] >= (UINT)vertexCount || indices[i + 1] >= (UINT)vertexCount || indices[i + 2] >= (UINT)vertexCount)
+			continue;
+
+		const ClipVertex* corners[3] = { &transformed[indices[i]], &transformed[indices[i + 1]], &transformed[indices[i + 2]] };
+
+		// Which side of each plane every corner is on:
+		// left, right, bottom, top, near, far
+		unsigned int outsideAll = 0x3F;
+		unsigned int outsideAny = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			const XMFLOAT4& p = corners[c]->Position;
+			unsigned int outside =
+				(p.x < -p.w ? 0x01 : 0) | (p.x > p.w ? 0x02 : 0) |
+				(p.y < -p.w ? 0x04 : 0) | (p.y > p.w ? 0x08 : 0) |
+				(p.z < 0.0f ? 0x10 : 0) | (p.z > p.w ? 0x20 : 0);
+			outsideAll &= outside;
+			outsideAny |= outside;
+		}
+		if (outsideAll)
+			continue;
+
+		if ((outsideAny & 0x30) == 0)
+		{
+			SetupTriangle(*corners[0], *corners[1], *corners[2], surfaceColor);
+			continue;
+		}
+
+		// Sutherland-Hodgman against the near (z >= 0) then far
+		// (w - z >= 0) plane.  A triangle comes out with at most
+		// five corners, which are fanned back into triangles.
+		ClipVertex polygon[2][8];
+		int count = 3;
+		for (int c = 0; c < 3; c++)
+			polygon[0][c] = *corners[c];
+
+		for (int plane = 0; plane < 2; plane++)
+		{
+			const ClipVertex* in = polygon[plane];
+			ClipVertex* out = polygon[plane ^ 1];
+			int outCount = 0;
+			for (int c = 0; c < count; c++)
+			{
+				const ClipVertex& a = in[c];
+				const ClipVertex& b = in[(c + 1) % count];
+				float da = plane == 0 ? a.Position.z : a.Position.w - a.Position.z;
+				float db = plane == 0 ? b.Position.z : b.Position.w - b.Position.z;
+
+				if (da >= 0.0f)
+					out[outCount++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+				{
+					// Always from the inside corner out, so the triangle
+					// on the other side of this edge gets the very same point
+					const ClipVertex& from = da >= 0.0f ? a : b;
+					const ClipVertex& to = da >= 0.0f ? b : a;
+					float dFrom = da >= 0.0f ? da : db;
+					float dTo = da >= 0.0f ? db : da;
+					float t = dFrom / (dFrom - dTo);
+					XMVECTOR position = XMVectorLerp(XMLoadFloat4(&from.Position), XMLoadFloat4(&to.Position), t);
+					XMVECTOR normal = XMVectorLerp(XMLoadFloat3(&from.Normal), XMLoadFloat3(&to.Normal), t);
+					XMStoreFloat4(&out[outCount].Position, position);
+					XMStoreFloat3(&out[outCount].Normal, normal);
+					outCount++;
+				}
+			}
+			count = outCount;
+			if (count < 3)
+				break;
+		}
+
+		// Two planes, so the result ended up back in polygon[0]
+		for (int c = 1; c + 1 < count; c++)
+			SetupTriangle(polygon[0][0], polygon[0][c], polygon[0][c + 1], surfaceColor);
+	}
+
+	stats.SetupSeconds += Now() - start;
+}
+
+void SoftwareRasterizer::DrawIndexed(const MeshData& mesh, const ObjectMatrices& matrices, const XMFLOAT4& surfaceColor)
+{
+	DrawIndexed(mesh.VertexPointer, mesh.VertexCount, mesh.IndexPointer, mesh.IndexCount, matrices, surfaceColor);
+}
+
+// --------------------------------------------------------
+// Divides by w, maps to pixels (y down, pixel centers at
+// +0.5) and works out the edge functions.  Back facing and
+// zero area triangles are dropped here.
+// --------------------------------------------------------
+void SoftwareRasterizer::SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, const XMFLOAT4& color)
+{
+	const ClipVertex* corners[3] = { &v0, &v1, &v2 };
+	float x[3], y[3];
+	RasterTriangle triangle;
+	for (int c = 0; c < 3; c++)
+	{
+		const XMFLOAT4& p = corners[c]->Position;
+		if (!(p.w > 0.0f))
+			return;
+
+		// Snapped to 1/256 of a pixel, as D3D does, so slivers
+		// that the GPU sees as zero area are zero area here too
+		float inverseW = 1.0f / p.w;
+		x[c] = floorf((p.x * inverseW * 0.5f + 0.5f) * width * 256.0f + 0.5f) / 256.0f;
+		y[c] = floorf((0.5f - p.y * inverseW * 0.5f) * height * 256.0f + 0.5f) / 256.0f;
+
+		triangle.Z[c] = p.z * inverseW;
+		triangle.InverseW[c] = inverseW;
+		triangle.NormalOverW[c] = XMFLOAT3(
+			corners[c]->Normal.x * inverseW,
+			corners[c]->Normal.y * inverseW,
+			corners[c]->Normal.z * inverseW);
+	}
+
+	// Positive when clockwise on screen, which is the front
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (!(area > 0.0f))
+		return;
+
+	// The bounds, in pixels whose centers could be inside
+	float minX = fminf(x[0], fminf(x[1], x[2]));
+	float maxX = fmaxf(x[0], fmaxf(x[1], x[2]));
+	float minY = fminf(y[0], fminf(y[1], y[2]));
+	float maxY = fmaxf(y[0], fmaxf(y[1], y[2]));
+	triangle.MinX = minX < 0.0f ? 0 : (int)minX;
+	triangle.MinY = minY < 0.0f ? 0 : (int)minY;
+	triangle.MaxX = maxX >= (float)width ? (int)width - 1 : (int)maxX;
+	triangle.MaxY = maxY >= (float)height ? (int)height - 1 : (int)maxY;
+	if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+		return;
+
+	// Edge i runs from corner j to corner k.  C is written so
+	// neighbours sharing an edge get exactly opposite values.
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		triangle.EdgeA[i] = y[j] - y[k];
+		triangle.EdgeB[i] = x[k] - x[j];
+		triangle.EdgeC[i] = x[j] * y[k] - y[j] * x[k];
+
+		// D3D's fill rule: pixels exactly on a top edge (flat,
+		// going right) or left edge (going up) are drawn
+		triangle.TopLeft[i] = triangle.EdgeA[i] > 0.0f || (triangle.EdgeA[i] == 0.0f && triangle.EdgeB[i] > 0.0f);
+	}
+
+	triangle.Color = color;
+
+	triangles.push_back(triangle);
+	stats.TrianglesRasterized++;
+	BinTriangle((unsigned int)triangles.size() - 1);
+}
+
+void SoftwareRasterizer::BinTriangle(unsigned int index)
+{
+	const RasterTriangle& triangle = triangles[index];
+	unsigned int firstX = triangle.MinX / TileSize;
+	unsigned int lastX = triangle.MaxX / TileSize;
+	unsigned int firstY = triangle.MinY / TileSize;
+	unsigned int lastY = triangle.MaxY / TileSize;
+
+	for (unsigned int ty = firstY; ty <= lastY; ty++)
+	{
+		for (unsigned int tx = firstX; tx <= lastX; tx++)
+			bins[ty * tilesX + tx].push_back(index);
+	}
+	stats.TrianglesBinned += (lastX - firstX + 1) * (lastY - firstY + 1);
+}
+
+// --------------------------------------------------------
+// One job per tile that has anything in it.  Tiles never
+// share pixels, so they need no locking.
+// --------------------------------------------------------
+void SoftwareRasterizer::Flush()
+{
+	double start = Now();
+
+	JobCounter tiles;
+	for (unsigned int tile = 0; tile < bins.size(); tile++)
+	{
+		tilePixels[tile] = 0;
+		if (bins[tile].empty())
+			continue;
+
+		if (jobs)
+			jobs->Run([this, tile]() { RasterizeTile(tile); }, &tiles);
+		else
+			RasterizeTile(tile);
+	}
+	if (jobs)
+		jobs->Wait(&tiles);
+
+	for (unsigned int tile = 0; tile < bins.size(); tile++)
+	{
+		stats.PixelsShaded += tilePixels[tile];
+		bins[tile].clear();
+	}
+	triangles.clear();
+
+	stats.RasterSeconds += Now() - start;
+}
+
+// --------------------------------------------------------
+// Rasterizes and shades one tile's triangles, in order,
+// four pixels (one row, side by side) at a time
+// --------------------------------------------------------
+void SoftwareRasterizer::RasterizeTile(unsigned int tile)
+{
+	int tileX = (int)((tile % tilesX) * TileSize);
+	int tileY = (int)((tile / tilesX) * TileSize);
+	int tileRight = tileX + (int)TileSize - 1;
+	int tileBottom = tileY + (int)TileSize - 1;
+
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR minimumSum = XMVectorReplicate(1e-20f);
+	const XMVECTOR centers = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR screenWidth = XMVectorReplicate((float)width);
+
+	XMVECTOR lightX[2], lightY[2], lightZ[2];
+	for (int l = 0; l < 2; l++)
+	{
+		lightX[l] = XMVectorReplicate(lightDirections[l].x);
+		lightY[l] = XMVectorReplicate(lightDirections[l].y);
+		lightZ[l] = XMVectorReplicate(lightDirections[l].z);
+	}
+
+	unsigned int pixels = 0;
+	const std::vector<unsigned int>& bin = bins[tile];
+	for (size_t b = 0; b < bin.size(); b++)
+	{
+		const RasterTriangle& t = triangles[bin[b]];
+
+		// Starting on a whole vector (tiles are a multiple of 4
+		// wide, so this never leaves the tile)
+		int minX = (t.MinX > tileX ? t.MinX : tileX) & ~3;
+		int maxX = t.MaxX < tileRight ? t.MaxX : tileRight;
+		int minY = t.MinY > tileY ? t.MinY : tileY;
+		int maxY = t.MaxY < tileBottom ? t.MaxY : tileBottom;
+
+		XMVECTOR edgeA[3], edgeB[3], edgeC[3];
+		XMVECTOR topLeft[3];
+		for (int e = 0; e < 3; e++)
+		{
+			edgeA[e] = XMVectorReplicate(t.EdgeA[e]);
+			edgeB[e] = XMVectorReplicate(t.EdgeB[e]);
+			edgeC[e] = XMVectorReplicate(t.EdgeC[e]);
+			topLeft[e] = t.TopLeft[e] ? XMVectorTrueInt() : XMVectorFalseInt();
+		}
+
+		// Per-corner attributes, one lane each
+		XMVECTOR z[3], inverseW[3], normalX[3], normalY[3], normalZ[3];
+		for (int c = 0; c < 3; c++)
+		{
+			z[c] = XMVectorReplicate(t.Z[c]);
+			inverseW[c] = XMVectorReplicate(t.InverseW[c]);
+			normalX[c] = XMVectorReplicate(t.NormalOverW[c].x);
+			normalY[c] = XMVectorReplicate(t.NormalOverW[c].y);
+			normalZ[c] = XMVectorReplicate(t.NormalOverW[c].z);
+		}
+
+		XMVECTOR colorR = XMVectorReplicate(t.Color.x);
+		XMVECTOR colorG = XMVectorReplicate(t.Color.y);
+		XMVECTOR colorB = XMVectorReplicate(t.Color.z);
+		XMVECTOR colorA = XMVectorReplicate(t.Color.w);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			XMVECTOR pixelY = XMVectorReplicate(y + 0.5f);
+			XMVECTOR rowEdge[3];
+			for (int e = 0; e < 3; e++)
+				rowEdge[e] = XMVectorMultiplyAdd(edgeB[e], pixelY, edgeC[e]);
+
+			float* depthRow = &depthBuffer[y * pitch];
+			unsigned int* colorRow = &colorBuffer[y * pitch];
+
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				XMVECTOR pixelX = XMVectorAdd(XMVectorReplicate((float)x), centers);
+
+				// Inside all three edges (or exactly on one it owns),
+				// and on screen
+				XMVECTOR edge[3];
+				XMVECTOR inside = XMVectorLess(pixelX, screenWidth);
+				for (int e = 0; e < 3; e++)
+				{
+					edge[e] = XMVectorMultiplyAdd(edgeA[e], pixelX, rowEdge[e]);
+					XMVECTOR owned = XMVectorOrInt(
+						XMVectorGreater(edge[e], zero),
+						XMVectorAndInt(XMVectorEqual(edge[e], zero), topLeft[e]));
+					inside = XMVectorAndInt(inside, owned);
+				}
+				if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+					continue;
+
+				// Barycentrics, then depth (linear on screen).  Dividing
+				// by the edges' sum rather than the area means they add
+				// up to exactly one even on slivers, where rounding
+				// would otherwise push depth outside the triangle.
+				XMVECTOR sum = XMVectorMax(XMVectorAdd(edge[0], XMVectorAdd(edge[1], edge[2])), minimumSum);
+				XMVECTOR inverseSum = XMVectorReciprocal(sum);
+				XMVECTOR b0 = XMVectorMultiply(edge[0], inverseSum);
+				XMVECTOR b1 = XMVectorMultiply(edge[1], inverseSum);
+				XMVECTOR b2 = XMVectorMultiply(edge[2], inverseSum);
+				XMVECTOR depth = XMVectorMultiplyAdd(b0, z[0], XMVectorMultiplyAdd(b1, z[1], XMVectorMultiply(b2, z[2])));
+
+				XMVECTOR storedDepth = XMLoadFloat4((const XMFLOAT4*)&depthRow[x]);
+				XMVECTOR pass = XMVectorAndInt(inside, XMVectorLess(depth, storedDepth));
+				if (XMVector4EqualInt(pass, XMVectorFalseInt()))
+					continue;
+				XMStoreFloat4((XMFLOAT4*)&depthRow[x], XMVectorSelect(storedDepth, depth, pass));
+
+				// Perspective correct normal, normalized
+				XMVECTOR w = XMVectorReciprocal(XMVectorMultiplyAdd(b0, inverseW[0], XMVectorMultiplyAdd(b1, inverseW[1], XMVectorMultiply(b2, inverseW[2]))));
+				XMVECTOR nx = XMVectorMultiply(XMVectorMultiplyAdd(b0, normalX[0], XMVectorMultiplyAdd(b1, normalX[1], XMVectorMultiply(b2, normalX[2]))), w);
+				XMVECTOR ny = XMVectorMultiply(XMVectorMultiplyAdd(b0, normalY[0], XMVectorMultiplyAdd(b1, normalY[1], XMVectorMultiply(b2, normalY[2]))), w);
+				XMVECTOR nz = XMVectorMultiply(XMVectorMultiplyAdd(b0, normalZ[0], XMVectorMultiplyAdd(b1, normalZ[1], XMVectorMultiply(b2, normalZ[2]))), w);
+				XMVECTOR length = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(ny, ny, XMVectorMultiply(nz, nz))));
+				nx = XMVectorMultiply(nx, length);
+				ny = XMVectorMultiply(ny, length);
+				nz = XMVectorMultiply(nz, length);
+
+				// PixelShader.hlsl: each light's saturate(N.L) times its
+				// diffuse, plus both ambients, times the surface color
+				XMVECTOR amount[2];
+				for (int l = 0; l < 2; l++)
+					amount[l] = XMVectorSaturate(XMVectorMultiplyAdd(nx, lightX[l], XMVectorMultiplyAdd(ny, lightY[l], XMVectorMultiply(nz, lightZ[l]))));
+
+				XMVECTOR channels[4];
+				const XMVECTOR surface[4] = { colorR, colorG, colorB, colorA };
+				for (int c = 0; c < 4; c++)
+				{
+					const float* diffuse1 = &lightDiffuse[0].x;
+					const float* diffuse2 = &lightDiffuse[1].x;
+					XMVECTOR lighting = XMVectorMultiplyAdd(amount[0], XMVectorReplicate(diffuse1[c]),
+						XMVectorMultiplyAdd(amount[1], XMVectorReplicate(diffuse2[c]), XMVectorReplicate((&ambient.x)[c])));
+					channels[c] = XMVectorMultiplyAdd(XMVectorSaturate(XMVectorMultiply(lighting, surface[c])), XMVectorReplicate(255.0f), XMVectorReplicate(0.5f));
+				}
+
+				// To RGBA8, only where the depth test passed
+				XMFLOAT4 r, g, bl, a;
+				XMStoreFloat4(&r, channels[0]);
+				XMStoreFloat4(&g, channels[1]);
+				XMStoreFloat4(&bl, channels[2]);
+				XMStoreFloat4(&a, channels[3]);
+				uint32_t written[4];
+				XMStoreInt4(written, pass);
+				const float* lanes[4] = { &r.x, &g.x, &bl.x, &a.x };
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (!written[lane])
+						continue;
+					colorRow[x + lane] =
+						(unsigned int)lanes[0][lane] |
+						((unsigned int)lanes[1][lane] << 8) |
+						((unsigned int)lanes[2][lane] << 16) |
+						((unsigned int)lanes[3][lane] << 24);
+					pixels++;
+				}
+			}
+		}
+	}
+
+	tilePixels[tile] = pixels;
+}
+
+// --------------------------------------------------------
+// Bottom-up rows of BGR, each padded to 4 bytes
+// --------------------------------------------------------
+bool SoftwareRasterizer::SaveBitmap(const char* file)
+{
+	std::ofstream out(file, std::ios::binary);
+	if (!out)
+		return false;
+
+	unsigned int rowBytes = (width * 3 + 3) & ~3u;
+	unsigned int imageBytes = rowBytes * height;
+
+	unsigned char header[54] = {};
+	header[0] = 'B';
+	header[1] = 'M';
+	unsigned int fields[][2] =
+	{
+		{ 2, 54 + imageBytes },	// File size
+		{ 10, 54 },				// Offset to the pixels
+		{ 14, 40 },				// BITMAPINFOHEADER size
+		{ 18, width },
+		{ 22, height },			// Positive: bottom-up
+		{ 26, 1 | (24 << 16) },	// Planes, bits per pixel
+		{ 34, imageBytes },
+	};
+	for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+		memcpy(&header[fields[f][0]], &fields[f][1], 4);
+	out.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned char> row(rowBytes);
+	for (unsigned int y = height; y-- > 0;)
+	{
+		const unsigned int* pixels = &colorBuffer[y * pitch];
+		for (unsigned int x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = (unsigned char)(pixels[x] >> 16);
+			row[x * 3 + 1] = (unsigned char)(pixels[x] >> 8);
+			row[x * 3 + 2] = (unsigned char)pixels[x];
+		}
+		out.write((const char*)&row[0], rowBytes);
+	}
+	return out.good();
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "Vertex.h"
+#include "Lights.h"
+#include "Mesh.h"
+#include "JobSystem.h"
+#include "InstancedRenderer.h"
+
+// What everything since the last Clear() cost.  Triangles is
+// everything submitted; Rasterized is what survived culling
+// and clipping.
+struct RasterStats
+{
+	unsigned int Triangles;
+	unsigned int TrianglesRasterized;
+	unsigned int TrianglesBinned;	// One per tile each touches
+	unsigned int PixelsShaded;
+	double SetupSeconds;			// Transform, clip and bin
+	double RasterSeconds;			// Every tile, start to finish
+};
+
+// --------------------------------------------------------
+// Draws meshes on the CPU, the way VertexShader.hlsl and
+// PixelShader.hlsl do on the GPU, as a reference image and
+// a way to measure per-pixel cost without one
+//
+// DrawIndexed() runs the vertex shader's transform (the same
+// ObjectMatrices InstancedRenderer uploads), clips against
+// the near and far planes, culls back faces (D3D's default
+// rasterizer state: clockwise is the front) and bins each
+// triangle into the 64x64 pixel tiles its bounds touch.
+// Flush() then rasterizes every tile as its own job.  Tiles
+// draw their triangles in submission order, so the result
+// doesn't depend on how many workers there are.
+//
+// Within a tile, the three edge functions, depth and
+// attributes are evaluated four pixels at a time with
+// DirectXMath vectors.  Depth is a float buffer with a LESS
+// test (cleared to 1); normals are interpolated with
+// perspective correction and lit by two DirectionalLights,
+// as PixelShader.hlsl does.  Colors are stored as RGBA8,
+// like the swap chain's R8G8B8A8_UNORM back buffer.
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+
+public:
+	// jobs - runs the tiles; 0 for all of them on the calling thread
+	SoftwareRasterizer(unsigned int width, unsigned int height, JobSystem* jobs = 0);
+	~SoftwareRasterizer();
+
+	// PixelShader.hlsl's light_1 and light_2
+	void SetLights(const DirectionalLight& light1, const DirectionalLight& light2);
+
+	// Clears color and depth, and resets the stats
+	void Clear(const float color[4]);
+
+	// matrices - as InstancedRenderer::ComputeObjectMatrices()
+	// makes them (transposed); surfaceColor - the material's
+	void DrawIndexed(const Vertex* vertices, int vertexCount, const UINT* indices, int indexCount,
+		const ObjectMatrices& matrices, const DirectX::XMFLOAT4& surfaceColor);
+	void DrawIndexed(const MeshData& mesh, const ObjectMatrices& matrices, const DirectX::XMFLOAT4& surfaceColor);
+
+	// Rasterizes everything drawn since the last Flush()
+	void Flush();
+
+	unsigned int GetWidth() { return width; }
+	unsigned int GetHeight() { return height; }
+
+	// RGBA8 rows, GetPitch() pixels apart
+	const unsigned int* GetPixels() { return &colorBuffer[0]; }
+	unsigned int GetPitch() { return pitch; }
+
+	// Writes the color buffer as a 24-bit .bmp
+	bool SaveBitmap(const char* file);
+
+	const RasterStats& GetStats() { return stats; }
+
+	static const unsigned int TileSize = 64;
+
+private:
+	// A triangle after setup, in screen space.  Edge i is
+	// the one opposite vertex i: A x + B y + C is positive
+	// inside it, and proportional to that vertex's
+	// barycentric weight.
+	struct RasterTriangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		bool TopLeft[3];	// Owns pixels exactly on it
+
+		float Z[3];				// Depth, linear in screen space
+		float InverseW[3];
+		DirectX::XMFLOAT3 NormalOverW[3];
+		DirectX::XMFLOAT4 Color;
+
+		int MinX, MinY, MaxX, MaxY;	// Pixel bounds, inclusive
+	};
+
+	// A vertex shader output: clip space position and normal
+	struct ClipVertex
+	{
+		DirectX::XMFLOAT4 Position;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int pitch;		// Width rounded up to a whole vector
+	unsigned int tilesX;
+	unsigned int tilesY;
+	JobSystem* jobs;
+
+	std::vector<unsigned int> colorBuffer;
+	std::vector<float> depthBuffer;
+
+	// Reused each frame, so they stop allocating once warm
+	std::vector<ClipVertex> transformed;
+	std::vector<RasterTriangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;
+	std::vector<unsigned int> tilePixels;
+
+	// The pixel shader's constants, ready to use
+	DirectX::XMFLOAT3 lightDirections[2];	// normalize(-Direction)
+	DirectX::XMFLOAT4 lightDiffuse[2];
+	DirectX::XMFLOAT4 ambient;				// Both lights' ambient, added up
+
+	RasterStats stats;
+
+	void SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, const DirectX::XMFLOAT4& color);
+	void BinTriangle(unsigned int index);
+	void RasterizeTile(unsigned int tile);
+};
@@ -0,0 +1,277 @@
+#include "StateCache.h"
+
+#include <cstdint>
+#include <cstdio>
+
+// Stands in for "whatever is bound, we don't know" - no real
+// object lives at this address, so it never matches a call
+template <typename T>
+static T* Unknown()
+{
+	return reinterpret_cast<T*>(~(uintptr_t)0);
+}
+
+template <typename T>
+static void Forget(T** slots, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		slots[i] = Unknown<T>();
+}
+
+StateCache::StateCache(RenderDevice* device)
+{
+	this->device = device;
+
+	Invalidate();
+	ResetCounters();
+}
+
+void StateCache::Invalidate()
+{
+	inputLayout = Unknown<ID3D11InputLayout>();
+	topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	Forget(vertexBuffers, MaxVertexBuffers);
+	for (unsigned int i = 0; i < MaxVertexBuffers; i++)
+	{
+		vertexStrides[i] = 0;
+		vertexOffsets[i] = 0;
+	}
+	indexBuffer = Unknown<ID3D11Buffer>();
+	indexFormat = DXGI_FORMAT_UNKNOWN;
+	indexOffset = 0;
+
+	StageState* stages[2] = { &vertexStage, &pixelStage };
+	for (int s = 0; s < 2; s++)
+	{
+		stages[s]->Shader = Unknown<ID3D11DeviceChild>();
+		Forget(stages[s]->ConstantBuffers, MaxConstantBuffers);
+		Forget(stages[s]->ShaderResources, MaxShaderResources);
+		Forget(stages[s]->Samplers, MaxSamplers);
+	}
+}
+
+// --------------------------------------------------------
+// Input assembler
+// --------------------------------------------------------
+void StateCache::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (Count(StateCallInputLayout, inputLayout != this->inputLayout))
+	{
+		this->inputLayout = inputLayout;
+		device->IASetInputLayout(inputLayout);
+	}
+}
+
+void StateCache::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (Count(StateCallTopology, topology != this->topology))
+	{
+		this->topology = topology;
+		device->IASetPrimitiveTopology(topology);
+	}
+}
+
+void StateCache::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	// Trim to the slots whose buffer, stride or offset changes
+	UINT first = startSlot + count;
+	UINT last = startSlot;
+	for (UINT i = 0; i < count; i++)
+	{
+		UINT slot = startSlot + i;
+		if (slot < MaxVertexBuffers &&
+			vertexBuffers[slot] == buffers[i] &&
+			vertexStrides[slot] == strides[i] &&
+			vertexOffsets[slot] == offsets[i])
+			continue;
+
+		if (slot < first) first = slot;
+		last = slot + 1;
+		if (slot < MaxVertexBuffers)
+		{
+			vertexBuffers[slot] = buffers[i];
+			vertexStrides[slot] = strides[i];
+			vertexOffsets[slot] = offsets[i];
+		}
+	}
+
+	if (Count(StateCallVertexBuffers, first < last))
+	{
+		UINT skip = first - startSlot;
+		device->IASetVertexBuffers(first, last - first, buffers + skip, strides + skip, offsets + skip);
+	}
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	bool changed = buffer != indexBuffer || format != indexFormat || offset != indexOffset;
+	if (Count(StateCallIndexBuffer, changed))
+	{
+		indexBuffer = buffer;
+		indexFormat = format;
+		indexOffset = offset;
+		device->IASetIndexBuffer(buffer, format, offset);
+	}
+}
+
+// --------------------------------------------------------
+// Vertex shader stage
+// --------------------------------------------------------
+void StateCache::VSSetShader(ID3D11VertexShader* shader)
+{
+	if (Count(StateCallShader, shader != vertexStage.Shader))
+	{
+		vertexStage.Shader = shader;
+		device->VSSetShader(shader);
+	}
+}
+
+void StateCache::VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	UINT first, changed;
+	if (Count(StateCallConstantBuffers, FilterSlots(vertexStage.ConstantBuffers, MaxConstantBuffers, startSlot, count, buffers, &first, &changed)))
+		device->VSSetConstantBuffers(first, changed, buffers + (first - startSlot));
+}
+
+void StateCache::VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	if (!device->CanOffsetConstantBuffers())
+		return;
+
+	// Whatever plain buffer is asked for next has to go through
+	for (UINT i = 0; i < count && startSlot + i < MaxConstantBuffers; i++)
+		vertexStage.ConstantBuffers[startSlot + i] = Unknown<ID3D11Buffer>();
+
+	Count(StateCallConstantBuffers, true);
+	device->VSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+}
+
+void StateCache::VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	UINT first, changed;
+	if (Count(StateCallShaderResources, FilterSlots(vertexStage.ShaderResources, MaxShaderResources, startSlot, count, views, &first, &changed)))
+		device->VSSetShaderResources(first, changed, views + (first - startSlot));
+}
+
+void StateCache::VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	UINT first, changed;
+	if (Count(StateCallSamplers, FilterSlots(vertexStage.Samplers, MaxSamplers, startSlot, count, samplers, &first, &changed)))
+		device->VSSetSamplers(first, changed, samplers + (first - startSlot));
+}
+
+// --------------------------------------------------------
+// Pixel shader stage
+// --------------------------------------------------------
+void StateCache::PSSetShader(ID3D11PixelShader* shader)
+{
+	if (Count(StateCallShader, shader != pixelStage.Shader))
+	{
+		pixelStage.Shader = shader;
+		device->PSSetShader(shader);
+	}
+}
+
+void StateCache::PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	UINT first, changed;
+	if (Count(StateCallConstantBuffers, FilterSlots(pixelStage.ConstantBuffers, MaxConstantBuffers, startSlot, count, buffers, &first, &changed)))
+		device->PSSetConstantBuffers(first, changed, buffers + (first - startSlot));
+}
+
+void StateCache::PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	UINT first, changed;
+	if (Count(StateCallShaderResources, FilterSlots(pixelStage.ShaderResources, MaxShaderResources, startSlot, count, views, &first, &changed)))
+		device->PSSetShaderResources(first, changed, views + (first - startSlot));
+}
+
+void StateCache::PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	UINT first, changed;
+	if (Count(StateCallSamplers, FilterSlots(pixelStage.Samplers, MaxSamplers, startSlot, count, samplers, &first, &changed)))
+		device->PSSetSamplers(first, changed, samplers + (first - startSlot));
+}
+
+// --------------------------------------------------------
+// Counters
+// --------------------------------------------------------
+unsigned int StateCache::GetIssuedCount()
+{
+	unsigned int total = 0;
+	for (int k = 0; k < StateCallKindCount; k++)
+		total += issued[k];
+	return total;
+}
+
+unsigned int StateCache::GetFilteredCount()
+{
+	unsigned int total = 0;
+	for (int k = 0; k < StateCallKindCount; k++)
+		total += filtered[k];
+	return total;
+}
+
+void StateCache::ResetCounters()
+{
+	for (int k = 0; k < StateCallKindCount; k++)
+	{
+		issued[k] = 0;
+		filtered[k] = 0;
+	}
+}
+
+void StateCache::PrintStats()
+{
+	static const char* names[StateCallKindCount] =
+	{
+		"shader", "layout", "topology", "vertex buffers", "index buffer",
+		"constant buffers", "resources", "samplers",
+	};
+
+	printf("State cache: %u calls issued, %u filtered (", GetIssuedCount(), GetFilteredCount());
+	for (int k = 0; k < StateCallKindCount; k++)
+		printf("%s%s %u/%u", k ? ", " : "", names[k], issued[k], issued[k] + filtered[k]);
+	printf(")\n");
+}
+
+// Returns changed, so callers can count and test in one go
+bool StateCache::Count(StateCall kind, bool changed)
+{
+	if (changed)
+		issued[kind]++;
+	else
+		filtered[kind]++;
+	return changed;
+}
+
+// --------------------------------------------------------
+// Updates the cached slots and finds the smallest run that
+// covers every slot that changed.  Slots at or past maxSlots
+// aren't tracked, so they always count as changed.
+//
+// Returns false if nothing changed
+// --------------------------------------------------------
+template <typename T>
+bool StateCache::FilterSlots(T** cached, UINT maxSlots, UINT startSlot, UINT count, T* const* incoming, UINT* changedStart, UINT* changedCount)
+{
+	UINT first = startSlot + count;
+	UINT last = startSlot;
+	for (UINT i = 0; i < count; i++)
+	{
+		UINT slot = startSlot + i;
+		if (slot < maxSlots)
+		{
+			if (cached[slot] == incoming[i])
+				continue;
+			cached[slot] = incoming[i];
+		}
+
+		if (slot < first) first = slot;
+		last = slot + 1;
+	}
+
+	*changedStart = first;
+	*changedCount = first < last ? last - first : 0;
+	return first < last;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "RenderDevice.h"
+
+// The kinds of calls StateCache filters, for its counters
+enum StateCall
+{
+	StateCallShader,
+	StateCallInputLayout,
+	StateCallTopology,
+	StateCallVertexBuffers,
+	StateCallIndexBuffer,
+	StateCallConstantBuffers,
+	StateCallShaderResources,
+	StateCallSamplers,
+	StateCallKindCount,
+};
+
+// --------------------------------------------------------
+// Sits in front of a RenderDevice and drops calls that would
+// bind what is already bound
+//
+// It remembers the input assembler state and, for the vertex
+// and pixel stages, the shader, constant buffers, shader
+// resources and samplers.  Calls that set a range of slots
+// are trimmed to the slots that actually change.  Slots past
+// what is tracked are always passed through.
+//
+// Everything has to go through here for the cache to be
+// right: after anything else binds on the device, call
+// Invalidate().
+//
+// Behind a NullRenderDevice, the device's log shows exactly
+// which calls made it past the cache.
+// --------------------------------------------------------
+class StateCache
+{
+
+public:
+	StateCache(RenderDevice* device);
+
+	// Forget everything, so the next call of each kind goes through
+	void Invalidate();
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+
+	// D3D11.1 only (see CanOffsetConstantBuffers()): binds part of
+	// each buffer.  Always passed on - the slots are forgotten,
+	// since the cache doesn't track offsets.
+	void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+	void VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	// For everything that isn't cached (draws, Map, etc.)
+	RenderDevice* GetDevice() { return device; }
+
+	bool CanOffsetConstantBuffers() { return device->CanOffsetConstantBuffers(); }
+
+	// Calls passed on to the device vs. dropped, since the last reset
+	unsigned int GetIssuedCount();
+	unsigned int GetFilteredCount();
+	unsigned int GetIssuedCount(StateCall kind) { return issued[kind]; }
+	unsigned int GetFilteredCount(StateCall kind) { return filtered[kind]; }
+	void ResetCounters();
+	void PrintStats();
+
+	static const unsigned int MaxVertexBuffers = 16;
+	static const unsigned int MaxConstantBuffers = 14;
+	static const unsigned int MaxShaderResources = 32;
+	static const unsigned int MaxSamplers = 16;
+
+private:
+	struct StageState
+	{
+		ID3D11DeviceChild* Shader;
+		ID3D11Buffer* ConstantBuffers[MaxConstantBuffers];
+		ID3D11ShaderResourceView* ShaderResources[MaxShaderResources];
+		ID3D11SamplerState* Samplers[MaxSamplers];
+	};
+
+	RenderDevice* device;
+
+	ID3D11InputLayout* inputLayout;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	ID3D11Buffer* vertexBuffers[MaxVertexBuffers];
+	UINT vertexStrides[MaxVertexBuffers];
+	UINT vertexOffsets[MaxVertexBuffers];
+	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	UINT indexOffset;
+
+	StageState vertexStage;
+	StageState pixelStage;
+
+	unsigned int issued[StateCallKindCount];
+	unsigned int filtered[StateCallKindCount];
+
+	bool Count(StateCall kind, bool changed);
+
+	template <typename T>
+	bool FilterSlots(T** cached, UINT maxSlots, UINT startSlot, UINT count, T* const* incoming, UINT* changedStart, UINT* changedCount);
+};
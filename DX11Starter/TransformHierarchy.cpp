@@ -0,0 +1,207 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+TransformHierarchy::TransformHierarchy()
+{
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+}
+
+// --------------------------------------------------------
+// Adds a node at the end of its parent's subtree
+// --------------------------------------------------------
+unsigned int TransformHierarchy::Add(unsigned int target, int parent)
+{
+	unsigned int node;
+	if (freeNodes.empty())
+	{
+		node = (unsigned int)posOfNode.size();
+		posOfNode.push_back(0);
+	}
+	else
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+
+	unsigned int count = (unsigned int)nodeOfPos.size();
+	unsigned int pos = count;
+	if (parent >= 0)
+	{
+		unsigned int parentAt = posOfNode[parent];
+		pos = parentAt + subtreeSize[parentAt];
+	}
+
+	parentNode.insert(parentNode.begin() + pos, parent);
+	targets.insert(targets.begin() + pos, target);
+	dirty.insert(dirty.begin() + pos, 1);
+	nodeOfPos.insert(nodeOfPos.begin() + pos, node);
+
+	if (pos < count)
+	{
+		// Landed in the middle - everything after it moved
+		Rebuild();
+		return node;
+	}
+
+	// Appended, so only the new node and its ancestors change
+	posOfNode[node] = pos;
+	parentPos.push_back(parent >= 0 ? (int)posOfNode[parent] : -1);
+	subtreeSize.push_back(1);
+	changed.push_back(0);
+	for (int p = parentPos[pos]; p >= 0; p = parentPos[p])
+		subtreeSize[p]++;
+	return node;
+}
+
+void TransformHierarchy::Remove(unsigned int node)
+{
+	unsigned int pos = posOfNode[node];
+	int grandparent = parentNode[pos];
+
+	// Hand the direct children to our parent.  They stay where
+	// they are, which is still inside the grandparent's subtree.
+	for (unsigned int k = pos + 1; k < pos + subtreeSize[pos]; k++)
+	{
+		if (parentNode[k] == (int)node)
+		{
+			parentNode[k] = grandparent;
+			dirty[k] = 1;
+		}
+	}
+
+	parentNode.erase(parentNode.begin() + pos);
+	targets.erase(targets.begin() + pos);
+	dirty.erase(dirty.begin() + pos);
+	nodeOfPos.erase(nodeOfPos.begin() + pos);
+	freeNodes.push_back(node);
+	Rebuild();
+}
+
+// --------------------------------------------------------
+// Moves a node (and its whole subtree) to the end of its new
+// parent's subtree, or to the end of the order for parent -1
+// --------------------------------------------------------
+bool TransformHierarchy::SetParent(unsigned int node, int parent)
+{
+	unsigned int pos = posOfNode[node];
+	unsigned int size = subtreeSize[pos];
+	if (parentNode[pos] == parent)
+		return true;
+
+	unsigned int dest = (unsigned int)nodeOfPos.size();
+	if (parent >= 0)
+	{
+		// Can't become a child of our own descendant
+		unsigned int parentAt = posOfNode[parent];
+		if (parentAt >= pos && parentAt < pos + size)
+			return false;
+		dest = parentAt + subtreeSize[parentAt];
+	}
+
+	MoveBlock(pos, size, dest);
+	unsigned int newPos = dest > pos ? dest - size : dest;
+	parentNode[newPos] = parent;
+	dirty[newPos] = 1;
+	Rebuild();
+	return true;
+}
+
+int TransformHierarchy::GetParent(unsigned int node)
+{
+	return parentNode[posOfNode[node]];
+}
+
+void TransformHierarchy::SetTarget(unsigned int node, unsigned int target)
+{
+	targets[posOfNode[node]] = target;
+}
+
+void TransformHierarchy::MarkDirty(unsigned int node)
+{
+	dirty[posOfNode[node]] = 1;
+}
+
+// --------------------------------------------------------
+// The linear sweep.  Parents come first, so by the time a
+// node is reached we already know whether its parent moved.
+// --------------------------------------------------------
+unsigned int TransformHierarchy::Update(const XMFLOAT4X4* localMatrices, XMFLOAT4X4* worldMatrices)
+{
+	unsigned int rebuilt = 0;
+	for (size_t k = 0; k < nodeOfPos.size(); k++)
+	{
+		int p = parentPos[k];
+		changed[k] = dirty[k] || (p >= 0 && changed[p]);
+		if (!changed[k])
+			continue;
+
+		unsigned int target = targets[k];
+		if (p < 0)
+		{
+			worldMatrices[target] = localMatrices[target];
+		}
+		else
+		{
+			XMMATRIX parentWorld = XMLoadFloat4x4(&worldMatrices[targets[p]]);
+			XMMATRIX local = XMLoadFloat4x4(&localMatrices[target]);
+			XMStoreFloat4x4(&worldMatrices[target], XMMatrixMultiply(parentWorld, local));
+		}
+
+		dirty[k] = 0;
+		rebuilt++;
+	}
+	return rebuilt;
+}
+
+template <typename T>
+static void RotateBlock(std::vector<T>& v, unsigned int from, unsigned int size, unsigned int to)
+{
+	if (to > from)
+		std::rotate(v.begin() + from, v.begin() + from + size, v.begin() + to);
+	else
+		std::rotate(v.begin() + to, v.begin() + from, v.begin() + from + size);
+}
+
+// --------------------------------------------------------
+// Moves positions [from, from + size) so they start at "to"
+// (or end at "to", when moving towards the back)
+// --------------------------------------------------------
+void TransformHierarchy::MoveBlock(unsigned int from, unsigned int size, unsigned int to)
+{
+	RotateBlock(parentNode, from, size, to);
+	RotateBlock(targets, from, size, to);
+	RotateBlock(dirty, from, size, to);
+	RotateBlock(nodeOfPos, from, size, to);
+}
+
+// --------------------------------------------------------
+// Recomputes everything derived from the order after an edit
+// --------------------------------------------------------
+void TransformHierarchy::Rebuild()
+{
+	size_t count = nodeOfPos.size();
+	parentPos.resize(count);
+	subtreeSize.assign(count, 1);
+	changed.assign(count, 0);
+
+	for (size_t k = 0; k < count; k++)
+		posOfNode[nodeOfPos[k]] = (unsigned int)k;
+
+	for (size_t k = 0; k < count; k++)
+		parentPos[k] = parentNode[k] < 0 ? -1 : (int)posOfNode[parentNode[k]];
+
+	// Children come after parents, so a backwards pass
+	// finishes each subtree before adding it to its parent
+	for (size_t k = count; k-- > 0;)
+	{
+		if (parentPos[k] >= 0)
+			subtreeSize[parentPos[k]] += subtreeSize[k];
+	}
+}
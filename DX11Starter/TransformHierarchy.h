@@ -0,0 +1,67 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+// --------------------------------------------------------
+// Parent/child relationships between transforms
+//
+// Nodes are kept in depth-first order: a parent always comes
+// before its children, and each subtree is one contiguous run.
+// That makes Update() a single front-to-back sweep: a node's
+// world matrix is rebuilt only if its own local matrix changed
+// (MarkDirty) or its parent's world matrix was just rebuilt.
+//
+// Each node points at a "target" index into the local and
+// world matrix arrays passed to Update(), so the matrices can
+// live wherever their owner keeps them.  Node ids are stable;
+// positions in the order change whenever the tree is edited,
+// which costs O(node count) and is meant to be rare.
+//
+// Matrices are stored transposed (ready for shaders), so
+// world = parentWorld * local rather than the other way round.
+// --------------------------------------------------------
+class TransformHierarchy
+{
+
+public:
+	TransformHierarchy();
+	~TransformHierarchy();
+
+	// parent - -1 for a root.  Building a tree top-down (parents
+	// before children) appends and skips the O(n) reordering.
+	unsigned int Add(unsigned int target, int parent = -1);
+
+	// Children of a removed node move up to its parent
+	void Remove(unsigned int node);
+
+	// parent - -1 for none.  Fails if that would create a cycle.
+	bool SetParent(unsigned int node, int parent);
+	int GetParent(unsigned int node);
+
+	void SetTarget(unsigned int node, unsigned int target);
+	void MarkDirty(unsigned int node);
+
+	// Returns how many world matrices were rebuilt
+	unsigned int Update(const DirectX::XMFLOAT4X4* localMatrices, DirectX::XMFLOAT4X4* worldMatrices);
+
+	unsigned int GetCount() { return (unsigned int)nodeOfPos.size(); }
+
+private:
+	// Indexed by position in depth-first order
+	std::vector<int> parentNode;
+	std::vector<int> parentPos;
+	std::vector<unsigned int> subtreeSize;
+	std::vector<unsigned int> targets;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> changed;
+	std::vector<unsigned int> nodeOfPos;
+
+	// Indexed by node id
+	std::vector<unsigned int> posOfNode;
+	std::vector<unsigned int> freeNodes;
+
+	void MoveBlock(unsigned int from, unsigned int size, unsigned int to);
+	void Rebuild();
+};
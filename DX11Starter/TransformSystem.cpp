@@ -0,0 +1,280 @@
+#include "TransformSystem.h"
+
+#include <atomic>
+#include <cstring>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+TransformSystem::TransformSystem()
+{
+	count = 0;
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+// --------------------------------------------------------
+// Adds an object with an identity transform, returning its id
+// --------------------------------------------------------
+unsigned int TransformSystem::Add()
+{
+	unsigned int id;
+	if (freeIds.empty())
+	{
+		id = (unsigned int)slotOfId.size();
+		slotOfId.push_back(0);
+	}
+	else
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+
+	unsigned int slot = count++;
+	Resize((count + 3) & ~3u);
+
+	posX[slot] = posY[slot] = posZ[slot] = 0.0f;
+	rotX[slot] = rotY[slot] = rotZ[slot] = 0.0f;
+	scaleX[slot] = scaleY[slot] = scaleZ[slot] = 1.0f;
+	dirty[slot] = 0;
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixIdentity());
+
+	slotOfId[id] = slot;
+	idOfSlot[slot] = id;
+	return id;
+}
+
+// --------------------------------------------------------
+// Removes an object.  The last slot moves into the hole so
+// the arrays stay dense; ids of other objects don't change.
+// --------------------------------------------------------
+void TransformSystem::Remove(unsigned int id)
+{
+	unsigned int slot = slotOfId[id];
+	unsigned int last = --count;
+	if (slot != last)
+		MoveSlot(last, slot);
+
+	// The freed slot may now be padding, which must never be dirty
+	dirty[last] = 0;
+	freeIds.push_back(id);
+	Resize((count + 3) & ~3u);
+}
+
+void TransformSystem::Reserve(unsigned int capacity)
+{
+	capacity = (capacity + 3) & ~3u;
+	posX.reserve(capacity); posY.reserve(capacity); posZ.reserve(capacity);
+	rotX.reserve(capacity); rotY.reserve(capacity); rotZ.reserve(capacity);
+	scaleX.reserve(capacity); scaleY.reserve(capacity); scaleZ.reserve(capacity);
+	dirty.reserve(capacity);
+	worldMatrices.reserve(capacity);
+	idOfSlot.reserve(capacity);
+	slotOfId.reserve(capacity);
+}
+
+void TransformSystem::SetTranslation(unsigned int id, float x, float y, float z)
+{
+	unsigned int slot = slotOfId[id];
+	posX[slot] = x;
+	posY[slot] = y;
+	posZ[slot] = z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetRotation(unsigned int id, float x, float y, float z)
+{
+	unsigned int slot = slotOfId[id];
+	rotX[slot] = x;
+	rotY[slot] = y;
+	rotZ[slot] = z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetScale(unsigned int id, float x, float y, float z)
+{
+	unsigned int slot = slotOfId[id];
+	scaleX[slot] = x;
+	scaleY[slot] = y;
+	scaleZ[slot] = z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetWorldMatrix(unsigned int id, const XMFLOAT4X4& matrix)
+{
+	unsigned int slot = slotOfId[id];
+	worldMatrices[slot] = matrix;
+	dirty[slot] = 0;
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(unsigned int id)
+{
+	unsigned int slot = slotOfId[id];
+	if (dirty[slot])
+	{
+		UpdateSlot(slot);
+		dirty[slot] = 0;
+	}
+	return worldMatrices[slot];
+}
+
+// --------------------------------------------------------
+// Rebuilds every dirty world matrix, four slots at a time
+//
+// Each XMVECTOR below holds one matrix element for four
+// objects.  World = Scale * RollPitchYaw * Translation is
+// expanded by hand (same result as the XMMatrix functions),
+// then a 4x4 transpose turns "one element of four matrices"
+// into "one row of each matrix".  Since the stored matrices
+// are themselves transposed, the rows come out as
+// (m00 m10 m20 tx), (m01 m11 m21 ty) and (m02 m12 m22 tz).
+//
+// Groups don't share anything, so with a JobSystem they're
+// split across threads.  updatedSlots is then filled in
+// first, in the same order the serial loop would.
+// --------------------------------------------------------
+unsigned int TransformSystem::UpdateWorldMatrices(std::vector<unsigned int>* updatedSlots, JobSystem* jobs)
+{
+	unsigned int paddedCount = (unsigned int)dirty.size();
+	if (!jobs)
+		return UpdateGroups(0, paddedCount, updatedSlots);
+
+	if (updatedSlots)
+	{
+		for (unsigned int slot = 0; slot < paddedCount; slot++)
+		{
+			if (dirty[slot])
+				updatedSlots->push_back(slot);
+		}
+	}
+
+	std::atomic<unsigned int> updated(0);
+	jobs->ParallelFor(0, paddedCount / 4, [this, &updated](unsigned int begin, unsigned int end)
+	{
+		updated.fetch_add(UpdateGroups(begin * 4, end * 4, 0), std::memory_order_relaxed);
+	}, MinGroupsPerJob);
+	return updated.load();
+}
+
+// --------------------------------------------------------
+// The SIMD loop over slots [begin, end), both multiples of 4
+// --------------------------------------------------------
+unsigned int TransformSystem::UpdateGroups(unsigned int begin, unsigned int end, std::vector<unsigned int>* updatedSlots)
+{
+	unsigned int updated = 0;
+	for (unsigned int base = begin; base < end; base += 4)
+	{
+		// Skip whole groups that haven't changed
+		unsigned int groupDirty;
+		memcpy(&groupDirty, &dirty[base], sizeof(groupDirty));
+		if (groupDirty == 0)
+			continue;
+
+		XMVECTOR sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+		XMVectorSinCos(&sinPitch, &cosPitch, XMLoadFloat4((XMFLOAT4*)&rotX[base]));
+		XMVectorSinCos(&sinYaw, &cosYaw, XMLoadFloat4((XMFLOAT4*)&rotY[base]));
+		XMVectorSinCos(&sinRoll, &cosRoll, XMLoadFloat4((XMFLOAT4*)&rotZ[base]));
+
+		XMVECTOR sx = XMLoadFloat4((XMFLOAT4*)&scaleX[base]);
+		XMVECTOR sy = XMLoadFloat4((XMFLOAT4*)&scaleY[base]);
+		XMVECTOR sz = XMLoadFloat4((XMFLOAT4*)&scaleZ[base]);
+
+		// Shared products
+		XMVECTOR srsp = XMVectorMultiply(sinRoll, sinPitch);
+		XMVECTOR crsp = XMVectorMultiply(cosRoll, sinPitch);
+
+		// Row 0 of the rotation, scaled by x
+		XMVECTOR m00 = XMVectorMultiply(sx, XMVectorMultiplyAdd(srsp, sinYaw, XMVectorMultiply(cosRoll, cosYaw)));
+		XMVECTOR m01 = XMVectorMultiply(sx, XMVectorMultiply(sinRoll, cosPitch));
+		XMVECTOR m02 = XMVectorMultiply(sx, XMVectorSubtract(XMVectorMultiply(srsp, cosYaw), XMVectorMultiply(cosRoll, sinYaw)));
+
+		// Row 1, scaled by y
+		XMVECTOR m10 = XMVectorMultiply(sy, XMVectorSubtract(XMVectorMultiply(crsp, sinYaw), XMVectorMultiply(sinRoll, cosYaw)));
+		XMVECTOR m11 = XMVectorMultiply(sy, XMVectorMultiply(cosRoll, cosPitch));
+		XMVECTOR m12 = XMVectorMultiply(sy, XMVectorMultiplyAdd(crsp, cosYaw, XMVectorMultiply(sinRoll, sinYaw)));
+
+		// Row 2, scaled by z
+		XMVECTOR m20 = XMVectorMultiply(sz, XMVectorMultiply(cosPitch, sinYaw));
+		XMVECTOR m21 = XMVectorNegate(XMVectorMultiply(sz, sinPitch));
+		XMVECTOR m22 = XMVectorMultiply(sz, XMVectorMultiply(cosPitch, cosYaw));
+
+		XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(m00, m10, m20, XMLoadFloat4((XMFLOAT4*)&posX[base])));
+		XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(m01, m11, m21, XMLoadFloat4((XMFLOAT4*)&posY[base])));
+		XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(m02, m12, m22, XMLoadFloat4((XMFLOAT4*)&posZ[base])));
+
+		// Only write lanes that were dirty - the others may hold
+		// a matrix from SetWorldMatrix()
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			unsigned int slot = base + lane;
+			if (!dirty[slot])
+				continue;
+
+			XMFLOAT4X4* world = &worldMatrices[slot];
+			XMStoreFloat4((XMFLOAT4*)world->m[0], row0.r[lane]);
+			XMStoreFloat4((XMFLOAT4*)world->m[1], row1.r[lane]);
+			XMStoreFloat4((XMFLOAT4*)world->m[2], row2.r[lane]);
+			world->m[3][0] = 0.0f;
+			world->m[3][1] = 0.0f;
+			world->m[3][2] = 0.0f;
+			world->m[3][3] = 1.0f;
+
+			dirty[slot] = 0;
+			updated++;
+			if (updatedSlots) updatedSlots->push_back(slot);
+		}
+	}
+
+	return updated;
+}
+
+unsigned int TransformSystem::UpdateWorldMatricesScalar()
+{
+	unsigned int updated = 0;
+	for (unsigned int slot = 0; slot < count; slot++)
+	{
+		if (!dirty[slot])
+			continue;
+
+		UpdateSlot(slot);
+		dirty[slot] = 0;
+		updated++;
+	}
+	return updated;
+}
+
+void TransformSystem::Resize(unsigned int paddedCount)
+{
+	posX.resize(paddedCount); posY.resize(paddedCount); posZ.resize(paddedCount);
+	rotX.resize(paddedCount); rotY.resize(paddedCount); rotZ.resize(paddedCount);
+	scaleX.resize(paddedCount); scaleY.resize(paddedCount); scaleZ.resize(paddedCount);
+	dirty.resize(paddedCount, 0);
+	worldMatrices.resize(paddedCount);
+	idOfSlot.resize(paddedCount);
+}
+
+void TransformSystem::MoveSlot(unsigned int from, unsigned int to)
+{
+	posX[to] = posX[from]; posY[to] = posY[from]; posZ[to] = posZ[from];
+	rotX[to] = rotX[from]; rotY[to] = rotY[from]; rotZ[to] = rotZ[from];
+	scaleX[to] = scaleX[from]; scaleY[to] = scaleY[from]; scaleZ[to] = scaleZ[from];
+	dirty[to] = dirty[from];
+	worldMatrices[to] = worldMatrices[from];
+
+	unsigned int id = idOfSlot[from];
+	idOfSlot[to] = id;
+	slotOfId[id] = to;
+}
+
+// --------------------------------------------------------
+// One matrix, built the plain XMMatrix way
+// --------------------------------------------------------
+void TransformSystem::UpdateSlot(unsigned int slot)
+{
+	XMMATRIX trans = XMMatrixTranslation(posX[slot], posY[slot], posZ[slot]);
+	XMMATRIX rot = XMMatrixRotationRollPitchYaw(rotX[slot], rotY[slot], rotZ[slot]);
+	XMMATRIX scale = XMMatrixScaling(scaleX[slot], scaleY[slot], scaleZ[slot]);
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixTranspose(scale * rot * trans));
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Translation/rotation/scale for many objects, stored as
+// structure-of-arrays so world matrices can be rebuilt four
+// at a time with SSE
+//
+// Objects are referred to by ids that stay valid until
+// Remove().  Internally they are packed into dense slots,
+// which move around as objects are removed.
+//
+// Setters only mark a slot dirty; UpdateWorldMatrices()
+// rebuilds every dirty matrix in one pass.  World matrices
+// are stored transposed, ready to hand to a shader.
+// --------------------------------------------------------
+class TransformSystem
+{
+
+public:
+	TransformSystem();
+	~TransformSystem();
+
+	unsigned int Add();
+	void Remove(unsigned int id);
+	void Reserve(unsigned int capacity);
+
+	void SetTranslation(unsigned int id, float x, float y, float z);
+	void SetRotation(unsigned int id, float x, float y, float z);
+	void SetScale(unsigned int id, float x, float y, float z);
+
+	// Bypasses translation/rotation/scale until one of them is set again
+	void SetWorldMatrix(unsigned int id, const DirectX::XMFLOAT4X4& matrix);
+
+	// Rebuilds the matrix first if it is dirty
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int id);
+
+	// Returns how many matrices were rebuilt, optionally
+	// appending the slot of each one to updatedSlots.
+	// jobs - splits the work across its threads; 0 for this one
+	unsigned int UpdateWorldMatrices(std::vector<unsigned int>* updatedSlots = 0, JobSystem* jobs = 0);
+
+	// The scalar (one XMMATRIX multiply at a time) version, for comparison
+	unsigned int UpdateWorldMatricesScalar();
+
+	unsigned int GetCount() { return count; }
+	unsigned int GetSlot(unsigned int id) { return slotOfId[id]; }
+
+	// Every world matrix in slot order (call UpdateWorldMatrices() first)
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() { return count ? &worldMatrices[0] : 0; }
+
+private:
+	// Component arrays, indexed by slot.  Always padded
+	// to a multiple of 4 so the SIMD loop needs no tail.
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<unsigned char> dirty;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+	// id <-> slot mapping
+	std::vector<unsigned int> slotOfId;
+	std::vector<unsigned int> idOfSlot;
+	std::vector<unsigned int> freeIds;
+
+	unsigned int count;
+
+	void Resize(unsigned int paddedCount);
+	void MoveSlot(unsigned int from, unsigned int to);
+	void UpdateSlot(unsigned int slot);
+	unsigned int UpdateGroups(unsigned int begin, unsigned int end, std::vector<unsigned int>* updatedSlots);
+
+	// Groups of four below this aren't worth a job of their own
+	static const unsigned int MinGroupsPerJob = 64;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -12,4 +13,28 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT2 UV;
+};
+
+// --------------------------------------------------------
+// A compressed alternative to Vertex (16 bytes instead of 32)
+//
+// - Position is 16-bit normalized within the mesh's bounds
+// - Normal is octahedral-encoded into two 16-bit snorms
+// - UV is two half floats
+//
+// See VertexPacking for the encode/decode functions and
+// VertexShaderPacked.hlsl for the matching shader input.
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short Position[4];		// XYZ + padding, UNORM
+	short Normal[2];				// Octahedral, SNORM
+	DirectX::PackedVector::HALF UV[2];
+};
+
+// Which vertex layout a mesh's vertex buffer holds
+enum VertexFormat
+{
+	VertexFormatFull,		// Vertex
+	VertexFormatPacked		// PackedVertex
 };
\ No newline at end of file
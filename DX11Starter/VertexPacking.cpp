@@ -0,0 +1,119 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+static inline float SignNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline float Clamp(float value, float low, float high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+XMFLOAT3 VertexPacking::GetExtent(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	// A flat mesh still needs something to divide by
+	XMFLOAT3 extent(
+		boundsMax.x - boundsMin.x,
+		boundsMax.y - boundsMin.y,
+		boundsMax.z - boundsMin.z);
+	if (extent.x <= 0.0f) extent.x = 1.0f;
+	if (extent.y <= 0.0f) extent.y = 1.0f;
+	if (extent.z <= 0.0f) extent.z = 1.0f;
+	return extent;
+}
+
+// --------------------------------------------------------
+// Maps a unit vector onto an octahedron, then unfolds the
+// lower half so the whole sphere fits in [-1,1]^2
+// --------------------------------------------------------
+void VertexPacking::EncodeOctahedral(XMFLOAT3 normal, short* encoded)
+{
+	float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (sum == 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x = normal.x / sum;
+	float y = normal.y / sum;
+	if (normal.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = (short)floorf(Clamp(x, -1.0f, 1.0f) * 32767.0f + 0.5f);
+	encoded[1] = (short)floorf(Clamp(y, -1.0f, 1.0f) * 32767.0f + 0.5f);
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(const short* encoded)
+{
+	// SNORM conversion, as the input assembler does it
+	float x = encoded[0] < -32767 ? -1.0f : encoded[0] / 32767.0f;
+	float y = encoded[1] < -32767 ? -1.0f : encoded[1] / 32767.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		float unfoldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	float length = sqrtf(x * x + y * y + z * z);
+	if (length == 0.0f)
+		return XMFLOAT3(0, 0, 0);
+	return XMFLOAT3(x / length, y / length, z / length);
+}
+
+void VertexPacking::Pack(
+	const Vertex* vertices,
+	int vCount,
+	XMFLOAT3 boundsMin,
+	XMFLOAT3 boundsMax,
+	PackedVertex* packed)
+{
+	XMFLOAT3 extent = GetExtent(boundsMin, boundsMax);
+	XMFLOAT3 scale(65535.0f / extent.x, 65535.0f / extent.y, 65535.0f / extent.z);
+
+	for (int i = 0; i < vCount; i++)
+	{
+		const Vertex& v = vertices[i];
+		PackedVertex& p = packed[i];
+
+		p.Position[0] = (unsigned short)Clamp((v.Position.x - boundsMin.x) * scale.x + 0.5f, 0.0f, 65535.0f);
+		p.Position[1] = (unsigned short)Clamp((v.Position.y - boundsMin.y) * scale.y + 0.5f, 0.0f, 65535.0f);
+		p.Position[2] = (unsigned short)Clamp((v.Position.z - boundsMin.z) * scale.z + 0.5f, 0.0f, 65535.0f);
+		p.Position[3] = 65535;
+
+		EncodeOctahedral(v.Normal, p.Normal);
+
+		p.UV[0] = XMConvertFloatToHalf(v.UV.x);
+		p.UV[1] = XMConvertFloatToHalf(v.UV.y);
+	}
+}
+
+Vertex VertexPacking::Unpack(const PackedVertex& packed, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	XMFLOAT3 extent = GetExtent(boundsMin, boundsMax);
+
+	Vertex v;
+	v.Position.x = boundsMin.x + packed.Position[0] / 65535.0f * extent.x;
+	v.Position.y = boundsMin.y + packed.Position[1] / 65535.0f * extent.y;
+	v.Position.z = boundsMin.z + packed.Position[2] / 65535.0f * extent.z;
+	v.Normal = DecodeOctahedral(packed.Normal);
+	v.UV.x = XMConvertHalfToFloat(packed.UV[0]);
+	v.UV.y = XMConvertHalfToFloat(packed.UV[1]);
+	return v;
+}
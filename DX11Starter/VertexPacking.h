@@ -0,0 +1,35 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// CPU encode/decode for PackedVertex
+//
+// Positions are stored relative to a bounding box, so the
+// same box (the mesh's bounds) must be used to decode them.
+// --------------------------------------------------------
+class VertexPacking
+{
+
+public:
+	static void Pack(
+		const Vertex* vertices,
+		int vCount,
+		DirectX::XMFLOAT3 boundsMin,
+		DirectX::XMFLOAT3 boundsMax,
+		PackedVertex* packed);
+
+	static Vertex Unpack(
+		const PackedVertex& packed,
+		DirectX::XMFLOAT3 boundsMin,
+		DirectX::XMFLOAT3 boundsMax);
+
+	// Individual attributes
+	static void EncodeOctahedral(DirectX::XMFLOAT3 normal, short* encoded);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const short* encoded);
+
+	// Box size used for decoding (never zero on any axis)
+	static DirectX::XMFLOAT3 GetExtent(DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+};
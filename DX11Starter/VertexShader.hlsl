@@ -1,15 +1,21 @@
 
-// Constant Buffer
+// Constant Buffers
 // - Allows us to define a buffer of individual variables 
 //    which will (eventually) hold data from our C++ code
 // - All non-pipeline variables that get their values from 
 //    our C++ code must be defined inside a Constant Buffer
-// - The name of the cbuffer itself is unimportant
-cbuffer externalData : register(b0)
+// - Variables are grouped by how often they change, so each
+//    buffer is only re-uploaded when its own data changes:
+//    b0 once a frame, b1 per mesh/material, b2 per object
+// - World, view and projection arrive already combined (on the
+//    CPU, once per object) rather than multiplied per vertex, so
+//    nothing is left here that changes once a frame
+cbuffer perObject : register(b2)
 {
-	matrix world;
-	matrix view;
-	matrix projection;
+	matrix worldViewProj;
+
+	// Transforms normals correctly even under non-uniform scale
+	matrix worldInverseTranspose;
 };
 
 // Struct representing a single vertex worth of data
@@ -60,20 +66,17 @@ VertexToPixel main( VertexShaderInput input )
 	// The vertex's position (input.position) must be converted to world space,
 	// then camera space (relative to our 3D camera), then to proper homogenous 
 	// screen-space coordinates.  This is taken care of by our world, view and
-	// projection matrices.  
+	// projection matrices, which the CPU has already multiplied together into
+	// a single matrix (world to view to projection space).
 	//
-	// First we multiply them together to get a single matrix which represents
-	// all of those transformations (world to view to projection space)
-	matrix worldViewProj = mul(mul(world, view), projection);
-
-	// Then we convert our 3-component position vector to a 4-component vector
-	// and multiply it by our final 4x4 matrix.
+	// We convert our 3-component position vector to a 4-component vector
+	// and multiply it by that 4x4 matrix.
 	//
 	// The result is essentially the position (XY) of the vertex on our 2D 
 	// screen and the distance (Z) from the camera (the "depth" of the pixel)
 	output.position = mul(float4(input.position, 1.0f), worldViewProj);
 
-	output.normal = mul(input.normal, (float3x3)world);
+	output.normal = mul(input.normal, (float3x3)worldInverseTranspose);
 
 	// Pass the color through 
 	// - The values will be interpolated per-pixel by the rasterizer
@@ -0,0 +1,48 @@
+
+// Same as VertexShader.hlsl, but for drawing many copies of a mesh
+// with one DrawIndexedInstanced call.  Each copy's matrices come
+// from a second vertex buffer (slot 1) that advances once per
+// instance: SimpleVertexShader sees the "_PER_INSTANCE" semantic
+// suffix and sets the input layout up that way.
+
+struct VertexShaderInput
+{ 
+	float3 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+
+	// World * view * projection and the world matrix's inverse
+	// transpose, both stored transposed like every other matrix
+	// we hand to shaders, one row per register (the normal
+	// matrix's last row is never needed)
+	float4 wvp0			: WORLDVIEWPROJ_PER_INSTANCE0;
+	float4 wvp1			: WORLDVIEWPROJ_PER_INSTANCE1;
+	float4 wvp2			: WORLDVIEWPROJ_PER_INSTANCE2;
+	float4 wvp3			: WORLDVIEWPROJ_PER_INSTANCE3;
+	float4 normal0		: NORMALMATRIX_PER_INSTANCE0;
+	float4 normal1		: NORMALMATRIX_PER_INSTANCE1;
+	float4 normal2		: NORMALMATRIX_PER_INSTANCE2;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+};
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	// Rows of the transposed matrices, so they multiply on the left
+	float4x4 wvpT = float4x4(input.wvp0, input.wvp1, input.wvp2, input.wvp3);
+	float3x3 normalT = float3x3(input.normal0.xyz, input.normal1.xyz, input.normal2.xyz);
+
+	output.position = mul(wvpT, float4(input.position, 1.0f));
+	output.normal = mul(normalT, input.normal);
+
+	return output;
+}
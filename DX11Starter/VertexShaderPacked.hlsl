@@ -0,0 +1,58 @@
+
+// Same as VertexShader.hlsl, but for meshes stored as PackedVertex
+// (see Vertex.h).  The input assembler expands the 16-bit data to
+// floats, so all that's left is to undo the encoding.
+cbuffer perMesh : register(b1)
+{
+	// The box the positions were normalized within
+	float3 boundsMin;
+	float3 boundsExtent;
+};
+
+// Combined on the CPU, once per object
+cbuffer perObject : register(b2)
+{
+	matrix worldViewProj;
+	matrix worldInverseTranspose;
+};
+
+// Semantic suffixes tell SimpleVertexShader which 16-bit
+// format to use when building the input layout
+struct VertexShaderInput
+{ 
+	float4 position		: POSITION_UNORM;	// XYZ in [0,1] within the bounds
+	float2 normal		: NORMAL_SNORM;		// Octahedral
+	float2 uv			: TEXCOORD_HALF;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+};
+
+// --------------------------------------------------------
+// Unfolds an octahedral-encoded unit vector
+// --------------------------------------------------------
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	float3 position = boundsMin + input.position.xyz * boundsExtent;
+
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+	output.normal = mul(DecodeOctahedral(input.normal), (float3x3)worldInverseTranspose);
+
+	return output;
+}
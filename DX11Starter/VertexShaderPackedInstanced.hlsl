@@ -0,0 +1,62 @@
+
+// VertexShaderPacked.hlsl and VertexShaderInstanced.hlsl combined:
+// PackedVertex data on slot 0, matrices per instance on slot 1.
+// Every instance shares the mesh, so the bounds the positions
+// were packed within stay in a constant buffer.
+cbuffer perMesh : register(b1)
+{
+	// The box the positions were normalized within
+	float3 boundsMin;
+	float3 boundsExtent;
+};
+
+struct VertexShaderInput
+{ 
+	float4 position		: POSITION_UNORM;	// XYZ in [0,1] within the bounds
+	float2 normal		: NORMAL_SNORM;		// Octahedral
+	float2 uv			: TEXCOORD_HALF;
+
+	float4 wvp0			: WORLDVIEWPROJ_PER_INSTANCE0;
+	float4 wvp1			: WORLDVIEWPROJ_PER_INSTANCE1;
+	float4 wvp2			: WORLDVIEWPROJ_PER_INSTANCE2;
+	float4 wvp3			: WORLDVIEWPROJ_PER_INSTANCE3;
+	float4 normal0		: NORMALMATRIX_PER_INSTANCE0;
+	float4 normal1		: NORMALMATRIX_PER_INSTANCE1;
+	float4 normal2		: NORMALMATRIX_PER_INSTANCE2;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+};
+
+// --------------------------------------------------------
+// Unfolds an octahedral-encoded unit vector
+// --------------------------------------------------------
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	float3 position = boundsMin + input.position.xyz * boundsExtent;
+
+	// Rows of the transposed matrices, so they multiply on the left
+	float4x4 wvpT = float4x4(input.wvp0, input.wvp1, input.wvp2, input.wvp3);
+	float3x3 normalT = float3x3(input.normal0.xyz, input.normal1.xyz, input.normal2.xyz);
+
+	output.position = mul(wvpT, float4(position, 1.0f));
+	output.normal = mul(normalT, DecodeOctahedral(input.normal));
+
+	return output;
+}